@@ -1,210 +1,727 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
-#include <nlohmann/json.hpp>
+#include "src/AsOfWinnerTable.h"
+#include "src/ChangeEventStream.h"
+#include "src/Combiner.h"
+#include "src/Compaction.h"
+#include "src/CompressedEntriesWriter.h"
+#include "src/EngineChoice.h"
+#include "src/EntriesFileWriter.h"
+#include "src/EntriesParser.h"
+#include "src/Entry.h"
+#include "src/EntryFormatter.h"
+#include "src/InputProfile.h"
+#include "src/InputReading.h"
+#include "src/Jobs.h"
+#include "src/MemoryGovernor.h"
+#include "src/MergeBuilder.h"
+#include "src/Options.h"
+#include "src/OutputIndexes.h"
+#include "src/PersistentState.h"
+#include "src/Progress.h"
+#include "src/Statistics.h"
+#include "src/ThreadPool.h"
+#include "src/TitlePool.h"
+#include "src/VersionedWinnerTable.h"
 
-struct Entry {
-	std::string title;
-	uint64_t created { 0 };
-	uint64_t deleted { 0 };
-	/**
-	 * An auxiliary field that gets used for comparison of Entry instances.
-	 * Avoiding branching at every comparison is its purpose.
-	 * It must be assigned by JSON loading core based on {@code created} and {@code deleted} values.
-	 */
-	uint64_t timestamp { 0 };
-	int num;
-
-	bool operator<( const Entry &that ) const {
-		return timestamp < that.timestamp;
-	}
-};
-
-class MergeBuilder {
-	std::unordered_map<int, const Entry *> buckets;
-public:
-	/**
-	 * Tries to merge the supplied entries.
-	 * @param entries a bunch of entries.
-	 * @note the supplied entries are referred by their addresses.
-	 * Entries are assumed to be valid and have a permanent address during the entire {@code MergeBuilder} object lifetime.
-	 * These entries are assumed to be owned by something else.
-	 */
-	void addEntries( const std::vector<Entry> &entries );
-
-	/**
-	 * Creates a sorted by timestamp list of merged entries.
-	 * @return a sorted list of pointers to entries that are assumed to be valid and owned by something else.
-	 */
-	std::vector<const Entry *> build();
-};
-
-void MergeBuilder::addEntries( const std::vector<Entry> &entries ) {
-	for( const Entry &entry: entries ) {
-		// Check whether there's an existing entry for the given `num`
-		auto it = buckets.find( entry.num );
-		// There's no such entry, perform an insertion
-		if( it == buckets.end() ) {
-			buckets.emplace( std::make_pair( entry.num, &entry ) );
+/**
+ * Performs random lookups and periodic full ordered scans of snapshots until stopped.
+ */
+static void readSnapshotsConcurrently( VersionedWinnerTable &table, const std::vector<std::vector<Entry>> &lists,
+									   const std::atomic<bool> &stop, unsigned seed, ConcurrentReadLatencies &latencies ) {
+	const int reader = table.registerReader();
+	if( reader < 0 ) {
+		return;
+	}
+	std::mt19937 rng( seed );
+	std::vector<const Entry *> scanned;
+	for( uint64_t i = 0; !stop.load( std::memory_order_relaxed ); ++i ) {
+		const std::vector<Entry> &list = lists[rng() % lists.size()];
+		if( list.empty() ) {
 			continue;
 		}
-		// Check whether the existing entry should be preserved
-		const Entry &existing = *( it->second );
-		if( !( existing < entry ) ) {
-			continue;
+		const int num = list[rng() % list.size()].num;
+		auto startedAt = std::chrono::steady_clock::now();
+		uint64_t version = table.beginRead( reader );
+		const Entry *found = table.find( num, version );
+		table.endRead( reader );
+		latencies.lookupNanos.push_back( std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - startedAt ).count() );
+		latencies.numLookupsFound += found != nullptr;
+
+		if( i % 1024 == 1023 ) {
+			startedAt = std::chrono::steady_clock::now();
+			version = table.beginRead( reader );
+			scanned.clear();
+			table.collect( version, scanned );
+			table.endRead( reader );
+			std::sort( scanned.begin(), scanned.end(), []( const Entry *lhs, const Entry *rhs ) { return *lhs < *rhs; } );
+			latencies.scanNanos.push_back( std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - startedAt ).count() );
 		}
-		// Overwrite the existing entry in-place.
-		// Note that this is totally correct as the hash code is the same
-		it->second = &entry;
 	}
+	table.unregisterReader( reader );
 }
 
-std::vector<const Entry *> MergeBuilder::build() {
-	std::vector<const Entry *> result;
-	for( const auto &kvPair : buckets ) {
-		result.push_back( kvPair.second );
+/**
+ * Writes snapshots of winners as of every cutoff to files named after cutoffs.
+ * Snapshots are built and written in parallel.
+ * @return an exit code of the program.
+ */
+static int writeAsOfSnapshots( const Options &options, const std::vector<std::vector<Entry>> &readLists,
+							   const TitlePool &titlePool, ThreadPool &threadPool, uint64_t numEntriesParsed ) {
+	AsOfWinnerTable table( options.asOfCutoffs );
+	for( const auto &list: readLists ) {
+		table.addEntries( list );
 	}
-	// Provide a proper comparator for sorting pointers to items
-	auto cmp = []( const Entry *lhs, const Entry *rhs ) { return *lhs < *rhs; };
-	std::sort( result.begin(), result.end(), cmp );
-	return result;
-}
-
-// Wrap keys once for faster access in the parsing loop
-static std::string FIELD_NUM( "num" );
-static std::string FIELD_TITLE( "title" );
-static std::string FIELD_CREATED( "created" );
-static std::string FIELD_DELETED( "deleted" );
-
-template <typename T>
-static bool getField( const nlohmann::json &json, const std::string &key, T &result, std::string &error ) {
-	auto it = json.find( key );
-	if( it != json.end() ) {
-		result = *it;
-		return true;
-	}
-	error = std::string( "Failed to get field `" ) + key + "` of an entry";
-	return false;
-}
 
-template <typename T>
-static bool tryGettingField( const nlohmann::json &json, const std::string &key, T &result ) {
-	auto it = json.find( key );
-	if( it != json.end() ) {
-		result = *it;
-		return true;
+	const size_t numCutoffs = table.numCutoffs();
+	std::vector<size_t> numEntriesWritten( numCutoffs );
+	std::vector<std::string> errors( numCutoffs );
+	threadPool.parallelFor( numCutoffs, [&]( size_t i ) {
+		const std::string filename( options.asOfPrefix + std::to_string( table.cutoff( i ) ) + ".json" );
+		std::ofstream stream( filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+		if( !stream.is_open() ) {
+			errors[i] = "Failed to open a file stream of `" + filename + "`";
+			return;
+		}
+		const std::vector<const Entry *> entries( table.build( i ) );
+		EntriesPrinter( titlePool, stream ).print( entries );
+		if( !stream.flush() ) {
+			errors[i] = "Failed to write `" + filename + "`";
+		}
+		numEntriesWritten[i] = entries.size();
+	});
+	for( const std::string &error: errors ) {
+		if( !error.empty() ) {
+			std::cerr << error << std::endl;
+			return 1;
+		}
 	}
-	return false;
-}
 
-static bool tryParsingEntries( const nlohmann::json &root, std::vector<Entry> &output, std::string &error ) {
-	if( !root.is_array() ) {
-		error = "The root JSON object is not an array";
-		return false;
+	if( options.printStats ) {
+		printStat( "threads", threadPool.numThreads() );
+		printStat( "entries parsed", numEntriesParsed );
+		printStat( "as-of snapshots", numCutoffs );
+		printStat( "as-of keys", table.numKeys() );
+		printStat( "as-of versions stored", table.numVersions() );
+		uint64_t totalEntriesWritten = 0;
+		for( size_t count: numEntriesWritten ) {
+			totalEntriesWritten += count;
+		}
+		printStat( "entries written", totalEntriesWritten );
 	}
+	return 0;
+}
 
-	std::vector<Entry> result;
-	for( const nlohmann::json &elem: root ) {
-		if( !elem.is_object() ) {
-			error = "An element of a root JSON array is not an object";
-			return false;
+/**
+ * Writes entries to the output that is specified by options.
+ */
+static bool tryWritingOutput( const Options &options, const TitlePool &titlePool, EntriesFileWriter &fileWriter,
+							  CompressedEntriesWriter &compressedWriter, const std::vector<const Entry *> &entries, std::string &error ) {
+	if( options.compressOutput ) {
+		if( !options.outputFilename ) {
+			return compressedWriter.tryWriting( std::cout, entries, error );
 		}
-		Entry entry;
-		if( !::getField( elem, FIELD_NUM, entry.num, error ) ) {
+		std::ofstream stream( options.outputFilename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+		if( !stream.is_open() ) {
+			error = std::string( "Failed to open a file stream of `" ) + options.outputFilename + "`";
 			return false;
 		}
-		if( !::getField( elem, FIELD_TITLE, entry.title, error ) ) {
+		return compressedWriter.tryWriting( stream, entries, error );
+	}
+	if( options.outputFilename ) {
+		fileWriter.setRecordingOffsets( options.writesPointIndex || options.timestampIndexStride );
+		if( !fileWriter.tryWriting( options.outputFilename, entries, error ) ) {
 			return false;
 		}
-		assert( entry.created == 0 && entry.deleted == 0 );
-		const bool hasCreated = ::tryGettingField( elem, FIELD_CREATED, entry.created );
-		const bool hasDeleted = ::tryGettingField( elem, FIELD_DELETED, entry.deleted );
-		if( hasCreated && hasDeleted ) {
-			error = "Both `created` and `deleted` fields are present";
+		if( options.timestampIndexStride &&
+			!SparseTimestampIndex::tryWriting( std::string( options.outputFilename ) + ".tsidx", entries,
+											   fileWriter.entryOffsets(), options.timestampIndexStride, error ) ) {
 			return false;
 		}
-		if( !( hasCreated || hasDeleted ) ) {
-			error = "Both `created` and `deleted` fields are absent";
-			return false;
+		return !options.writesPointIndex ||
+			   PointLookupIndex::tryWriting( std::string( options.outputFilename ) + ".idx", entries, fileWriter.entryOffsets(), error );
+	}
+	EntriesPrinter( titlePool, std::cout ).print( entries );
+	return true;
+}
+
+/**
+ * Prints formatted objects of keys using the index of the output.
+ * @return an exit code of the program.
+ */
+static int lookUpEntries( const Options &options ) {
+	PointLookupIndex index;
+	MappedFile output;
+	std::string error;
+	const std::string indexFilename = std::string( options.lookupFilename ) + ".idx";
+	if( !index.tryOpening( indexFilename.c_str(), error ) || !output.tryMapping( options.lookupFilename, error ) ) {
+		std::cerr << error << std::endl;
+		return 1;
+	}
+	int exitCode = 0;
+	std::string buffer;
+	for( const char *numArg: options.filenames ) {
+		char *numEnd;
+		const long num = std::strtol( numArg, &numEnd, 10 );
+		PointLookupIndex::Location location;
+		if( numEnd == numArg || *numEnd || num < INT_MIN || num > INT_MAX ) {
+			std::cerr << "`" << numArg << "` is not a key" << std::endl;
+			exitCode = 1;
+		} else if( !index.find( (int)num, location ) ) {
+			std::cerr << "The key " << num << " is not found" << std::endl;
+			exitCode = 1;
+		} else if( location.offset + location.length > output.size() ) {
+			std::cerr << "The index does not match `" << options.lookupFilename << "`" << std::endl;
+			return 1;
+		} else {
+			buffer.append( output.data() + location.offset, location.length );
+			buffer.push_back( '\n' );
+		}
+	}
+	std::cout.write( buffer.data(), (std::streamsize)buffer.size() );
+	std::cout.flush();
+	return exitCode;
+}
+
+/**
+ * Prints entries of the output with timestamps within the range using the timestamp index.
+ * Blocks of entries that are entirely within the range are copied as they are,
+ * and only blocks at boundaries of the range are scanned for timestamps of entries.
+ * @return an exit code of the program.
+ */
+static int readTimestampRange( const Options &options ) {
+	SparseTimestampIndex index;
+	MappedFile output;
+	std::string error;
+	const std::string indexFilename = std::string( options.rangeFilename ) + ".tsidx";
+	if( !index.tryOpening( indexFilename.c_str(), error ) || !output.tryMapping( options.rangeFilename, error ) ) {
+		std::cerr << error << std::endl;
+		return 1;
+	}
+	if( index.size() && index.blockEnd( index.size() - 1 ) > output.size() ) {
+		std::cerr << "The timestamp index does not match `" << options.rangeFilename << "`" << std::endl;
+		return 1;
+	}
+
+	// Entries that precede the first sample within the range belong to the block of the preceding sample
+	const size_t firstBlock = index.lowerBound( options.rangeFrom );
+	const size_t beginBlock = firstBlock ? firstBlock - 1 : 0;
+	const size_t endBlock = options.rangeFrom <= options.rangeTo ? index.upperBound( options.rangeTo ) : 0;
+
+	std::string buffer;
+	bool isFirst = true;
+	uint64_t numEntriesRead = 0, numBytesScanned = 0;
+	TitlePool blockPool( false, false );
+	std::vector<Entry> blockEntries;
+	std::vector<const char *> elementEnds;
+	auto appendFormatted = [&]( const char *data, size_t length ) {
+		buffer.append( isFirst ? "[\n" : ",\n" );
+		isFirst = false;
+		buffer.append( data, length );
+		if( buffer.size() >= ( 1u << 20 ) ) {
+			std::cout.write( buffer.data(), (std::streamsize)buffer.size() );
+			buffer.clear();
 		}
-		if( hasCreated ) {
-			entry.timestamp = entry.created;
+	};
+	for( size_t block = beginBlock; block < endBlock; ++block ) {
+		const char *const blockBegin = output.data() + index.sample( block ).offset;
+		const char *const blockEnd = output.data() + index.blockEnd( block );
+		numBytesScanned += (uint64_t)( blockEnd - blockBegin );
+		if( block != beginBlock && block + 1 != endBlock ) {
+			appendFormatted( blockBegin, (size_t)( blockEnd - blockBegin ) );
+			continue;
 		}
-		if( hasDeleted ) {
-			entry.timestamp = entry.deleted;
+		// Entries of edge blocks are parsed to get their timestamps, and their formatted text is copied as it is
+		blockPool.clear();
+		EntriesParser parser( blockBegin, blockEnd, blockPool );
+		if( !parser.parseSequence( blockEntries, elementEnds, error ) ) {
+			// Positions of the error are relative to the block
+			std::cerr << "Malformed output `" << options.rangeFilename << "` in a block at byte offset " << index.sample( block ).offset
+					  << ": " << error << std::endl;
+			return 1;
+		}
+		// Elements are separated the same way as blocks are
+		const char *elementBegin = blockBegin;
+		for( size_t i = 0; i < blockEntries.size() && blockEntries[i].timestamp <= options.rangeTo; ++i ) {
+			if( blockEntries[i].timestamp >= options.rangeFrom ) {
+				appendFormatted( elementBegin, (size_t)( elementEnds[i] - elementBegin ) );
+				numEntriesRead++;
+			}
+			elementBegin = elementEnds[i] + 2;
 		}
-		result.emplace_back( std::move( entry ) );
 	}
+	buffer.append( isFirst ? "[]\n" : "\n]\n" );
+	std::cout.write( buffer.data(), (std::streamsize)buffer.size() );
+	std::cout.flush();
 
-	// There's nothing that could throw left. Commit changes.
-	output.clear();
-	std::swap( result, output );
-	return true;
+	if( options.printStats ) {
+		printStat( "range blocks", endBlock > beginBlock ? endBlock - beginBlock : 0 );
+		printStat( "range bytes scanned", numBytesScanned );
+		printStat( "output bytes", output.size() );
+	}
+	return 0;
 }
 
-static bool tryReadingEntries( const char *filename, std::vector<Entry> &output, std::string &error ) {
-	try {
-		std::ifstream stream;
-		stream.open( filename, std::ios_base::in );
-		if( !stream.is_open() ) {
-			error = "Failed to open a file stream";
-			return false;
+/**
+ * Merges inputs that do not fit the memory budget in two passes.
+ * The first pass resolves locations of winners (a list and a position) keeping nothing else of parsed lists.
+ * The second one parses the lists again and keeps only winners.
+ * @return an exit code of the program.
+ */
+static int mergeInTwoPasses( const Options &options, ThreadPool &threadPool, MemoryGovernor &governor ) {
+	struct Location {
+		uint64_t timestamp;
+		uint32_t list;
+		uint32_t position;
+	};
+	const size_t numFiles = options.filenames.size();
+	TitlePool scratchPool( false, false );
+	std::vector<Entry> list;
+	std::vector<std::string> warnings;
+	std::string error;
+	uint64_t numEntriesParsed = 0;
+
+	auto tryParsing = [&]( size_t i ) {
+		const uint64_t size = ::estimateReadingBytes( options.filenames[i] );
+		governor.acquireTransient( size );
+		scratchPool.clear();
+		warnings.clear();
+		const bool succeeded = ::tryReadingEntries( options.filenames[i], options.inputMode, threadPool, list, scratchPool,
+													options.skipInvalid, warnings, error );
+		governor.releaseTransient( size );
+		if( !succeeded ) {
+			std::cerr << "Failed to read a file content of `" << options.filenames[i] << "`: " << error << std::endl;
+		}
+		return succeeded;
+	};
+
+	// The first pass: earlier entries win ties the same way the builder resolves them
+	std::unordered_map<int, Location> locations;
+	for( size_t i = 0; i < numFiles; ++i ) {
+		if( !tryParsing( i ) ) {
+			return 1;
+		}
+		for( const std::string &warning: warnings ) {
+			std::cerr << "Skipping an invalid element of `" << options.filenames[i] << "`: " << warning << std::endl;
+		}
+		numEntriesParsed += list.size();
+		for( size_t position = 0; position < list.size(); ++position ) {
+			const Entry &entry = list[position];
+			const Location location { entry.timestamp, (uint32_t)i, (uint32_t)position };
+			auto it = locations.find( entry.num );
+			if( it == locations.end() ) {
+				locations.emplace( entry.num, location );
+			} else if( it->second.timestamp < entry.timestamp ) {
+				it->second = location;
+			}
 		}
-		nlohmann::json root( nlohmann::json::parse( stream ) );
-		return tryParsingEntries( root, output, error );
-	} catch( std::exception &ex ) {
-		error = ex.what();
-		return false;
 	}
-}
+	const uint64_t locationBytes = locations.bucket_count() * sizeof( void * ) +
+		locations.size() * ( sizeof( std::pair<const int, Location> ) + sizeof( void * ) );
+	governor.retain( locationBytes );
 
-static void printEntries( const std::vector<const Entry *> &entries ) {
-	nlohmann::json root;
-	for( const Entry *entry : entries ) {
-		nlohmann::json obj;
-		obj[FIELD_NUM] = entry->num;
-		obj[FIELD_TITLE] = entry->title;
-		if( entry->created ) {
-			obj[FIELD_CREATED] = entry->created;
+	std::vector<std::vector<uint32_t>> positionsByList( numFiles );
+	for( const auto &kvPair: locations ) {
+		positionsByList[kvPair.second.list].push_back( kvPair.second.position );
+	}
+	const size_t numWinners = locations.size();
+	std::unordered_map<int, Location>().swap( locations );
+
+	// The second pass
+	TitlePool titlePool( options.internTitles, options.compressTitles );
+	std::vector<Entry> winners;
+	winners.reserve( numWinners );
+	governor.retain( numWinners * ( sizeof( Entry ) + sizeof( const Entry * ) ) );
+	std::string title;
+	for( size_t i = 0; i < numFiles; ++i ) {
+		std::vector<uint32_t> &positions = positionsByList[i];
+		if( positions.empty() ) {
+			continue;
+		}
+		if( !tryParsing( i ) ) {
+			return 1;
 		}
-		if( entry->deleted ) {
-			obj[FIELD_DELETED] = entry->deleted;
+		std::sort( positions.begin(), positions.end() );
+		for( uint32_t position: positions ) {
+			if( position >= list.size() ) {
+				std::cerr << "`" << options.filenames[i] << "` changed between passes of the merge" << std::endl;
+				return 1;
+			}
+			Entry entry = list[position];
+			title.clear();
+			scratchPool.decode( scratchPool.get( entry.titleId ), title );
+			if( !titlePool.tryAdding( title.data(), title.size(), entry.titleId ) ) {
+				std::cerr << "Failed to collect winners of `" << options.filenames[i] << "`: the title pool is full" << std::endl;
+				return 1;
+			}
+			winners.push_back( entry );
 		}
-		root.emplace_back( std::move( obj ) );
 	}
-	// Dump to the std::cout using pretty-printing
-	std::cout << root.dump(2) << std::endl;
+	std::vector<Entry>().swap( list );
+	scratchPool.clear();
+	governor.retain( titlePool.numBytesStored() );
+
+	std::vector<const Entry *> entries( winners.size() );
+	for( size_t i = 0; i < winners.size(); ++i ) {
+		entries[i] = &winners[i];
+	}
+	std::sort( entries.begin(), entries.end(), []( const Entry *lhs, const Entry *rhs ) { return *lhs < *rhs; } );
+
+	EntriesFileWriter fileWriter( titlePool, threadPool );
+	CompressedEntriesWriter compressedWriter( titlePool, threadPool, options.outputCodec );
+	if( !::tryWritingOutput( options, titlePool, fileWriter, compressedWriter, entries, error ) ) {
+		std::cerr << "Failed to write the output: " << error << std::endl;
+		return 1;
+	}
+	governor.retain( fileWriter.bufferBytes() );
+
+	if( options.printStats ) {
+		::printMemoryStats( governor, "two-pass" );
+		printStat( "threads", threadPool.numThreads() );
+		printStat( "entries parsed", numEntriesParsed );
+		printStat( "entries written", entries.size() );
+	}
+	return 0;
 }
 
 int main( int argc, char **argv ) {
-	if( argc < 3 ) {
-		std::cerr << "Usage: mergelists-cpp <filename1> <filename2> ..." << std::endl;
+	Options options;
+	std::string error;
+	if( !::tryParsingOptions( argc, argv, options, error ) ) {
+		std::cerr << error << std::endl;
+		std::cerr << "Usage: mergelists-cpp [--skip-invalid] [--intern-titles] [--compress-titles] [--stats] [--combine] [--ordered-index] "
+		          "[--engine auto|hash|dense|sorted|partitioned|concurrent] [--sort comparison|radix] [--dense-kernel auto|scalar|avx512] "
+		          "[--threads N] [--concurrent-readers N] [--state DIR [--durability none|fsync] [--checkpoint-bytes N] "
+		          "[--compact [--tombstone-retention N] [--ttl N]]] [--as-of T1,T2,... [--as-of-prefix PREFIX]] "
+		          "[--cdc FILE [--cdc-format ndjson|binary]] [--output FILE [--index] [--timestamp-index K]] [--compress zstd|gzip] "
+		          "[--input-mode cached|direct|drop-cache] [--prefetch N] [--memory-budget BYTES] "
+		          "[--progress] [--stats-socket PATH] <filename1> <filename2> ...\n"
+		          "       mergelists-cpp [options] --jobs FILE\n"
+		          "       mergelists-cpp --lookup OUTPUT <num1> <num2> ...\n"
+		          "       mergelists-cpp [--stats] --read-range OUTPUT FROM TO\n"
+		          "       mergelists-cpp [options] --profile-input PROFILE <filename1> ...\n"
+		          "       mergelists-cpp [--stats] --generate PROFILE [--generate-prefix PREFIX] [--seed N]" << std::endl;
+		std::cerr << "A file of jobs lists an output and inputs of a job per line: <output> <filename1> <filename2> ..." << std::endl;
 		return 1;
 	}
 
+	// The signal must be blocked before any thread is started, so it's delivered only to the monitor
+	ProgressCounters counters;
+	ProgressMonitor monitor( counters );
+	if( options.describeProgressOnSignal || options.statsSocketPath ) {
+		if( options.describeProgressOnSignal && !ProgressMonitor::tryBlockingSignal( error ) ) {
+			std::cerr << error << std::endl;
+			return 1;
+		}
+		if( !monitor.tryStarting( options.describeProgressOnSignal, options.statsSocketPath, error ) ) {
+			std::cerr << "Failed to start the progress monitor: " << error << std::endl;
+			return 1;
+		}
+		progressCounters = &counters;
+	}
+
+	if( options.generatorProfileFilename ) {
+		return ::generateFromProfile( options );
+	}
+	if( options.lookupFilename ) {
+		return ::lookUpEntries( options );
+	}
+	if( options.rangeFilename ) {
+		return ::readTimestampRange( options );
+	}
+
+	MergeBuilder::Config config;
+	config.engine = options.engine;
+	config.sortAlgorithm = options.sortAlgorithm;
+	config.denseKernel = options.denseKernel;
+	config.maintainOrder = options.maintainOrder;
+	unsigned numThreads = options.numThreads ? options.numThreads : 1;
+	std::string engineChoiceReasoning;
+	// Jobs sample their own inputs
+	InputSample sample;
+	bool isSampled = false;
+	if( options.autoEngine && !options.jobsFilename && !options.profileFilename ) {
+		isSampled = true;
+		if( !::trySamplingInputs( options.filenames, sample, error ) ) {
+			std::cerr << "Failed to sample inputs: " << error << std::endl;
+			return 1;
+		}
+		unsigned chosenNumThreads;
+		::chooseEngine( sample, options.filenames.size(), config, chosenNumThreads, engineChoiceReasoning );
+		// Let an explicitly specified number of threads take precedence
+		if( !options.numThreads ) {
+			numThreads = chosenNumThreads;
+		}
+		if( options.changeEventsFilename && !MergeBuilder::isObservable( config.engine ) ) {
+			config.engine = MergeBuilder::HashEngine;
+			engineChoiceReasoning += "; change events require the hash engine";
+		}
+		if( options.numConcurrentReaders ) {
+			config.engine = MergeBuilder::ConcurrentEngine;
+			engineChoiceReasoning += "; concurrent readers require the concurrent engine";
+		}
+	}
+	ThreadPool threadPool( numThreads );
+	config.threadPool = &threadPool;
+	config.progressCounters = progressCounters;
+
+	if( options.jobsFilename ) {
+		return ::runJobs( options, config, threadPool );
+	}
+	if( options.profileFilename ) {
+		return ::profileInputs( options, threadPool );
+	}
+
+	// Parsed lists take roughly as much memory as their text does.
+	// Inputs that do not fit the budget are merged in two passes keeping only winners (if nothing else needs lists).
+	// The sample estimates decompressed sizes, as compressed inputs take much less space on disk than their text.
+	MemoryGovernor governor( options.memoryBudget );
+	if( options.memoryBudget ) {
+		if( !isSampled && !::trySamplingInputs( options.filenames, sample, error ) ) {
+			std::cerr << "Failed to sample inputs: " << error << std::endl;
+			return 1;
+		}
+		const bool needsLists = options.stateDirectory || !options.asOfCutoffs.empty() || options.changeEventsFilename ||
+			options.numConcurrentReaders;
+		if( sample.totalBytes > options.memoryBudget && !needsLists ) {
+			return ::mergeInTwoPasses( options, threadPool, governor );
+		}
+	}
+
 	// Content of all files is read first and is kept at a permanent address during the MergeBuilder lifetime.
 	// The MergeBuilder operates on raw pointers to entries that are assumed to be owned by something else.
-	std::vector<std::vector<Entry>> readLists;
+	const size_t numFiles = options.filenames.size();
+	std::vector<std::vector<Entry>> readLists( numFiles );
+	TitlePool titlePool( options.internTitles, options.compressTitles );
 
-	std::string error;
-	for( int i = 1; i < argc; ++i ) {
-		std::vector<Entry> content;
-		if( !::tryReadingEntries( argv[i], content, error ) ) {
-			std::cerr << "Failed to read a file content of `" << argv[i] << " `: " << error << std::endl;
+	// Lists restored from a persistent state precede the read ones
+	std::vector<std::vector<Entry>> restoredLists;
+	PersistentState state;
+	uint64_t firstSequence = 0;
+	StateRunStats stateStats;
+	if( options.stateDirectory ) {
+		const auto startedAt = std::chrono::steady_clock::now();
+		std::vector<Entry> snapshotEntries;
+		std::vector<std::vector<Entry>> replayedBatches;
+		if( !state.tryOpening( options.stateDirectory, options.durability, titlePool, snapshotEntries, replayedBatches, error ) ) {
+			std::cerr << "Failed to open the persistent state: " << error << std::endl;
 			return 1;
 		}
-		readLists.emplace_back( std::move( content ) );
+		stateStats.recoverySeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startedAt ).count();
+		stateStats.numBatchesReplayed = replayedBatches.size();
+		stateStats.numSnapshotEntries = snapshotEntries.size();
+		restoredLists.emplace_back( std::move( snapshotEntries ) );
+		std::move( replayedBatches.begin(), replayedBatches.end(), std::back_inserter( restoredLists ) );
+		firstSequence = state.reserveSequences( numFiles );
 	}
 
-	MergeBuilder builder;
+	std::vector<std::vector<std::string>> warnings( numFiles );
+	std::vector<std::string> errors( numFiles );
+	std::unique_ptr<bool[]> succeeded( new bool[numFiles] );
+	std::atomic<uint64_t> numEntriesParsed { 0 };
+	// Direct reads bypass the page cache, so there's nothing to read ahead into
+	const size_t prefetchDepth = options.inputMode == DirectInput ? 0 : options.prefetchDepth;
+	InputPrefetcher prefetcher( options.filenames, prefetchDepth );
+	if( progressCounters ) {
+		uint64_t numInputBytes = 0;
+		for( const char *filename: options.filenames ) {
+			numInputBytes += ::getFileSize( filename );
+		}
+		progressCounters->beginStage( ProgressCounters::Loading, numInputBytes );
+	}
+	const auto loadingStartedAt = std::chrono::steady_clock::now();
+	threadPool.parallelFor( numFiles, [&]( size_t i ) {
+		if( prefetchDepth ) {
+			prefetcher.onStarted( i );
+		}
+		const uint64_t readingBytes = ::estimateReadingBytes( options.filenames[i] );
+		governor.acquireTransient( readingBytes );
+		succeeded[i] = ::tryReadingEntries( options.filenames[i], options.inputMode, threadPool, readLists[i], titlePool,
+											options.skipInvalid, warnings[i], errors[i] );
+		governor.releaseTransient( readingBytes );
+		governor.retain( readLists[i].capacity() * sizeof( Entry ) );
+		numEntriesParsed.fetch_add( readLists[i].size(), std::memory_order_relaxed );
+		if( succeeded[i] && options.combine ) {
+			::combineEntries( readLists[i] );
+		}
+		// Log the batch before it gets applied
+		if( succeeded[i] && options.stateDirectory ) {
+			succeeded[i] = state.tryAppending( firstSequence + i, readLists[i], titlePool, errors[i] );
+		}
+	});
+	const double loadingSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - loadingStartedAt ).count();
+	governor.retain( titlePool.numBytesStored() );
+	for( size_t i = 0; i < numFiles; ++i ) {
+		for( const std::string &warning: warnings[i] ) {
+			std::cerr << "Skipping an invalid element of `" << options.filenames[i] << "`: " << warning << std::endl;
+		}
+		if( !succeeded[i] ) {
+			std::cerr << "Failed to read a file content of `" << options.filenames[i] << "`: " << errors[i] << std::endl;
+			return 1;
+		}
+	}
+	// Logged batches of the run get replayed on recovery only if all of them got logged
+	if( options.stateDirectory && !state.tryCommitting( error ) ) {
+		std::cerr << "Failed to commit to the persistent state: " << error << std::endl;
+		return 1;
+	}
+
+	if( !options.asOfCutoffs.empty() ) {
+		return ::writeAsOfSnapshots( options, readLists, titlePool, threadPool, numEntriesParsed.load() );
+	}
+
+	MergeBuilder builder( config );
+	std::atomic<bool> stopReaders { false };
+	std::vector<ConcurrentReadLatencies> readLatencies( options.numConcurrentReaders );
+	std::vector<std::thread> readers;
+	for( unsigned i = 0; i < options.numConcurrentReaders; ++i ) {
+		readers.emplace_back( ::readSnapshotsConcurrently, std::ref( *builder.concurrentlyReadableWinners() ),
+							  std::cref( readLists ), std::cref( stopReaders ), i, std::ref( readLatencies[i] ) );
+	}
+
+	ChangeEventStream changeEvents;
+	if( options.changeEventsFilename && !changeEvents.tryOpening( options.changeEventsFilename, options.changeEventsFormat, error ) ) {
+		std::cerr << "Failed to open change events: " << error << std::endl;
+		return 1;
+	}
+	if( progressCounters ) {
+		uint64_t numEntriesToMerge = numEntriesParsed.load();
+		for( const auto &list: restoredLists ) {
+			numEntriesToMerge += list.size();
+		}
+		progressCounters->beginStage( ProgressCounters::Merging, numEntriesToMerge );
+	}
+	uint32_t listIndex = 0;
+	auto addList = [&]( const std::vector<Entry> &list ) {
+		if( options.changeEventsFilename && progressCounters ) {
+			changeEvents.beginList( listIndex++ );
+			ProgressObserver progressObserver { *progressCounters };
+			ChangeObserverPair<ChangeEventStream, ProgressObserver> observer { changeEvents, progressObserver };
+			builder.addEntries( list, observer );
+		} else if( options.changeEventsFilename ) {
+			changeEvents.beginList( listIndex++ );
+			builder.addEntries( list, changeEvents );
+		} else if( progressCounters ) {
+			ProgressObserver observer { *progressCounters };
+			builder.addEntries( list, observer );
+		} else {
+			builder.addEntries( list );
+		}
+		if( progressCounters ) {
+			progressCounters->onMerged( list.size() );
+		}
+	};
+	const auto mergingStartedAt = std::chrono::steady_clock::now();
+	for( const auto &list: restoredLists ) {
+		addList( list );
+	}
 	for( const auto &list: readLists ) {
-		builder.addEntries( list );
+		addList( list );
+	}
+	const double mergingSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - mergingStartedAt ).count();
+	if( options.changeEventsFilename && !changeEvents.tryClosing( error ) ) {
+		std::cerr << error << std::endl;
+		return 1;
 	}
 
-	printEntries( builder.build() );
+	stopReaders.store( true );
+	for( std::thread &reader: readers ) {
+		reader.join();
+	}
+
+	if( progressCounters ) {
+		progressCounters->beginStage( ProgressCounters::Building, 0 );
+	}
+	const std::vector<const Entry *> entries( builder.build() );
+	// Checkpointing of the persistent state runs on its own thread while the output is written.
+	// A one-shot run has no merges to compact alongside, so compaction is done as a part of this checkpoint.
+	// The output of this run still holds winners that the compacted snapshot drops, so the output of the next run differs.
+	bool checkpointSucceeded = true;
+	std::string checkpointError;
+	std::thread checkpointThread;
+	if( options.stateDirectory && ( options.compact || state.walSize() >= options.checkpointBytes ) ) {
+		checkpointThread = std::thread( [&]() {
+			const auto startedAt = std::chrono::steady_clock::now();
+			if( options.compact ) {
+				const std::vector<const Entry *> compacted( ::selectCompactedWinners( entries, options.compactionPolicy,
+																					  stateStats.numTombstonesDropped, stateStats.numKeysEvicted ) );
+				checkpointSucceeded = state.tryCheckpointing( compacted, titlePool, checkpointError );
+			} else {
+				checkpointSucceeded = state.tryCheckpointing( entries, titlePool, checkpointError );
+			}
+			stateStats.checkpointSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startedAt ).count();
+		});
+	}
+
+	governor.retain( builder.memoryUsage() + entries.capacity() * sizeof( const Entry * ) );
+	EntriesFileWriter fileWriter( titlePool, threadPool );
+	CompressedEntriesWriter compressedWriter( titlePool, threadPool, options.outputCodec );
+	if( progressCounters ) {
+		progressCounters->beginStage( ProgressCounters::Writing, entries.size() );
+	}
+	const bool outputSucceeded = ::tryWritingOutput( options, titlePool, fileWriter, compressedWriter, entries, error );
+	governor.retain( fileWriter.bufferBytes() );
+
+	if( checkpointThread.joinable() ) {
+		checkpointThread.join();
+		if( !checkpointSucceeded ) {
+			std::cerr << "Failed to checkpoint the persistent state: " << checkpointError << std::endl;
+			return 1;
+		}
+	}
+	if( !outputSucceeded ) {
+		std::cerr << "Failed to write the output: " << error << std::endl;
+		return 1;
+	}
+	if( progressCounters ) {
+		progressCounters->beginStage( ProgressCounters::Finished, 0 );
+	}
+
+	if( options.printStats ) {
+		::printEngineStats( options, builder, config.sortAlgorithm, engineChoiceReasoning, mergingSeconds );
+		printStat( "threads", threadPool.numThreads() );
+		if( options.numConcurrentReaders ) {
+			::printConcurrentReadStats( readLatencies, *builder.concurrentlyReadableWinners() );
+		}
+		if( options.stateDirectory ) {
+			::printStateStats( options, state, stateStats );
+		}
+		if( options.changeEventsFilename ) {
+			printStat( "change events", changeEvents.numEvents() );
+			printStat( "change event buffer waits", changeEvents.numWaits() );
+		}
+		::printInputStats( options, loadingSeconds, prefetchDepth ? &prefetcher : nullptr );
+		::printMemoryStats( governor, "single-pass" );
+		printStat( "entries parsed", numEntriesParsed.load() );
+		if( options.combine ) {
+			uint64_t numEntriesCombined = 0;
+			for( const auto &list: readLists ) {
+				numEntriesCombined += list.size();
+			}
+			printStat( "entries left by the combiner", numEntriesCombined );
+			printStat( "combiner reduction ratio", (double)numEntriesParsed.load() / (double)std::max<uint64_t>( 1, numEntriesCombined ) );
+		}
+		::printTitleStats( titlePool, entries );
+		printStat( "entries written", entries.size() );
+		::printOutputStats( options, fileWriter, compressedWriter );
+		if( progressCounters ) {
+			printStat( "progress requests served", monitor.numRequests() );
+		}
+	}
 	return 0;
-}
\ No newline at end of file
+}
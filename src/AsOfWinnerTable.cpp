@@ -0,0 +1,43 @@
+#include "AsOfWinnerTable.h"
+
+#include <algorithm>
+
+void AsOfWinnerTable::addEntries( const std::vector<Entry> &entries ) {
+	for( const Entry &entry: entries ) {
+		// Find the first cutoff that is not before the entry
+		const auto bucket = (uint32_t)( std::lower_bound( cutoffs.begin(), cutoffs.end(), entry.timestamp ) - cutoffs.begin() );
+		if( bucket == cutoffs.size() ) {
+			continue;
+		}
+		std::vector<Version> &versions = versionsByKey[entry.num];
+		auto it = versions.end();
+		while( it != versions.begin() && ( it - 1 )->bucket >= bucket ) {
+			--it;
+		}
+		if( it != versions.end() && it->bucket == bucket ) {
+			if( *it->entry < entry ) {
+				it->entry = &entry;
+			}
+			continue;
+		}
+		versions.insert( it, Version { bucket, &entry } );
+		numStoredVersions++;
+	}
+}
+
+std::vector<const Entry *> AsOfWinnerTable::build( size_t cutoffIndex ) const {
+	std::vector<const Entry *> result;
+	result.reserve( versionsByKey.size() );
+	for( const auto &kvPair: versionsByKey ) {
+		const std::vector<Version> &versions = kvPair.second;
+		auto it = versions.end();
+		while( it != versions.begin() && ( it - 1 )->bucket > cutoffIndex ) {
+			--it;
+		}
+		if( it != versions.begin() ) {
+			result.push_back( ( it - 1 )->entry );
+		}
+	}
+	std::sort( result.begin(), result.end(), []( const Entry *lhs, const Entry *rhs ) { return *lhs < *rhs; } );
+	return result;
+}
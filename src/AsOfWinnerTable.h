@@ -0,0 +1,49 @@
+#ifndef MERGELISTS_AS_OF_WINNER_TABLE_H
+#define MERGELISTS_AS_OF_WINNER_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+#include "Entry.h"
+
+/**
+ * Winners of keys as of several cutoff timestamps collected in a single pass over entries.
+ * Sorted cutoffs split timestamps into buckets, and a key keeps a winner per every bucket it has entries in.
+ * A winner of a key as of a cutoff is the winner of the latest non-empty bucket that does not follow the cutoff.
+ */
+class AsOfWinnerTable {
+	struct Version {
+		uint32_t bucket;
+		const Entry *entry;
+	};
+
+	const std::vector<uint64_t> cutoffs;
+	/**
+	 * Versions of every key ordered by buckets.
+	 */
+	std::unordered_map<int, std::vector<Version>> versionsByKey;
+	size_t numStoredVersions { 0 };
+public:
+	/**
+	 * @param cutoffs_ sorted distinct cutoff timestamps.
+	 */
+	explicit AsOfWinnerTable( std::vector<uint64_t> cutoffs_ ): cutoffs( std::move( cutoffs_ ) ) {}
+
+	void addEntries( const std::vector<Entry> &entries );
+
+	/**
+	 * Builds winners as of the cutoff of the given index sorted by timestamps.
+	 * @note may be called concurrently for different cutoffs.
+	 */
+	std::vector<const Entry *> build( size_t cutoffIndex ) const;
+
+	size_t numCutoffs() const { return cutoffs.size(); }
+	uint64_t cutoff( size_t cutoffIndex ) const { return cutoffs[cutoffIndex]; }
+	size_t numKeys() const { return versionsByKey.size(); }
+	size_t numVersions() const { return numStoredVersions; }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "ChangeEventStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "EntryFormatter.h"
+
+bool ChangeEventStream::tryOpening( const char *filename, Format format_, std::string &error ) {
+	stream.open( filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+	if( !stream.is_open() ) {
+		error = std::string( "Failed to open a file stream of `" ) + filename + "`";
+		return false;
+	}
+	format = format_;
+	buffer.reserve( kFlushThreshold + 256 );
+	writer = std::thread( &ChangeEventStream::drain, this );
+	return true;
+}
+
+void ChangeEventStream::drain() {
+	uint64_t position = head.load( std::memory_order_relaxed );
+	for(;; ) {
+		// Check the flag first, so no events pushed before closing are missed
+		const bool wasClosed = isClosed.load( std::memory_order_acquire );
+		const uint64_t available = tail.load( std::memory_order_acquire );
+		if( position == available ) {
+			if( wasClosed ) {
+				break;
+			}
+			std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+			continue;
+		}
+		// Release drained slots in batches, so the merging thread does not wait for the entire buffer to be drained
+		const uint64_t batchEnd = std::min<uint64_t>( available, position + kMaxDrainBatch );
+		for(; position != batchEnd; ++position ) {
+			appendEvent( events[position & ( kCapacity - 1 )] );
+		}
+		head.store( position, std::memory_order_release );
+		if( buffer.size() >= kFlushThreshold ) {
+			flush();
+		}
+	}
+	flush();
+	stream.flush();
+}
+
+void ChangeEventStream::appendEvent( const Event &event ) {
+	const Entry &newEntry = *event.newEntry;
+	if( format == BinaryFormat ) {
+		BinaryRecord record;
+		std::memset( &record, 0, sizeof( record ) );
+		record.oldTimestamp = event.oldEntry ? event.oldEntry->timestamp : 0;
+		record.newTimestamp = newEntry.timestamp;
+		record.num = newEntry.num;
+		record.list = event.list;
+		record.isReplacement = event.oldEntry != nullptr;
+		record.isDeleted = !newEntry.created;
+		buffer.append( (const char *)&record, sizeof( record ) );
+		return;
+	}
+	buffer.append( event.oldEntry ? "{\"op\":\"replace\",\"list\":" : "{\"op\":\"insert\",\"list\":" );
+	::appendDecimal( buffer, (uint64_t)event.list );
+	buffer.append( ",\"num\":" );
+	::appendDecimal( buffer, newEntry.num );
+	if( event.oldEntry ) {
+		buffer.append( ",\"old_timestamp\":" );
+		::appendDecimal( buffer, event.oldEntry->timestamp );
+	}
+	buffer.append( ",\"timestamp\":" );
+	::appendDecimal( buffer, newEntry.timestamp );
+	buffer.append( newEntry.created ? ",\"deleted\":false}\n" : ",\"deleted\":true}\n" );
+}
+
+bool ChangeEventStream::tryClosing( std::string &error ) {
+	isClosed.store( true, std::memory_order_release );
+	writer.join();
+	if( !stream ) {
+		error = "Failed to write change events";
+		return false;
+	}
+	return true;
+}
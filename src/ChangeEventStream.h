@@ -0,0 +1,145 @@
+#ifndef MERGELISTS_CHANGE_EVENT_STREAM_H
+#define MERGELISTS_CHANGE_EVENT_STREAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "Entry.h"
+
+/**
+ * A stream of changes of winners (change data capture) that is written to a file by a background thread.
+ * The merging thread pushes events into a lock-free single-producer single-consumer ring buffer,
+ * and it waits only if the writer falls behind by the entire buffer.
+ */
+class ChangeEventStream {
+public:
+	enum Format {
+		/**
+		 * A JSON object per line.
+		 */
+		NdjsonFormat,
+		/**
+		 * Fixed-size records of {@code BinaryRecord} layout in the native byte order.
+		 */
+		BinaryFormat
+	};
+
+	struct BinaryRecord {
+		/**
+		 * A timestamp of the replaced winner (zero for insertions).
+		 */
+		uint64_t oldTimestamp;
+		uint64_t newTimestamp;
+		int32_t num;
+		/**
+		 * An index of the list in the order of applying.
+		 */
+		uint32_t list;
+		uint8_t isReplacement;
+		uint8_t isDeleted;
+		uint8_t reserved[6];
+	};
+private:
+	struct Event {
+		/**
+		 * A replaced winner or null for insertions.
+		 */
+		const Entry *oldEntry;
+		const Entry *newEntry;
+		uint32_t list;
+	};
+
+	static constexpr size_t kCapacity = 1u << 16;
+	static constexpr size_t kMaxDrainBatch = 4096;
+	static constexpr size_t kFlushThreshold = 1u << 20;
+
+	std::unique_ptr<Event[]> events;
+	/**
+	 * A position of the next pushed event. It is written only by the merging thread.
+	 */
+	std::atomic<uint64_t> tail { 0 };
+	// Keep positions that are written by different threads on different cache lines
+	char padding[64];
+	/**
+	 * A position of the next drained event. It is written only by the writer thread.
+	 */
+	std::atomic<uint64_t> head { 0 };
+	std::atomic<bool> isClosed { false };
+
+	// The state that is accessed only by the merging thread
+	uint64_t cachedHead { 0 };
+	uint32_t currentList { 0 };
+	uint64_t numProducerWaits { 0 };
+
+	// The state that is accessed only by the writer thread
+	std::ofstream stream;
+	Format format { NdjsonFormat };
+	std::string buffer;
+
+	std::thread writer;
+
+	void push( const Entry *oldEntry, const Entry *newEntry ) {
+		const uint64_t position = tail.load( std::memory_order_relaxed );
+		if( position - cachedHead == kCapacity ) {
+			while( position - ( cachedHead = head.load( std::memory_order_acquire ) ) == kCapacity ) {
+				numProducerWaits++;
+				std::this_thread::yield();
+			}
+		}
+		events[position & ( kCapacity - 1 )] = Event { oldEntry, newEntry, currentList };
+		tail.store( position + 1, std::memory_order_release );
+	}
+
+	void drain();
+	void appendEvent( const Event &event );
+	void flush() {
+		stream.write( buffer.data(), (std::streamsize)buffer.size() );
+		buffer.clear();
+	}
+public:
+	ChangeEventStream(): events( new Event[kCapacity] ) {}
+	~ChangeEventStream() {
+		if( writer.joinable() ) {
+			isClosed.store( true, std::memory_order_release );
+			writer.join();
+		}
+	}
+
+	ChangeEventStream( const ChangeEventStream & ) = delete;
+	ChangeEventStream &operator=( const ChangeEventStream & ) = delete;
+
+	/**
+	 * Opens the file and starts the writer thread.
+	 */
+	bool tryOpening( const char *filename, Format format_, std::string &error );
+
+	/**
+	 * Attributes further events to the list of the given index.
+	 */
+	void beginList( uint32_t list ) { currentList = list; }
+
+	// Events need individual changes, so counts are never reported in bulk
+	static constexpr bool kCountsOnly = false;
+
+	void onInserted( const Entry *entry ) { push( nullptr, entry ); }
+	void onReplaced( const Entry *oldEntry, const Entry *newEntry ) { push( oldEntry, newEntry ); }
+	void onCounted( uint64_t, uint64_t ) {}
+
+	/**
+	 * Writes all pushed events and stops the writer thread.
+	 */
+	bool tryClosing( std::string &error );
+
+	uint64_t numEvents() const { return tail.load( std::memory_order_relaxed ); }
+	/**
+	 * Gets a number of times the merging thread had to wait for the writer.
+	 */
+	uint64_t numWaits() const { return numProducerWaits; }
+};
+
+#endif
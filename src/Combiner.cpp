@@ -0,0 +1,49 @@
+#include "Combiner.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+
+void combineEntries( std::vector<Entry> &entries ) {
+	constexpr size_t kChunkSize = 1u << 15;
+	constexpr size_t kNumSlots = 2 * kChunkSize;
+	struct LocalTable {
+		int keys[kNumSlots];
+		uint32_t values[kNumSlots];
+		/**
+		 * A slot is occupied only if its generation matches the current one, so the table is cleared in O(1).
+		 */
+		uint32_t generations[kNumSlots];
+		uint32_t generation { 0 };
+	};
+	static thread_local std::unique_ptr<LocalTable> table;
+	if( !table ) {
+		table.reset( new LocalTable );
+		std::fill( std::begin( table->generations ), std::end( table->generations ), 0 );
+	}
+
+	size_t numWritten = 0;
+	for( size_t chunkStart = 0; chunkStart < entries.size(); chunkStart += kChunkSize ) {
+		const size_t chunkEnd = std::min( entries.size(), chunkStart + kChunkSize );
+		const uint32_t generation = ++table->generation;
+		for( size_t i = chunkStart; i < chunkEnd; ++i ) {
+			const Entry &entry = entries[i];
+			size_t slot = ( (uint32_t)entry.num * 2654435761u ) & ( kNumSlots - 1 );
+			while( table->generations[slot] == generation && table->keys[slot] != entry.num ) {
+				slot = ( slot + 1 ) & ( kNumSlots - 1 );
+			}
+			if( table->generations[slot] != generation ) {
+				table->generations[slot] = generation;
+				table->keys[slot] = entry.num;
+				table->values[slot] = (uint32_t)numWritten;
+				entries[numWritten++] = entry;
+			} else if( entries[table->values[slot]] < entry ) {
+				// Let the winner occupy the place of the first met entry of the key
+				entries[table->values[slot]] = entry;
+			}
+		}
+	}
+	entries.resize( numWritten );
+}
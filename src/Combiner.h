@@ -0,0 +1,18 @@
+#ifndef MERGELISTS_COMBINER_H
+#define MERGELISTS_COMBINER_H
+
+#include <vector>
+
+#include "Entry.h"
+
+/**
+ * Removes entries that are known to lose to later entries with the same key within the same list.
+ * The list is processed in chunks so every chunk is resolved using a small cache-resident table.
+ * Surviving entries keep their relative order, so the result of merging is the same
+ * (including resolution of ties and sortedness of keys).
+ * @note change events are not the same, as replacements by dropped entries never happen, so the combiner is not used with them.
+ * @param entries a list to combine in-place.
+ */
+void combineEntries( std::vector<Entry> &entries );
+
+#endif
@@ -0,0 +1,33 @@
+#include "Compaction.h"
+
+#include <algorithm>
+
+std::vector<const Entry *> selectCompactedWinners( const std::vector<const Entry *> &winners, const CompactionPolicy &policy,
+												   uint64_t &numTombstonesDropped, uint64_t &numKeysEvicted ) {
+	numTombstonesDropped = numKeysEvicted = 0;
+	if( winners.empty() ) {
+		return winners;
+	}
+	const uint64_t latestTimestamp = winners.back()->timestamp;
+	auto horizonOf = [&]( uint64_t retention ) { return latestTimestamp > retention ? latestTimestamp - retention : 0; };
+	const uint64_t tombstoneHorizon = horizonOf( policy.tombstoneRetention );
+	const uint64_t ttlHorizon = horizonOf( policy.ttl );
+
+	// Winners are sorted, so the ones that are older than the farthest horizon form a prefix, and only it is filtered
+	const uint64_t farthestHorizon = std::max( tombstoneHorizon, ttlHorizon );
+	const auto prefixEnd = std::lower_bound( winners.begin(), winners.end(), farthestHorizon,
+											 []( const Entry *entry, uint64_t horizon ) { return entry->timestamp < horizon; } );
+	std::vector<const Entry *> result;
+	result.reserve( winners.size() );
+	for( auto it = winners.begin(); it != prefixEnd; ++it ) {
+		if( (*it)->timestamp < ttlHorizon ) {
+			numKeysEvicted++;
+		} else if( !(*it)->created ) {
+			numTombstonesDropped++;
+		} else {
+			result.push_back( *it );
+		}
+	}
+	result.insert( result.end(), prefixEnd, winners.end() );
+	return result;
+}
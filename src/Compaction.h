@@ -0,0 +1,32 @@
+#ifndef MERGELISTS_COMPACTION_H
+#define MERGELISTS_COMPACTION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Entry.h"
+
+/**
+ * Rules of dropping winners from a persistent state.
+ * Retention periods are measured in units of timestamps back from the latest timestamp of the state.
+ */
+struct CompactionPolicy {
+	/**
+	 * Deleted winners that are older than this are dropped.
+	 * @note a dropped key may be resurrected by an older entry that is merged later.
+	 */
+	uint64_t tombstoneRetention { UINT64_MAX };
+	/**
+	 * Any winners that are older than this are dropped.
+	 */
+	uint64_t ttl { UINT64_MAX };
+};
+
+/**
+ * Selects winners that should be kept in a compacted state.
+ * @param winners winners sorted by timestamps.
+ */
+std::vector<const Entry *> selectCompactedWinners( const std::vector<const Entry *> &winners, const CompactionPolicy &policy,
+												   uint64_t &numTombstonesDropped, uint64_t &numKeysEvicted );
+
+#endif
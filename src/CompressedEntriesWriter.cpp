@@ -0,0 +1,93 @@
+#include "CompressedEntriesWriter.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "Compression.h"
+#include "Progress.h"
+
+bool CompressedEntriesWriter::isSupported( Codec codec ) {
+	switch( codec ) {
+#ifdef MERGELISTS_WITH_ZLIB
+		case GzipCodec: return true;
+#endif
+#ifdef MERGELISTS_WITH_ZSTD
+		case ZstdCodec: return true;
+#endif
+		default: return false;
+	}
+}
+
+bool CompressedEntriesWriter::tryCompressing( const std::string &data, std::string &output, std::string &error ) const {
+	switch( codec ) {
+#ifdef MERGELISTS_WITH_ZLIB
+		case GzipCodec: return ::tryDeflating( data.data(), data.size(), output, error );
+#endif
+#ifdef MERGELISTS_WITH_ZSTD
+		case ZstdCodec: return ::tryCompressingZstd( data.data(), data.size(), output, error );
+#endif
+		default:
+			(void)data;
+			(void)output;
+			error = "The codec is not supported by this build";
+			return false;
+	}
+}
+
+bool CompressedEntriesWriter::tryWriting( std::ostream &stream, const std::vector<const Entry *> &entries, std::string &error ) {
+	const EscapedTitles *sharedEscapedTitles = nullptr;
+	if( titlePool.isInterning() ) {
+		escapedTitles.update( titlePool, threadPool );
+		sharedEscapedTitles = &escapedTitles;
+	}
+	const size_t numRanges = std::max<size_t>( 1, ( entries.size() + kRangeSize - 1 ) / kRangeSize );
+	numBytesWritten = 0;
+	numFramesWritten = 0;
+	const size_t waveSize = 2 * threadPool.numThreads();
+	buffers.resize( waveSize );
+	frames.resize( waveSize );
+	std::vector<std::string> errors( waveSize );
+	std::unique_ptr<bool[]> succeeded( new bool[waveSize] );
+	for( size_t waveStart = 0; waveStart < numRanges; waveStart += waveSize ) {
+		const size_t numWaveRanges = std::min( waveSize, numRanges - waveStart );
+		threadPool.parallelFor( numWaveRanges, [&]( size_t i ) {
+			const size_t range = waveStart + i;
+			std::string &buffer = buffers[i];
+			buffer.clear();
+			if( entries.empty() ) {
+				buffer.append( kNoEntriesOutput );
+			} else {
+				EntryFormatter formatter( titlePool, sharedEscapedTitles );
+				buffer.append( range ? "" : "[\n" );
+				const size_t end = std::min( entries.size(), ( range + 1 ) * kRangeSize );
+				for( size_t j = range * kRangeSize; j < end; ++j ) {
+					if( j ) {
+						buffer.append( ",\n" );
+					}
+					formatter.append( *entries[j], buffer );
+				}
+				buffer.append( range + 1 == numRanges ? "\n]\n" : "" );
+			}
+			frames[i].clear();
+			succeeded[i] = tryCompressing( buffer, frames[i], errors[i] );
+		});
+		for( size_t i = 0; i < numWaveRanges; ++i ) {
+			if( !succeeded[i] ) {
+				error = errors[i];
+				return false;
+			}
+			stream.write( frames[i].data(), (std::streamsize)frames[i].size() );
+			numBytesWritten += frames[i].size();
+			if( progressCounters ) {
+				const size_t range = waveStart + i;
+				progressCounters->onWritten( frames[i].size(), std::min( entries.size(), ( range + 1 ) * kRangeSize ) - range * kRangeSize );
+			}
+		}
+		numFramesWritten += numWaveRanges;
+	}
+	if( !stream.flush() ) {
+		error = "Failed to write compressed entries";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+#ifndef MERGELISTS_COMPRESSED_ENTRIES_WRITER_H
+#define MERGELISTS_COMPRESSED_ENTRIES_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Entry.h"
+#include "EntryFormatter.h"
+#include "ThreadPool.h"
+#include "TitlePool.h"
+
+/**
+ * Writes entries compressed in the same format as {@code EntriesPrinter} does.
+ * Ranges of entries are formatted and compressed in parallel to independent zstd frames or gzip members,
+ * and they are written in order. Ranges are processed in waves, so memory stays bounded.
+ */
+class CompressedEntriesWriter {
+public:
+	enum Codec {
+		GzipCodec,
+		ZstdCodec
+	};
+private:
+	const TitlePool &titlePool;
+	ThreadPool &threadPool;
+	const Codec codec;
+	uint64_t numBytesWritten { 0 };
+	size_t numFramesWritten { 0 };
+	/**
+	 * Buffers of formatted and compressed ranges that are kept for reuse by further writes.
+	 */
+	std::vector<std::string> buffers, frames;
+	/**
+	 * Escaped titles that are shared by formatters of ranges if titles are interned (so they are likely to be met many times).
+	 */
+	EscapedTitles escapedTitles;
+
+	static constexpr size_t kRangeSize = 1u << 14;
+
+	bool tryCompressing( const std::string &data, std::string &output, std::string &error ) const;
+public:
+	CompressedEntriesWriter( const TitlePool &titlePool_, ThreadPool &threadPool_, Codec codec_ )
+		: titlePool( titlePool_ ), threadPool( threadPool_ ), codec( codec_ ) {}
+
+	/**
+	 * Checks whether this build supports the codec.
+	 */
+	static bool isSupported( Codec codec );
+
+	bool tryWriting( std::ostream &stream, const std::vector<const Entry *> &entries, std::string &error );
+
+	uint64_t numBytes() const { return numBytesWritten; }
+	size_t numFrames() const { return numFramesWritten; }
+};
+
+#endif
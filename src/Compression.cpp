@@ -0,0 +1,332 @@
+#include "Compression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#ifdef MERGELISTS_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MERGELISTS_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef MERGELISTS_WITH_ZLIB
+bool tryInflating( const char *data, size_t size, const DecompressedSink &sink, std::string &error ) {
+	constexpr size_t kOutputStep = 1u << 20;
+	constexpr size_t kMaxInputStep = 1u << 30;
+	z_stream stream;
+	std::memset( &stream, 0, sizeof( stream ) );
+	// Expect a gzip header
+	if( ::inflateInit2( &stream, 15 + 16 ) != Z_OK ) {
+		error = "Failed to initialize inflating";
+		return false;
+	}
+	std::unique_ptr<z_stream, int ( * )( z_stream * )> streamHolder( &stream, &::inflateEnd );
+	std::unique_ptr<char[]> buffer( new char[kOutputStep] );
+	// The end of the input that has been given to the stream
+	const char *p = data;
+	const char *const end = data + size;
+	for(;; ) {
+		// The input size is limited by the width of the field
+		if( !stream.avail_in && p != end ) {
+			const size_t step = std::min<size_t>( kMaxInputStep, (size_t)( end - p ) );
+			stream.next_in = (Bytef *)p;
+			stream.avail_in = (uInt)step;
+			p += step;
+		}
+		stream.next_out = (Bytef *)buffer.get();
+		stream.avail_out = (uInt)kOutputStep;
+		const int result = ::inflate( &stream, Z_NO_FLUSH );
+		const size_t numProduced = kOutputStep - stream.avail_out;
+		if( numProduced && !sink( buffer.get(), numProduced ) ) {
+			return true;
+		}
+		if( result == Z_STREAM_END ) {
+			// Another member may follow, but anything else is ignored the same way gzip does.
+			// The whole rest of the input is checked, as a member may end right at the end of an input step.
+			const Bytef *next = stream.next_in;
+			const auto numRemaining = (size_t)( end - (const char *)next );
+			if( numRemaining < 2 || next[0] != 0x1f || next[1] != 0x8b ) {
+				return true;
+			}
+			::inflateReset( &stream );
+			stream.avail_in = (uInt)std::min<size_t>( kMaxInputStep, numRemaining );
+			p = (const char *)next + stream.avail_in;
+		} else if( result == Z_BUF_ERROR ) {
+			if( !stream.avail_in && p == end ) {
+				error = "A gzip member is truncated";
+				return false;
+			}
+		} else if( result != Z_OK ) {
+			error = "Failed to inflate: " + std::string( stream.msg ? stream.msg : "malformed data" );
+			return false;
+		}
+	}
+}
+
+bool tryDeflating( const char *data, size_t size, std::string &output, std::string &error ) {
+	z_stream stream;
+	std::memset( &stream, 0, sizeof( stream ) );
+	// Write a gzip header
+	if( ::deflateInit2( &stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+		error = "Failed to initialize deflating";
+		return false;
+	}
+	std::unique_ptr<z_stream, int ( * )( z_stream * )> streamHolder( &stream, &::deflateEnd );
+	const size_t oldSize = output.size();
+	output.resize( oldSize + ::deflateBound( &stream, (uLong)size ) );
+	stream.next_in = (Bytef *)data;
+	stream.avail_in = (uInt)size;
+	stream.next_out = (Bytef *)&output[oldSize];
+	stream.avail_out = (uInt)( output.size() - oldSize );
+	if( ::deflate( &stream, Z_FINISH ) != Z_STREAM_END ) {
+		error = "Failed to deflate: " + std::string( stream.msg ? stream.msg : "the output bound is exceeded" );
+		return false;
+	}
+	output.resize( oldSize + stream.total_out );
+	return true;
+}
+
+/**
+ * Splits gzip data to members if sizes of members are specified in headers (as bgzip does).
+ * @return false if there are no sizes in headers.
+ */
+static bool trySplittingGzipMembers( const std::string &content, std::vector<std::pair<size_t, size_t>> &members ) {
+	members.clear();
+	for( size_t offset = 0; offset < content.size(); ) {
+		const auto *header = (const unsigned char *)content.data() + offset;
+		const size_t available = content.size() - offset;
+		// An extra field of 6 bytes that starts the BC subfield of 2 bytes
+		constexpr unsigned kFlagExtra = 4;
+		if( available < 18 || header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || !( header[3] & kFlagExtra ) ||
+			header[10] != 6 || header[11] != 0 || header[12] != 'B' || header[13] != 'C' || header[14] != 2 || header[15] != 0 ) {
+			return false;
+		}
+		const size_t memberSize = ( header[16] | ( header[17] << 8 ) ) + 1u;
+		if( memberSize > available ) {
+			return false;
+		}
+		members.emplace_back( offset, memberSize );
+		offset += memberSize;
+	}
+	return true;
+}
+
+/**
+ * Reads a decompressed size of a gzip member from its trailer.
+ */
+static size_t getGzipMemberContentSize( const char *data, size_t size ) {
+	const auto *trailer = (const unsigned char *)data + size - 4;
+	return size < 18 ? 0 : trailer[0] | ( trailer[1] << 8 ) | ( trailer[2] << 16 ) | ( (size_t)trailer[3] << 24 );
+}
+#endif
+
+#ifdef MERGELISTS_WITH_ZSTD
+bool tryDecompressingZstd( const char *data, size_t size, const DecompressedSink &sink, std::string &error ) {
+	constexpr size_t kOutputStep = 1u << 20;
+	std::unique_ptr<ZSTD_DCtx, size_t ( * )( ZSTD_DCtx * )> context( ::ZSTD_createDCtx(), &::ZSTD_freeDCtx );
+	std::unique_ptr<char[]> buffer( new char[kOutputStep] );
+	ZSTD_inBuffer input { data, size, 0 };
+	for(;; ) {
+		ZSTD_outBuffer outputBuffer { buffer.get(), kOutputStep, 0 };
+		const size_t result = ::ZSTD_decompressStream( context.get(), &outputBuffer, &input );
+		if( ::ZSTD_isError( result ) ) {
+			error = "Failed to decompress: " + std::string( ::ZSTD_getErrorName( result ) );
+			return false;
+		}
+		if( outputBuffer.pos && !sink( buffer.get(), outputBuffer.pos ) ) {
+			return true;
+		}
+		// Zero means that a frame is complete and flushed
+		if( input.pos == input.size ) {
+			if( !result ) {
+				return true;
+			}
+			if( outputBuffer.pos < kOutputStep ) {
+				error = "A zstd frame is truncated";
+				return false;
+			}
+		}
+	}
+}
+
+bool tryCompressingZstd( const char *data, size_t size, std::string &output, std::string &error ) {
+	constexpr int kLevel = 3;
+	const size_t oldSize = output.size();
+	output.resize( oldSize + ::ZSTD_compressBound( size ) );
+	const size_t result = ::ZSTD_compress( &output[oldSize], output.size() - oldSize, data, size, kLevel );
+	if( ::ZSTD_isError( result ) ) {
+		error = "Failed to compress: " + std::string( ::ZSTD_getErrorName( result ) );
+		return false;
+	}
+	output.resize( oldSize + result );
+	return true;
+}
+
+static bool trySplittingZstdFrames( const std::string &content, std::vector<std::pair<size_t, size_t>> &frames, std::string &error ) {
+	frames.clear();
+	for( size_t offset = 0; offset < content.size(); ) {
+		const size_t frameSize = ::ZSTD_findFrameCompressedSize( content.data() + offset, content.size() - offset );
+		if( ::ZSTD_isError( frameSize ) ) {
+			error = "Malformed zstd frame at byte offset " + std::to_string( offset ) + ": " + ::ZSTD_getErrorName( frameSize );
+			return false;
+		}
+		frames.emplace_back( offset, frameSize );
+		offset += frameSize;
+	}
+	return true;
+}
+
+/**
+ * Reads a decompressed size of a zstd frame from its header.
+ * @return zero if the size is not specified.
+ */
+static size_t getZstdFrameContentSize( const char *data, size_t size ) {
+	const unsigned long long result = ::ZSTD_getFrameContentSize( data, size );
+	return result == ZSTD_CONTENTSIZE_UNKNOWN || result == ZSTD_CONTENTSIZE_ERROR || result > SIZE_MAX ? 0 : (size_t)result;
+}
+#endif
+
+DecompressingStream::~DecompressingStream() {
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		isCancelled = true;
+	}
+	condition.notify_all();
+	if( thread.joinable() ) {
+		thread.join();
+	}
+}
+
+bool DecompressingStream::isCompressed( const char *data, size_t size ) {
+	const auto *magic = (const unsigned char *)data;
+	const bool isGzip = size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+	const bool isZstd = size >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd;
+	return isGzip || isZstd;
+}
+
+bool DecompressingStream::tryStarting( std::string &error_ ) {
+	size_t ( *getContentSize )( const char *, size_t ) = nullptr;
+	if( (unsigned char)content[0] == 0x1f ) {
+#ifdef MERGELISTS_WITH_ZLIB
+		if( !::trySplittingGzipMembers( content, units ) ) {
+			units.assign( 1, std::make_pair( (size_t)0, content.size() ) );
+		}
+		decompress = ::tryInflating;
+		getContentSize = ::getGzipMemberContentSize;
+#else
+		error_ = "The content is gzip-compressed, but this build does not support gzip";
+		return false;
+#endif
+	} else {
+#ifdef MERGELISTS_WITH_ZSTD
+		if( !::trySplittingZstdFrames( content, units, error_ ) ) {
+			return false;
+		}
+		decompress = ::tryDecompressingZstd;
+		getContentSize = ::getZstdFrameContentSize;
+#else
+		error_ = "The content is zstd-compressed, but this build does not support zstd";
+		return false;
+#endif
+	}
+	for( const auto &unit: units ) {
+		unitContentSizes.push_back( getContentSize( content.data() + unit.first, unit.second ) );
+	}
+	thread = std::thread( &DecompressingStream::run, this );
+	return true;
+}
+
+void DecompressingStream::run() {
+	// The consumer may stop the stream before the content ends
+	bool isStopped = false;
+	const DecompressedSink sink = [&]( const char *data, size_t size ) {
+		isStopped = !push( data, size );
+		return !isStopped;
+	};
+	std::string runError;
+	bool runSucceeded = true;
+	const auto isStreamed = [this]( size_t i ) {
+		return units.size() == 1 || !unitContentSizes[i] || unitContentSizes[i] > kMaxWaveBytes;
+	};
+	for( size_t waveBegin = 0; waveBegin < units.size() && runSucceeded && !isStopped; ) {
+		if( isStreamed( waveBegin ) ) {
+			const std::pair<size_t, size_t> &unit = units[waveBegin++];
+			runSucceeded = decompress( content.data() + unit.first, unit.second, sink, runError );
+			continue;
+		}
+		size_t waveEnd = waveBegin, waveBytes = 0;
+		while( waveEnd < units.size() && !isStreamed( waveEnd ) && waveBytes + unitContentSizes[waveEnd] <= kMaxWaveBytes ) {
+			waveBytes += unitContentSizes[waveEnd++];
+		}
+		const size_t numUnits = waveEnd - waveBegin;
+		std::vector<std::string> pieces( numUnits ), errors( numUnits );
+		std::unique_ptr<bool[]> unitSucceeded( new bool[numUnits] );
+		threadPool.parallelFor( numUnits, [&]( size_t i ) {
+			std::string &piece = pieces[i];
+			const std::pair<size_t, size_t> &unit = units[waveBegin + i];
+			unitSucceeded[i] = decompress( content.data() + unit.first, unit.second, [&piece]( const char *data, size_t size ) {
+				piece.append( data, size );
+				return true;
+			}, errors[i] );
+		});
+		for( size_t i = 0; i < numUnits && runSucceeded && !isStopped; ++i ) {
+			if( !unitSucceeded[i] ) {
+				runSucceeded = false;
+				runError = errors[i];
+			} else {
+				sink( pieces[i].data(), pieces[i].size() );
+			}
+			std::string().swap( pieces[i] );
+		}
+		waveBegin = waveEnd;
+	}
+	if( runSucceeded && !isStopped && !pendingChunk.empty() ) {
+		tryQueueingPendingChunk();
+	}
+
+	std::lock_guard<std::mutex> lock( mutex );
+	isFinished = true;
+	succeeded = runSucceeded;
+	error = runError;
+	condition.notify_all();
+}
+
+bool DecompressingStream::push( const char *data, size_t size ) {
+	pendingChunk.append( data, size );
+	return pendingChunk.size() < kChunkSize || tryQueueingPendingChunk();
+}
+
+bool DecompressingStream::tryQueueingPendingChunk() {
+	std::unique_lock<std::mutex> lock( mutex );
+	condition.wait( lock, [this]() { return isCancelled || chunks.size() < kMaxQueuedChunks; } );
+	if( isCancelled ) {
+		return false;
+	}
+	chunks.emplace_back( std::move( pendingChunk ) );
+	pendingChunk.clear();
+	condition.notify_all();
+	return true;
+}
+
+bool DecompressingStream::tryPopping( std::string &chunk ) {
+	std::unique_lock<std::mutex> lock( mutex );
+	condition.wait( lock, [this]() { return isFinished || !chunks.empty(); } );
+	if( chunks.empty() ) {
+		return false;
+	}
+	chunk = std::move( chunks.front() );
+	chunks.pop_front();
+	condition.notify_all();
+	return true;
+}
+
+bool DecompressingStream::tryFinishing( std::string &error_ ) {
+	thread.join();
+	if( !succeeded ) {
+		error_ = error;
+	}
+	return succeeded;
+}
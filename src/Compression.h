@@ -0,0 +1,126 @@
+#ifndef MERGELISTS_COMPRESSION_H
+#define MERGELISTS_COMPRESSION_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/**
+ * Receives decompressed data step by step.
+ * @return false to stop decompression.
+ */
+typedef std::function<bool( const char *, size_t )> DecompressedSink;
+
+#ifdef MERGELISTS_WITH_ZLIB
+/**
+ * Inflates consecutive gzip members passing the result to the sink.
+ */
+bool tryInflating( const char *data, size_t size, const DecompressedSink &sink, std::string &error );
+
+/**
+ * Deflates the data into a single gzip member appending it to the output.
+ */
+bool tryDeflating( const char *data, size_t size, std::string &output, std::string &error );
+#endif
+
+#ifdef MERGELISTS_WITH_ZSTD
+/**
+ * Decompresses consecutive zstd frames passing the result to the sink.
+ */
+bool tryDecompressingZstd( const char *data, size_t size, const DecompressedSink &sink, std::string &error );
+
+/**
+ * Compresses the data into a single zstd frame appending it to the output.
+ */
+bool tryCompressingZstd( const char *data, size_t size, std::string &output, std::string &error );
+#endif
+
+/**
+ * Decompresses content in a separate thread passing the result to a consumer in chunks.
+ * Chunks go through a bounded queue, so decompression runs only a few chunks ahead of the consumer.
+ * Independent zstd frames and gzip members of known sizes are decompressed in parallel in waves of a bounded size.
+ */
+class DecompressingStream {
+	static constexpr size_t kChunkSize = 4u << 20;
+	static constexpr size_t kMaxQueuedChunks = 4;
+	/**
+	 * A limit of decompressed bytes of units that are decompressed in parallel at once.
+	 * Units of unknown or larger sizes are streamed one by one.
+	 */
+	static constexpr size_t kMaxWaveBytes = 4u << 20;
+
+	const std::string &content;
+	ThreadPool &threadPool;
+	std::function<bool( const char *, size_t, const DecompressedSink &, std::string & )> decompress;
+	/**
+	 * Independent units of compressed data (offsets and sizes).
+	 */
+	std::vector<std::pair<size_t, size_t>> units;
+	/**
+	 * Decompressed sizes of units declared by their headers or zeros if they are unknown.
+	 */
+	std::vector<size_t> unitContentSizes;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::string> chunks;
+	bool isFinished { false };
+	bool isCancelled { false };
+	bool succeeded { true };
+	std::string error;
+	std::thread thread;
+
+	/**
+	 * A chunk that is being filled by the decompressing thread.
+	 */
+	std::string pendingChunk;
+
+	void run();
+	bool push( const char *data, size_t size );
+	bool tryQueueingPendingChunk();
+public:
+	/**
+	 * A bound of decompressed bytes the stream holds at once: a wave, queued chunks and a chunk that's being filled.
+	 * A consumer holds a popped chunk in addition.
+	 */
+	static constexpr size_t kMaxBufferedBytes = kMaxWaveBytes + ( kMaxQueuedChunks + 2 ) * kChunkSize;
+
+	DecompressingStream( const std::string &content_, ThreadPool &threadPool_ ): content( content_ ), threadPool( threadPool_ ) {}
+	~DecompressingStream();
+
+	DecompressingStream( const DecompressingStream & ) = delete;
+	DecompressingStream &operator=( const DecompressingStream & ) = delete;
+
+	/**
+	 * Checks whether the content is compressed (that's detected by magic bytes).
+	 */
+	static bool isCompressed( const char *data, size_t size );
+
+	/**
+	 * Starts decompressing the content.
+	 * @return false if the content is compressed by a codec that is not supported by this build or it's malformed.
+	 */
+	bool tryStarting( std::string &error );
+
+	/**
+	 * Waits for the next chunk of the result.
+	 * @return false if there are no chunks left (either the result is complete or decompression has failed).
+	 */
+	bool tryPopping( std::string &chunk );
+
+	/**
+	 * Waits for completion of decompression.
+	 * @return true if all the content has been decompressed.
+	 */
+	bool tryFinishing( std::string &error );
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "EngineChoice.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include "Compression.h"
+#include "EntriesParser.h"
+#include "Entry.h"
+#include "TitlePool.h"
+
+constexpr size_t InputSample::kBytesPerFile;
+
+/**
+ * Decompresses as much of a truncated compressed content as possible.
+ * @param maxSize a limit of the result, so highly compressed content does not blow up.
+ * @return false if this build does not support the codec or nothing could be decompressed.
+ */
+static bool tryDecompressingPrefix( const char *data, size_t size, size_t maxSize, std::string &output ) {
+	output.clear();
+	const DecompressedSink sink = [&]( const char *part, size_t partSize ) {
+		output.append( part, std::min( partSize, maxSize - output.size() ) );
+		return output.size() < maxSize;
+	};
+	// The content is truncated, so a failure at its end is expected
+	std::string ignoredError;
+	if( (unsigned char)data[0] == 0x1f ) {
+#ifdef MERGELISTS_WITH_ZLIB
+		::tryInflating( data, size, sink, ignoredError );
+#else
+		(void)size;
+#endif
+	} else {
+#ifdef MERGELISTS_WITH_ZSTD
+		::tryDecompressingZstd( data, size, sink, ignoredError );
+#else
+		(void)size;
+#endif
+	}
+	return !output.empty();
+}
+
+bool trySamplingInputs( const std::vector<const char *> &filenames, InputSample &sample, std::string &error ) {
+	// Compressed prefixes are decompressed up to this size to estimate compression ratios
+	constexpr size_t kMaxDecompressedBytes = 64 * InputSample::kBytesPerFile;
+	TitlePool scratchPool( false, false );
+	std::unordered_set<int> keys;
+	std::vector<char> buffer( InputSample::kBytesPerFile );
+	std::string decompressed;
+	std::vector<Entry> entries;
+	for( const char *filename: filenames ) {
+		std::ifstream stream;
+		stream.open( filename, std::ios_base::in | std::ios_base::binary );
+		if( !stream.is_open() ) {
+			error = std::string( "Failed to open a file stream of `" ) + filename + "`";
+			return false;
+		}
+		stream.seekg( 0, std::ios_base::end );
+		const auto fileSize = (uint64_t)std::max<std::streamoff>( 0, stream.tellg() );
+		stream.seekg( 0, std::ios_base::beg );
+		stream.read( buffer.data(), (std::streamsize)buffer.size() );
+		const auto numBytesRead = (size_t)stream.gcount();
+		const char *text = buffer.data();
+		size_t textSize = numBytesRead;
+		if( DecompressingStream::isCompressed( buffer.data(), numBytesRead ) ) {
+			sample.numCompressedFiles++;
+			if( !::tryDecompressingPrefix( buffer.data(), numBytesRead, kMaxDecompressedBytes, decompressed ) ) {
+				sample.numUnsampledFiles++;
+				sample.totalBytes += fileSize;
+				continue;
+			}
+			sample.totalBytes += (uint64_t)( (double)fileSize * (double)decompressed.size() / (double)numBytesRead );
+			text = decompressed.data();
+			textSize = std::min( decompressed.size(), InputSample::kBytesPerFile );
+		} else {
+			sample.totalBytes += fileSize;
+		}
+		sample.sampledBytes += textSize;
+
+		EntriesParser( text, text + textSize, scratchPool ).parsePrefix( entries );
+		for( size_t i = 0; i < entries.size(); ++i ) {
+			const int num = entries[i].num;
+			keys.insert( num );
+			sample.minNum = std::min<int64_t>( sample.minNum, num );
+			sample.maxNum = std::max<int64_t>( sample.maxNum, num );
+			if( i && entries[i - 1].num > num ) {
+				sample.allSorted = false;
+			}
+		}
+		sample.numSampledEntries += entries.size();
+	}
+
+	sample.numDistinctSampledKeys = keys.size();
+	if( !sample.numSampledEntries ) {
+		return true;
+	}
+	sample.averageTitleLength = (double)scratchPool.numBytesAdded() / (double)scratchPool.numTitlesAdded();
+	const double bytesPerEntry = (double)sample.sampledBytes / (double)sample.numSampledEntries;
+	sample.estimatedNumEntries = (uint64_t)( (double)sample.totalBytes / bytesPerEntry );
+	const double distinctRatio = (double)sample.numDistinctSampledKeys / (double)sample.numSampledEntries;
+	const auto span = (uint64_t)( sample.maxNum - sample.minNum + 1 );
+	sample.estimatedNumKeys = std::min<uint64_t>( (uint64_t)( distinctRatio * (double)sample.estimatedNumEntries ), span );
+	sample.estimatedNumKeys = std::max<uint64_t>( sample.estimatedNumKeys, sample.numDistinctSampledKeys );
+	return true;
+}
+
+void chooseEngine( const InputSample &sample, size_t numFiles, MergeBuilder::Config &config,
+				   unsigned &numThreads, std::string &reasoning ) {
+	std::ostringstream explanation;
+	explanation << "sampled " << sample.numSampledEntries << " entries of " << sample.sampledBytes << " bytes";
+	if( sample.numCompressedFiles ) {
+		explanation << " (decompressing prefixes of " << sample.numCompressedFiles << " compressed inputs)";
+	}
+	if( sample.numUnsampledFiles ) {
+		explanation << "; " << sample.numUnsampledFiles << " compressed inputs could not be decompressed by this build"
+					<< " and were not sampled, their compressed sizes are used";
+	}
+	explanation << ", estimated " << sample.estimatedNumEntries << " entries and " << sample.estimatedNumKeys << " keys";
+
+	const auto span = sample.numSampledEntries ? (uint64_t)( sample.maxNum - sample.minNum + 1 ) : 0;
+	if( !sample.numSampledEntries ) {
+		config.engine = MergeBuilder::HashEngine;
+		explanation << "; nothing to sample, using the hash engine";
+	} else if( sample.allSorted && numFiles > 1 ) {
+		config.engine = MergeBuilder::SortedEngine;
+		explanation << "; inputs are sorted by keys, using the k-way merge engine";
+	} else if( span <= 4 * sample.estimatedNumKeys && span <= ( 1u << 28 ) ) {
+		config.engine = MergeBuilder::DenseEngine;
+		explanation << "; keys span " << span << " values densely, using the dense engine";
+	} else if( sample.estimatedNumKeys >= ( 1u << 22 ) ) {
+		config.engine = MergeBuilder::PartitionedEngine;
+		explanation << "; too many distinct keys for a single table, using the partitioned engine";
+	} else {
+		config.engine = MergeBuilder::HashEngine;
+		explanation << "; keys are sparse with a duplication factor of ";
+		explanation << (double)sample.numSampledEntries / (double)std::max<size_t>( 1, sample.numDistinctSampledKeys );
+		explanation << ", using the hash engine";
+	}
+	config.expectedNumKeys = (size_t)sample.estimatedNumKeys;
+
+	if( sample.estimatedNumKeys >= ( 1u << 16 ) ) {
+		config.sortAlgorithm = MergeBuilder::RadixSort;
+		explanation << "; the radix sort suits the estimated number of winners";
+	} else {
+		config.sortAlgorithm = MergeBuilder::ComparisonSort;
+		explanation << "; the comparison sort suits the estimated number of winners";
+	}
+
+	// Parsing dominates the work, and it's proportional to the input size rather than to the number of entries
+	const unsigned hardwareThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	if( sample.totalBytes < ( 8u << 20 ) ) {
+		numThreads = 1;
+		explanation << "; inputs of " << sample.totalBytes << " bytes are too small for parallel loading";
+	} else {
+		numThreads = (unsigned)std::min<size_t>( hardwareThreads, numFiles );
+		explanation << "; using " << numThreads << " threads for " << numFiles << " inputs of " << sample.totalBytes;
+		explanation << " bytes with an average title length of " << sample.averageTitleLength;
+	}
+	reasoning = explanation.str();
+}
+
+const char *engineName( MergeBuilder::Engine engine ) {
+	switch( engine ) {
+		case MergeBuilder::HashEngine: return "hash";
+		case MergeBuilder::DenseEngine: return "dense";
+		case MergeBuilder::SortedEngine: return "sorted";
+		case MergeBuilder::PartitionedEngine: return "partitioned";
+		default: return "concurrent";
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef MERGELISTS_ENGINE_CHOICE_H
+#define MERGELISTS_ENGINE_CHOICE_H
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MergeBuilder.h"
+
+/**
+ * Characteristics of inputs estimated using the first entries (the first megabyte) of every input.
+ */
+struct InputSample {
+	static constexpr size_t kBytesPerFile = 1u << 20;
+
+	/**
+	 * A total size of inputs. Sizes of compressed inputs are extrapolated using ratios of their sampled prefixes.
+	 */
+	uint64_t totalBytes { 0 };
+	uint64_t sampledBytes { 0 };
+	size_t numCompressedFiles { 0 };
+	/**
+	 * Compressed inputs that could not be decompressed for sampling. They're counted by their compressed sizes.
+	 */
+	size_t numUnsampledFiles { 0 };
+	size_t numSampledEntries { 0 };
+	size_t numDistinctSampledKeys { 0 };
+	int64_t minNum { INT_MAX };
+	int64_t maxNum { INT_MIN };
+	/**
+	 * Whether keys are non-decreasing within the sampled part of every input.
+	 */
+	bool allSorted { true };
+	double averageTitleLength { 0.0 };
+	uint64_t estimatedNumEntries { 0 };
+	uint64_t estimatedNumKeys { 0 };
+};
+
+bool trySamplingInputs( const std::vector<const char *> &filenames, InputSample &sample, std::string &error );
+
+/**
+ * Picks a merge engine, a sort algorithm and a number of threads that should suit the sampled inputs.
+ * @param reasoning a human-readable explanation of the choice.
+ */
+void chooseEngine( const InputSample &sample, size_t numFiles, MergeBuilder::Config &config,
+				   unsigned &numThreads, std::string &reasoning );
+
+const char *engineName( MergeBuilder::Engine engine );
+
+#endif
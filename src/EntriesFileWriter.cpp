@@ -0,0 +1,148 @@
+#include "EntriesFileWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Progress.h"
+
+bool EntriesFileWriter::tryWritingAt( int fd, const std::string &data, uint64_t offset, std::string &error ) {
+	for( size_t written = 0; written < data.size(); ) {
+		const ssize_t result = ::pwrite( fd, data.data() + written, data.size() - written, (off_t)( offset + written ) );
+		if( result < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			error = "Failed to write: " + std::string( std::strerror( errno ) );
+			return false;
+		}
+		written += (size_t)result;
+	}
+	return true;
+}
+
+bool EntriesFileWriter::tryWriting( const char *filename, const std::vector<const Entry *> &entries, std::string &error ) {
+	const EscapedTitles *sharedEscapedTitles = nullptr;
+	if( titlePool.isInterning() ) {
+		escapedTitles.update( titlePool, threadPool );
+		sharedEscapedTitles = &escapedTitles;
+	}
+	const int fd = ::open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( fd < 0 ) {
+		error = std::string( "Failed to open `" ) + filename + "`: " + std::strerror( errno );
+		return false;
+	}
+
+	if( entries.empty() ) {
+		const bool succeeded = tryWritingAt( fd, kNoEntriesOutput, 0, error );
+		numBytesWritten = succeeded ? std::strlen( kNoEntriesOutput ) : 0;
+		offsets.assign( isRecordingOffsets ? 1 : 0, 0 );
+		return ( ::close( fd ) == 0 ) && succeeded;
+	}
+
+	// Split entries into ranges, so there are a few ranges per thread to balance the load
+	const size_t numEntries = entries.size();
+	const size_t numRanges = std::max<size_t>( 1, std::min<size_t>( numEntries / kMinRangeSize, 4 * threadPool.numThreads() ) );
+	auto rangeBegin = [&]( size_t range ) { return numEntries * range / numRanges; };
+
+	// Compute lengths of ranges (an entry is preceded by a separator unless it's the first one)
+	std::vector<uint64_t> rangeOffsets( numRanges + 1 );
+	threadPool.parallelFor( numRanges, [&]( size_t range ) {
+		EntryFormatter formatter( titlePool, sharedEscapedTitles );
+		uint64_t length = 0;
+		for( size_t i = rangeBegin( range ); i < rangeBegin( range + 1 ); ++i ) {
+			length += ( i ? 2 : 0 ) + formatter.length( *entries[i] );
+		}
+		rangeOffsets[range + 1] = length;
+	});
+	// Prefix sums give offsets of ranges that follow the opening bracket
+	rangeOffsets[0] = 2;
+	for( size_t range = 0; range < numRanges; ++range ) {
+		rangeOffsets[range + 1] += rangeOffsets[range];
+	}
+	const uint64_t fileSize = rangeOffsets[numRanges] + 3;
+	if( isRecordingOffsets ) {
+		offsets.resize( numEntries + 1 );
+		// The last entry is followed by a line feed instead of a separator
+		offsets[numEntries] = rangeOffsets[numRanges] + 2;
+	} else {
+		offsets.clear();
+	}
+
+	// Reserve space at once so concurrent writes do not extend the file piecewise
+	const int allocationResult = ::posix_fallocate( fd, 0, (off_t)fileSize );
+	if( allocationResult && ::ftruncate( fd, (off_t)fileSize ) < 0 ) {
+		error = "Failed to allocate " + std::to_string( fileSize ) + " bytes: " + std::strerror( allocationResult );
+		::close( fd );
+		return false;
+	}
+
+	std::vector<std::string> errors( numRanges );
+	if( buffers.size() < numRanges ) {
+		buffers.resize( numRanges );
+	}
+	threadPool.parallelFor( numRanges, [&]( size_t range ) {
+		EntryFormatter formatter( titlePool, sharedEscapedTitles );
+		std::string &buffer = buffers[range];
+		buffer.clear();
+		buffer.reserve( kWriteThreshold + 4096 );
+		uint64_t offset = rangeOffsets[range];
+		if( !range ) {
+			buffer.append( "[\n" );
+			offset = 0;
+		}
+		size_t numFlushed = rangeBegin( range );
+		for( size_t i = rangeBegin( range ); i < rangeBegin( range + 1 ); ++i ) {
+			if( i ) {
+				buffer.append( ",\n" );
+			}
+			if( isRecordingOffsets ) {
+				offsets[i] = offset + buffer.size();
+			}
+			formatter.append( *entries[i], buffer );
+			if( buffer.size() >= kWriteThreshold ) {
+				if( !tryWritingAt( fd, buffer, offset, errors[range] ) ) {
+					return;
+				}
+				if( progressCounters ) {
+					progressCounters->onWritten( buffer.size(), i + 1 - numFlushed );
+					numFlushed = i + 1;
+				}
+				offset += buffer.size();
+				buffer.clear();
+			}
+		}
+		if( range + 1 == numRanges ) {
+			buffer.append( "\n]\n" );
+		}
+		if( !tryWritingAt( fd, buffer, offset, errors[range] ) ) {
+			return;
+		}
+		if( progressCounters ) {
+			progressCounters->onWritten( buffer.size(), rangeBegin( range + 1 ) - numFlushed );
+		}
+		offset += buffer.size();
+		const uint64_t expectedEnd = range + 1 == numRanges ? fileSize : rangeOffsets[range + 1];
+		if( offset != expectedEnd ) {
+			errors[range] = "Formatted entries do not match their precomputed length";
+		}
+	});
+
+	for( const std::string &rangeError: errors ) {
+		if( !rangeError.empty() ) {
+			error = rangeError;
+			::close( fd );
+			return false;
+		}
+	}
+	if( ::close( fd ) < 0 ) {
+		error = "Failed to close `" + std::string( filename ) + "`: " + std::strerror( errno );
+		return false;
+	}
+	numBytesWritten = fileSize;
+	numRangesWritten = numRanges;
+	return true;
+}
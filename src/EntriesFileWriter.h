@@ -0,0 +1,64 @@
+#ifndef MERGELISTS_ENTRIES_FILE_WRITER_H
+#define MERGELISTS_ENTRIES_FILE_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Entry.h"
+#include "EntryFormatter.h"
+#include "ThreadPool.h"
+#include "TitlePool.h"
+
+/**
+ * Writes entries to a file in parallel in the same format as {@code EntriesPrinter} does.
+ * Exact lengths of formatted entries are computed first, so every range of entries has a known offset in the file.
+ * The file is preallocated, and ranges are formatted and written at their offsets concurrently.
+ */
+class EntriesFileWriter {
+	const TitlePool &titlePool;
+	ThreadPool &threadPool;
+	uint64_t numBytesWritten { 0 };
+	size_t numRangesWritten { 0 };
+	/**
+	 * Buffers of ranges that are kept for reuse by further writes.
+	 */
+	std::vector<std::string> buffers;
+	/**
+	 * Escaped titles that are shared by formatters of ranges if titles are interned (so they are likely to be met many times).
+	 */
+	EscapedTitles escapedTitles;
+	bool isRecordingOffsets { false };
+	std::vector<uint64_t> offsets;
+
+	static constexpr size_t kMinRangeSize = 1u << 14;
+	static constexpr size_t kWriteThreshold = 1u << 20;
+
+	static bool tryWritingAt( int fd, const std::string &data, uint64_t offset, std::string &error );
+public:
+	EntriesFileWriter( const TitlePool &titlePool_, ThreadPool &threadPool_ ): titlePool( titlePool_ ), threadPool( threadPool_ ) {}
+
+	bool tryWriting( const char *filename, const std::vector<const Entry *> &entries, std::string &error );
+
+	/**
+	 * Sets whether offsets of formatted entries are recorded by further writes (for indexes of the output).
+	 */
+	void setRecordingOffsets( bool isRecordingOffsets_ ) { isRecordingOffsets = isRecordingOffsets_; }
+	/**
+	 * Gets offsets of formatted entries of the last write followed by an offset that an entry after the last one would have.
+	 */
+	const std::vector<uint64_t> &entryOffsets() const { return offsets; }
+
+	uint64_t numBytes() const { return numBytesWritten; }
+	size_t numRanges() const { return numRangesWritten; }
+	uint64_t bufferBytes() const {
+		uint64_t result = 0;
+		for( const std::string &buffer: buffers ) {
+			result += buffer.capacity();
+		}
+		return result;
+	}
+};
+
+#endif
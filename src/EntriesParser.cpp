@@ -0,0 +1,371 @@
+#include "EntriesParser.h"
+
+std::string EntriesParser::describeError( ptrdiff_t elementIndex ) {
+	if( errorAt < linesScannedUpTo ) {
+		linesScannedUpTo = begin;
+		lastLineStart = begin;
+		linesCount = 1;
+	}
+	for(; linesScannedUpTo != errorAt; ++linesScannedUpTo ) {
+		if( *linesScannedUpTo == '\n' ) {
+			linesCount++;
+			lastLineStart = linesScannedUpTo + 1;
+		}
+	}
+
+	// The first line of the buffer may continue a line of the input
+	const size_t column = (size_t)( errorAt - lastLineStart ) + ( lastLineStart == begin ? originColumn : 0 );
+	std::string result( "byte offset " );
+	result += std::to_string( originOffset + (uint64_t)( errorAt - begin ) );
+	result += " (line ";
+	result += std::to_string( originLine + linesCount - 1 );
+	result += ", column ";
+	result += std::to_string( column + 1 );
+	result += ")";
+	if( elementIndex >= 0 ) {
+		result += ", element #";
+		result += std::to_string( elementIndex );
+	}
+	result += ": ";
+	result += error;
+	return result;
+}
+
+bool EntriesParser::parseHexQuad( unsigned &result ) {
+	if( end - p < 4 ) {
+		return failSyntax( p, "Unexpected end of input in a unicode escape sequence" );
+	}
+	result = 0;
+	for( int i = 0; i < 4; ++i, ++p ) {
+		const char ch = *p;
+		unsigned digit;
+		if( ch >= '0' && ch <= '9' ) {
+			digit = (unsigned)( ch - '0' );
+		} else if( ch >= 'a' && ch <= 'f' ) {
+			digit = (unsigned)( ch - 'a' + 10 );
+		} else if( ch >= 'A' && ch <= 'F' ) {
+			digit = (unsigned)( ch - 'A' + 10 );
+		} else {
+			return failSyntax( p, "Illegal character in a unicode escape sequence" );
+		}
+		result = ( result << 4 ) | digit;
+	}
+	return true;
+}
+
+static void appendUtf8( std::string &result, unsigned codePoint ) {
+	if( codePoint < 0x80 ) {
+		result += (char)codePoint;
+	} else if( codePoint < 0x800 ) {
+		result += (char)( 0xC0 | ( codePoint >> 6 ) );
+		result += (char)( 0x80 | ( codePoint & 0x3F ) );
+	} else if( codePoint < 0x10000 ) {
+		result += (char)( 0xE0 | ( codePoint >> 12 ) );
+		result += (char)( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+		result += (char)( 0x80 | ( codePoint & 0x3F ) );
+	} else {
+		result += (char)( 0xF0 | ( codePoint >> 18 ) );
+		result += (char)( 0x80 | ( ( codePoint >> 12 ) & 0x3F ) );
+		result += (char)( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+		result += (char)( 0x80 | ( codePoint & 0x3F ) );
+	}
+}
+
+/**
+ * Checks a UTF-8 sequence starting at the given lead byte.
+ * @return a length of the sequence or zero if it is not a valid one.
+ */
+static size_t validateUtf8Sequence( const unsigned char *s, const unsigned char *end ) {
+	const unsigned lead = s[0];
+	size_t length;
+	unsigned char lower = 0x80, upper = 0xBF;
+	if( lead >= 0xC2 && lead <= 0xDF ) {
+		length = 2;
+	} else if( lead >= 0xE0 && lead <= 0xEF ) {
+		length = 3;
+		if( lead == 0xE0 ) {
+			lower = 0xA0;
+		} else if( lead == 0xED ) {
+			upper = 0x9F;
+		}
+	} else if( lead >= 0xF0 && lead <= 0xF4 ) {
+		length = 4;
+		if( lead == 0xF0 ) {
+			lower = 0x90;
+		} else if( lead == 0xF4 ) {
+			upper = 0x8F;
+		}
+	} else {
+		return 0;
+	}
+	if( (size_t)( end - s ) < length ) {
+		return 0;
+	}
+	if( s[1] < lower || s[1] > upper ) {
+		return 0;
+	}
+	for( size_t i = 2; i < length; ++i ) {
+		if( s[i] < 0x80 || s[i] > 0xBF ) {
+			return 0;
+		}
+	}
+	return length;
+}
+
+bool EntriesParser::parseString( std::string *result ) {
+	if( p == end || *p != '"' ) {
+		return failSyntax( p, "A string was expected" );
+	}
+	++p;
+	for(;; ) {
+		// Consume a run of plain characters at once
+		const char *runStart = p;
+		while( p != end && (unsigned char)*p >= 0x20 && (unsigned char)*p < 0x80 && *p != '"' && *p != '\\' ) {
+			++p;
+		}
+		if( result ) {
+			result->append( runStart, p );
+		}
+		if( p == end ) {
+			return failSyntax( p, "Unexpected end of input in a string" );
+		}
+		const unsigned char ch = (unsigned char)*p;
+		if( ch == '"' ) {
+			++p;
+			return true;
+		}
+		if( ch < 0x20 ) {
+			return failSyntax( p, "Unescaped control character in a string" );
+		}
+		if( ch >= 0x80 ) {
+			const size_t length = validateUtf8Sequence( (const unsigned char *)p, (const unsigned char *)end );
+			if( !length ) {
+				return failSyntax( p, "Invalid UTF-8 byte sequence in a string" );
+			}
+			if( result ) {
+				result->append( p, length );
+			}
+			p += length;
+			continue;
+		}
+		// Handle an escape sequence
+		const char *escapeStart = p++;
+		if( p == end ) {
+			return failSyntax( p, "Unexpected end of input in a string" );
+		}
+		char unescaped;
+		switch( *p ) {
+			case '"': unescaped = '"'; break;
+			case '\\': unescaped = '\\'; break;
+			case '/': unescaped = '/'; break;
+			case 'b': unescaped = '\b'; break;
+			case 'f': unescaped = '\f'; break;
+			case 'n': unescaped = '\n'; break;
+			case 'r': unescaped = '\r'; break;
+			case 't': unescaped = '\t'; break;
+			case 'u': {
+				++p;
+				unsigned codePoint;
+				if( !parseHexQuad( codePoint ) ) {
+					return false;
+				}
+				if( codePoint >= 0xD800 && codePoint <= 0xDBFF ) {
+					unsigned lowSurrogate;
+					if( end - p < 2 || p[0] != '\\' || p[1] != 'u' ) {
+						return failSyntax( escapeStart, "A high surrogate is not followed by a low one" );
+					}
+					p += 2;
+					if( !parseHexQuad( lowSurrogate ) ) {
+						return false;
+					}
+					if( lowSurrogate < 0xDC00 || lowSurrogate > 0xDFFF ) {
+						return failSyntax( escapeStart, "A high surrogate is not followed by a low one" );
+					}
+					codePoint = 0x10000 + ( ( codePoint - 0xD800 ) << 10 ) + ( lowSurrogate - 0xDC00 );
+				} else if( codePoint >= 0xDC00 && codePoint <= 0xDFFF ) {
+					return failSyntax( escapeStart, "A low surrogate is not preceded by a high one" );
+				}
+				if( result ) {
+					appendUtf8( *result, codePoint );
+				}
+				continue;
+			}
+			default:
+				return failSyntax( escapeStart, "Illegal escape sequence in a string" );
+		}
+		if( result ) {
+			result->push_back( unescaped );
+		}
+		++p;
+	}
+}
+
+bool EntriesParser::skipNumber() {
+	const char *const start = p;
+	if( p != end && *p == '-' ) {
+		++p;
+	}
+	if( p == end || !( *p >= '0' && *p <= '9' ) ) {
+		return failSyntax( start, "Malformed number" );
+	}
+	if( *p == '0' ) {
+		++p;
+	} else {
+		while( p != end && *p >= '0' && *p <= '9' ) {
+			++p;
+		}
+	}
+	if( p != end && *p == '.' ) {
+		++p;
+		if( p == end || !( *p >= '0' && *p <= '9' ) ) {
+			return failSyntax( start, "Malformed number" );
+		}
+		while( p != end && *p >= '0' && *p <= '9' ) {
+			++p;
+		}
+	}
+	if( p != end && ( *p == 'e' || *p == 'E' ) ) {
+		++p;
+		if( p != end && ( *p == '+' || *p == '-' ) ) {
+			++p;
+		}
+		if( p == end || !( *p >= '0' && *p <= '9' ) ) {
+			return failSyntax( start, "Malformed number" );
+		}
+		while( p != end && *p >= '0' && *p <= '9' ) {
+			++p;
+		}
+	}
+	return true;
+}
+
+/**
+ * Parses an integer value straight from its digits.
+ * Only a plain integer token is accepted (no fraction or exponent parts).
+ * @param name a name of the field for error reporting.
+ * @param allowNegative whether a minus sign is allowed.
+ * @param negative whether the value is negative.
+ * @param magnitude an absolute value of the integer.
+ * @return false if the value is not an integer or does not fit 64 bits.
+ */
+bool EntriesParser::parseIntegerField( const char *name, bool allowNegative, bool &negative, uint64_t &magnitude ) {
+	const char *const valueStart = p;
+	if( p == end || !( *p == '-' || ( *p >= '0' && *p <= '9' ) ) ) {
+		if( !skipValue() ) {
+			return false;
+		}
+		return failOnField( valueStart, name, allowNegative ? "is not an integer" : "is not an unsigned integer" );
+	}
+	negative = *p == '-';
+	if( negative ) {
+		++p;
+		if( p == end || !( *p >= '0' && *p <= '9' ) ) {
+			return failSyntax( valueStart, "Malformed number" );
+		}
+	}
+	magnitude = 0;
+	bool overflow = false;
+	const char *const digitsStart = p;
+	for(; p != end && *p >= '0' && *p <= '9'; ++p ) {
+		const auto digit = (uint64_t)( *p - '0' );
+		if( magnitude > ( UINT64_MAX - digit ) / 10 ) {
+			overflow = true;
+		}
+		magnitude = magnitude * 10 + digit;
+	}
+	if( *digitsStart == '0' && p - digitsStart > 1 ) {
+		return failSyntax( valueStart, "Malformed number" );
+	}
+	if( p != end && ( *p == '.' || *p == 'e' || *p == 'E' ) ) {
+		p = valueStart;
+		if( !skipNumber() ) {
+			return false;
+		}
+		return failOnField( valueStart, name, allowNegative ? "is not an integer" : "is not an unsigned integer" );
+	}
+	if( negative && !allowNegative && magnitude ) {
+		return failOnField( valueStart, name, "is negative while an unsigned integer is expected" );
+	}
+	if( overflow ) {
+		return failOnField( valueStart, name, "is out of range" );
+	}
+	return true;
+}
+
+bool EntriesParser::parseLiteral( const char *literal, size_t length ) {
+	if( (size_t)( end - p ) < length || std::memcmp( p, literal, length ) != 0 ) {
+		return failSyntax( p, "Unexpected token" );
+	}
+	p += length;
+	return true;
+}
+
+bool EntriesParser::skipValue() {
+	// Closing characters of the containers being skipped. A stack rather than recursion keeps deep nesting off the call stack.
+	std::string closings;
+	for(;; ) {
+		skipWhitespace();
+		if( p == end ) {
+			return failSyntax( p, "Unexpected end of input, a value was expected" );
+		}
+		bool succeeded = true;
+		switch( *p ) {
+			case '"':
+				succeeded = parseString( nullptr );
+				break;
+			case 't':
+				succeeded = parseLiteral( "true", 4 );
+				break;
+			case 'f':
+				succeeded = parseLiteral( "false", 5 );
+				break;
+			case 'n':
+				succeeded = parseLiteral( "null", 4 );
+				break;
+			case '[':
+			case '{': {
+				const char closing = *p == '{' ? '}' : ']';
+				++p;
+				skipWhitespace();
+				if( p != end && *p == closing ) {
+					++p;
+					break;
+				}
+				closings.push_back( closing );
+				if( closing == '}' && !skipObjectKey() ) {
+					return false;
+				}
+				continue;
+			}
+			default:
+				succeeded = skipNumber();
+		}
+		if( !succeeded ) {
+			return false;
+		}
+		// The value is complete, so the containers it ends are closed until one has the next value
+		for(;; ) {
+			if( closings.empty() ) {
+				return true;
+			}
+			const bool isObject = closings.back() == '}';
+			skipWhitespace();
+			if( p != end && *p == ',' ) {
+				++p;
+				if( isObject && !skipObjectKey() ) {
+					return false;
+				}
+				break;
+			}
+			if( !expect( closings.back(), isObject ? "A comma or a closing brace was expected" : "A comma or a closing bracket was expected" ) ) {
+				return false;
+			}
+			closings.pop_back();
+		}
+	}
+}
+
+bool EntriesParser::skipObjectKey() {
+	skipWhitespace();
+	return parseString( nullptr ) && expect( ':', "A colon was expected after an object key" );
+}
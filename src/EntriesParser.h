@@ -0,0 +1,442 @@
+#ifndef MERGELISTS_ENTRIES_PARSER_H
+#define MERGELISTS_ENTRIES_PARSER_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Progress.h"
+#include "RecordSchema.h"
+#include "TitlePool.h"
+
+/**
+ * Kinds of fields of records that are described by schemas.
+ * Integer fields are stored in {@code int} or {@code uint64_t} members.
+ * Title fields are JSON strings that are stored as ids of titles in a {@code TitlePool}.
+ */
+/**
+ * A parser of an array of entries that works directly on a memory buffer.
+ * It never throws and reports the exact position of the first failure.
+ * Syntax errors always abort parsing.
+ * Elements that are well-formed JSON but are not valid entries may be skipped if requested.
+ */
+class EntriesParser {
+	const char *const begin;
+	const char *const end;
+	const char *p;
+
+	static constexpr unsigned kMaxFields = 32;
+
+	TitlePool &titlePool;
+	/**
+	 * Unescaped strings of fields of the current element by indices of fields.
+	 * They are stored only once the element is known to be valid.
+	 */
+	std::string fieldScratches[kMaxFields];
+
+	std::string error;
+	const char *errorAt { nullptr };
+	/**
+	 * Whether the last error is a syntax error (so the parsing cannot be resumed).
+	 */
+	bool malformed { false };
+
+	// A cache for incremental line/column computation as errors are reported in ascending order
+	const char *linesScannedUpTo;
+	const char *lastLineStart;
+	size_t linesCount { 1 };
+
+	// A position of the buffer within the whole input (if the buffer is a segment of it)
+	uint64_t originOffset { 0 };
+	size_t originLine { 1 };
+	size_t originColumn { 0 };
+
+	enum ElementStatus { Parsed, Invalid, Malformed };
+
+	bool fail( const char *at, const char *message ) {
+		errorAt = at;
+		error = message;
+		return false;
+	}
+
+	bool failSyntax( const char *at, const char *message ) {
+		malformed = true;
+		return fail( at, message );
+	}
+
+	bool failOnField( const char *at, const char *name, const char *message ) {
+		errorAt = at;
+		error = std::string( "The field `" ) + name + "` " + message;
+		return false;
+	}
+
+	void skipWhitespace() {
+		while( p != end && ( *p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' ) ) {
+			++p;
+		}
+	}
+
+	bool expect( char ch, const char *message ) {
+		skipWhitespace();
+		if( p == end || *p != ch ) {
+			return failSyntax( p, message );
+		}
+		++p;
+		return true;
+	}
+
+	bool parseHexQuad( unsigned &result );
+	bool parseString( std::string *result );
+	bool skipNumber();
+	bool parseLiteral( const char *literal, size_t length );
+	bool skipValue();
+	bool skipObjectKey();
+	template <typename Record>
+	ElementStatus parseElement( Record &record );
+
+	bool parseIntegerField( const char *name, bool allowNegative, bool &negative, uint64_t &magnitude );
+	template <typename Integer>
+	bool parseIntegerValue( const char *name, Integer &result );
+
+	template <typename Record, typename Member>
+	bool parseField( const FieldDescriptor<Record, IntegerField, Member> &field, Record &record, std::string & ) {
+		return parseIntegerValue( field.name, record.*field.member );
+	}
+	template <typename Record, typename Member>
+	bool parseField( const FieldDescriptor<Record, TitleField, Member> &field, Record &, std::string &scratch ) {
+		if( p != end && *p == '"' ) {
+			scratch.clear();
+			return parseString( &scratch );
+		}
+		const char *const valueStart = p;
+		return skipValue() && failOnField( valueStart, field.name, "is not a string" );
+	}
+
+	template <typename Record, typename Member>
+	bool storeField( const FieldDescriptor<Record, IntegerField, Member> &, Record &, const std::string & ) {
+		return true;
+	}
+	template <typename Record, typename Member>
+	bool storeField( const FieldDescriptor<Record, TitleField, Member> &field, Record &record, const std::string &scratch ) {
+		return titlePool.tryAdding( scratch.data(), scratch.size(), record.*field.member );
+	}
+public:
+	EntriesParser( const char *begin_, const char *end_, TitlePool &titlePool_ )
+		: begin( begin_ ), end( end_ ), p( begin_ ), titlePool( titlePool_ ), linesScannedUpTo( begin_ ), lastLineStart( begin_ ) {}
+
+	/**
+	 * Parses the buffer.
+	 * @param output a list of parsed entries. It's modified only on success.
+	 * @param skipInvalid whether elements that are not valid entries should be skipped instead of failing.
+	 * @param warnings a list of descriptions of skipped elements.
+	 * @param error a position-aware description of a failure.
+	 * @return true on success.
+	 */
+	template <typename Record>
+	bool parse( std::vector<Record> &output, bool skipInvalid, std::vector<std::string> &warnings, std::string &error );
+
+	/**
+	 * Sets a position of the buffer within the whole input, so errors are described relatively to the input.
+	 * @param column a number of characters of the line that precede the buffer.
+	 */
+	void setOrigin( uint64_t offset, size_t line, size_t column ) {
+		originOffset = offset;
+		originLine = line;
+		originColumn = column;
+	}
+
+	/**
+	 * Parses a segment of an input that is split right after commas that separate elements of the root array.
+	 * @param result a list that receives parsed entries.
+	 * @param isFirst whether the segment starts the input (so it starts the root array).
+	 * @param isLast whether the segment ends the input (so it ends the root array).
+	 * @param elementIndex an index of the last element of preceding segments. It's updated.
+	 * @return true on success.
+	 */
+	template <typename Record>
+	bool parseSegment( std::vector<Record> &result, bool isFirst, bool isLast, ptrdiff_t &elementIndex, bool skipInvalid,
+					   std::vector<std::string> &warnings, std::string &error );
+
+	/**
+	 * Parses valid entries of a buffer that may hold only a beginning of an input.
+	 * Parsing silently stops at the first incomplete or malformed element.
+	 * @param output a list of parsed entries.
+	 */
+	template <typename Record>
+	void parsePrefix( std::vector<Record> &output );
+
+	/**
+	 * Parses elements separated by commas that are a part of a root array without its brackets.
+	 * @param output a list of parsed entries.
+	 * @param elementEnds positions right after parsed elements.
+	 * @return true on success.
+	 */
+	template <typename Record>
+	bool parseSequence( std::vector<Record> &output, std::vector<const char *> &elementEnds, std::string &error );
+
+	/**
+	 * Describes the current error prefixing it by its byte offset, line, column and an element index if applicable.
+	 * @note it's assumed to be called with non-decreasing error positions for the best performance.
+	 */
+	std::string describeError( ptrdiff_t elementIndex );
+};
+
+template <typename Integer>
+bool EntriesParser::parseIntegerValue( const char *name, Integer &result ) {
+	const char *const valueStart = p;
+	bool negative;
+	uint64_t magnitude;
+	if( !parseIntegerField( name, std::is_signed<Integer>::value, negative, magnitude ) ) {
+		return false;
+	}
+	// Only a negative zero gets here for unsigned values
+	const auto maxValue = (uint64_t)std::numeric_limits<Integer>::max();
+	const uint64_t limit = negative && std::is_signed<Integer>::value ? maxValue + 1 : maxValue;
+	if( magnitude > limit ) {
+		return failOnField( valueStart, name, "is out of range" );
+	}
+	result = negative ? (Integer)( 0 - magnitude ) : (Integer)magnitude;
+	return true;
+}
+
+template <typename Record>
+EntriesParser::ElementStatus EntriesParser::parseElement( Record &record ) {
+	using Schema = RecordSchema<Record>;
+	static_assert( std::tuple_size<decltype( Schema::kFields )>::value <= kMaxFields, "Too many fields" );
+
+	const char *const elementStart = p;
+	if( *p != '{' ) {
+		fail( p, "An element of a root JSON array is not an object" );
+		return Invalid;
+	}
+	++p;
+
+	uint32_t presentFields = 0;
+	std::string key;
+	skipWhitespace();
+	if( p != end && *p == '}' ) {
+		++p;
+	} else {
+		for(;; ) {
+			skipWhitespace();
+			key.clear();
+			if( !parseString( &key ) ) {
+				return Malformed;
+			}
+			if( !expect( ':', "A colon was expected after an object key" ) ) {
+				return Malformed;
+			}
+			skipWhitespace();
+			bool isKnown = false, succeeded = true;
+			::forEachField( Schema::kFields, [&]( const auto &field, size_t index ) {
+				if( !isKnown && key.size() == field.nameLength && !std::memcmp( key.data(), field.name, field.nameLength ) ) {
+					isKnown = true;
+					presentFields |= 1u << index;
+					succeeded = this->parseField( field, record, fieldScratches[index] );
+				}
+			});
+			if( !isKnown ) {
+				succeeded = skipValue();
+			}
+			if( !succeeded ) {
+				return malformed ? Malformed : Invalid;
+			}
+			skipWhitespace();
+			if( p != end && *p == ',' ) {
+				++p;
+				continue;
+			}
+			if( !expect( '}', "A comma or a closing brace was expected" ) ) {
+				return Malformed;
+			}
+			break;
+		}
+	}
+
+	const char *missingField = nullptr;
+	::forEachField( Schema::kFields, [&]( const auto &field, size_t index ) {
+		if( !missingField && ( field.flags & RequiredField ) && !( presentFields & ( 1u << index ) ) ) {
+			missingField = field.name;
+		}
+	});
+	if( missingField ) {
+		errorAt = elementStart;
+		error = std::string( "Failed to get field `" ) + missingField + "` of " + Schema::recordName();
+		return Invalid;
+	}
+	if( const char *violation = Schema::finish( record, presentFields ) ) {
+		fail( elementStart, violation );
+		return Invalid;
+	}
+	// Strings of invalid elements never get to the pool
+	bool isStored = true;
+	::forEachField( Schema::kFields, [&]( const auto &field, size_t index ) {
+		if( isStored && ( presentFields & ( 1u << index ) ) ) {
+			isStored = this->storeField( field, record, fieldScratches[index] );
+		}
+	});
+	// That's not a fault of the element, so it's never skipped
+	if( !isStored ) {
+		fail( elementStart, "The title pool is full" );
+		return Malformed;
+	}
+	return Parsed;
+}
+
+template <typename Record>
+bool EntriesParser::parse( std::vector<Record> &output, bool skipInvalid, std::vector<std::string> &warnings, std::string &error_ ) {
+	std::vector<Record> result;
+	ptrdiff_t elementIndex = -1;
+	if( !parseSegment( result, true, true, elementIndex, skipInvalid, warnings, error_ ) ) {
+		return false;
+	}
+	// There's nothing that could fail left. Commit changes.
+	output.clear();
+	std::swap( result, output );
+	return true;
+}
+
+template <typename Record>
+bool EntriesParser::parseSegment( std::vector<Record> &result, bool isFirst, bool isLast, ptrdiff_t &elementIndex, bool skipInvalid,
+								  std::vector<std::string> &warnings, std::string &error_ ) {
+	// Progress is reported per batches of elements
+	constexpr ptrdiff_t kProgressBatchMask = ( 1 << 12 ) - 1;
+	const char *reportedUpTo = p;
+	size_t numReported = result.size();
+
+	if( isFirst && !expect( '[', "The root JSON object is not an array" ) ) {
+		error_ = describeError( elementIndex );
+		return false;
+	}
+	skipWhitespace();
+	if( isFirst && p != end && *p == ']' ) {
+		++p;
+	} else {
+		for(;; ) {
+			skipWhitespace();
+			if( p == end ) {
+				failSyntax( p, "Unexpected end of input, a value was expected" );
+				error_ = describeError( elementIndex );
+				return false;
+			}
+			++elementIndex;
+			const char *const elementStart = p;
+			Record record;
+			const ElementStatus status = parseElement( record );
+			if( status == Parsed ) {
+				result.emplace_back( std::move( record ) );
+			} else {
+				if( status == Malformed || !skipInvalid ) {
+					error_ = describeError( elementIndex );
+					return false;
+				}
+				warnings.emplace_back( describeError( elementIndex ) );
+				// The element is known to be not a valid entry. Check whether it is a well-formed JSON at least.
+				p = elementStart;
+				if( !skipValue() ) {
+					error_ = describeError( elementIndex );
+					return false;
+				}
+			}
+			if( progressCounters && ( elementIndex & kProgressBatchMask ) == kProgressBatchMask ) {
+				progressCounters->onParsed( (uint64_t)( p - reportedUpTo ), result.size() - numReported );
+				reportedUpTo = p;
+				numReported = result.size();
+			}
+			skipWhitespace();
+			if( p != end && *p == ',' ) {
+				++p;
+				// Elements that follow belong to the next segment
+				if( p == end && !isLast ) {
+					break;
+				}
+				continue;
+			}
+			if( !expect( ']', "A comma or a closing bracket was expected" ) ) {
+				error_ = describeError( elementIndex );
+				return false;
+			}
+			break;
+		}
+	}
+	skipWhitespace();
+	if( p != end ) {
+		failSyntax( p, "Unexpected trailing characters after the root array" );
+		error_ = describeError( -1 );
+		return false;
+	}
+
+	if( progressCounters ) {
+		progressCounters->onParsed( (uint64_t)( p - reportedUpTo ), result.size() - numReported );
+	}
+	return true;
+}
+
+template <typename Record>
+void EntriesParser::parsePrefix( std::vector<Record> &output ) {
+	output.clear();
+	if( !expect( '[', "The root JSON object is not an array" ) ) {
+		return;
+	}
+	for(;; ) {
+		skipWhitespace();
+		if( p == end || *p == ']' ) {
+			return;
+		}
+		const char *const elementStart = p;
+		Record record;
+		const ElementStatus status = parseElement( record );
+		if( status == Malformed ) {
+			return;
+		}
+		if( status == Parsed ) {
+			output.push_back( record );
+		} else {
+			p = elementStart;
+			if( !skipValue() ) {
+				return;
+			}
+		}
+		skipWhitespace();
+		if( p == end || *p != ',' ) {
+			return;
+		}
+		++p;
+	}
+}
+
+template <typename Record>
+bool EntriesParser::parseSequence( std::vector<Record> &output, std::vector<const char *> &elementEnds, std::string &error_ ) {
+	output.clear();
+	elementEnds.clear();
+	for( ptrdiff_t elementIndex = 0;; ++elementIndex ) {
+		skipWhitespace();
+		if( p == end ) {
+			failSyntax( p, "Unexpected end of input, a value was expected" );
+			error_ = describeError( elementIndex );
+			return false;
+		}
+		Record record;
+		if( parseElement( record ) != Parsed ) {
+			error_ = describeError( elementIndex );
+			return false;
+		}
+		output.push_back( record );
+		elementEnds.push_back( p );
+		skipWhitespace();
+		if( p == end ) {
+			return true;
+		}
+		if( !expect( ',', "A comma was expected" ) ) {
+			error_ = describeError( elementIndex );
+			return false;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MERGELISTS_ENTRY_H
+#define MERGELISTS_ENTRY_H
+
+#include <cstdint>
+
+struct Entry {
+	/**
+	 * An id of the title in a {@code TitlePool}.
+	 */
+	uint32_t titleId { 0 };
+	int num;
+	uint64_t created { 0 };
+	uint64_t deleted { 0 };
+	/**
+	 * An auxiliary field that gets used for comparison of Entry instances.
+	 * Avoiding branching at every comparison is its purpose.
+	 * It must be assigned by JSON loading core based on {@code created} and {@code deleted} values.
+	 */
+	uint64_t timestamp { 0 };
+
+	bool operator<( const Entry &that ) const {
+		return timestamp < that.timestamp;
+	}
+};
+
+#endif
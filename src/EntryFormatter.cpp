@@ -0,0 +1,169 @@
+#include "EntryFormatter.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Progress.h"
+
+static void appendEscaped( std::string &output, const char *data, size_t length ) {
+	static const char *const hexDigits = "0123456789abcdef";
+	const char *const end = data + length;
+	for( const char *p = data; p != end; ) {
+		// Copy a run of characters that do not need escaping at once
+		const char *runStart = p;
+		while( p != end && (unsigned char)*p >= 0x20 && *p != '"' && *p != '\\' ) {
+			++p;
+		}
+		output.append( runStart, p );
+		if( p == end ) {
+			break;
+		}
+		const char ch = *p++;
+		switch( ch ) {
+			case '"': output.append( "\\\"", 2 ); break;
+			case '\\': output.append( "\\\\", 2 ); break;
+			case '\b': output.append( "\\b", 2 ); break;
+			case '\f': output.append( "\\f", 2 ); break;
+			case '\n': output.append( "\\n", 2 ); break;
+			case '\r': output.append( "\\r", 2 ); break;
+			case '\t': output.append( "\\t", 2 ); break;
+			default: {
+				const char escaped[] = { '\\', 'u', '0', '0', hexDigits[ch >> 4], hexDigits[ch & 0xF] };
+				output.append( escaped, sizeof( escaped ) );
+			}
+		}
+	}
+}
+
+void appendDecimal( std::string &output, uint64_t value ) {
+	char digits[20];
+	char *p = digits + sizeof( digits );
+	do {
+		*--p = (char)( '0' + value % 10 );
+		value /= 10;
+	} while( value );
+	output.append( p, digits + sizeof( digits ) );
+}
+
+void appendDecimal( std::string &output, int value ) {
+	if( value < 0 ) {
+		output.push_back( '-' );
+		appendDecimal( output, (uint64_t)( -(int64_t)value ) );
+	} else {
+		appendDecimal( output, (uint64_t)value );
+	}
+}
+
+size_t escapedLength( const char *data, size_t length ) {
+	size_t result = length;
+	const char *const end = data + length;
+	for( const char *p = data; p != end; ++p ) {
+		const char ch = *p;
+		if( ch == '"' || ch == '\\' ) {
+			result += 1;
+		} else if( (unsigned char)ch < 0x20 ) {
+			const bool hasShortForm = ch == '\b' || ch == '\f' || ch == '\n' || ch == '\r' || ch == '\t';
+			result += hasShortForm ? 1 : 5;
+		}
+	}
+	return result;
+}
+
+size_t decimalLength( uint64_t value ) {
+	size_t result = 1;
+	while( value >= 10 ) {
+		value /= 10;
+		result++;
+	}
+	return result;
+}
+
+size_t decimalLength( int value ) {
+	return value < 0 ? 1 + decimalLength( (uint64_t)( -(int64_t)value ) ) : decimalLength( (uint64_t)value );
+}
+
+void EscapedTitles::update( const TitlePool &titlePool, ThreadPool &threadPool ) {
+	if( poolGeneration != titlePool.generation() ) {
+		for( std::vector<std::string> &escaped: shards ) {
+			escaped.clear();
+		}
+		poolGeneration = titlePool.generation();
+	}
+	threadPool.parallelFor( shards.size(), [&]( size_t shardNum ) {
+		std::vector<std::string> &escaped = shards[shardNum];
+		std::string decoded;
+		for( size_t i = escaped.size(); i < titlePool.shardSize( (unsigned)shardNum ); ++i ) {
+			TitlePool::Title title = titlePool.get( TitlePool::idOf( (unsigned)shardNum, (uint32_t)i ) );
+			if( title.compressed ) {
+				decoded.clear();
+				titlePool.decode( title, decoded );
+				title.data = decoded.data();
+				title.length = (uint32_t)decoded.size();
+			}
+			escaped.emplace_back();
+			::appendEscaped( escaped.back(), title.data, title.length );
+		}
+	});
+}
+
+TitlePool::Title EntryFormatter::decodedTitleOf( uint32_t titleId ) {
+	TitlePool::Title title = titlePool.get( titleId );
+	if( title.compressed ) {
+		decodedTitle.clear();
+		titlePool.decode( title, decodedTitle );
+		title.data = decodedTitle.data();
+		title.length = (uint32_t)decodedTitle.size();
+	}
+	return title;
+}
+
+void EntryFormatter::appendTitle( uint32_t titleId, std::string &output ) {
+	if( sharedEscapedTitles ) {
+		output.append( sharedEscapedTitles->get( titleId ) );
+		return;
+	}
+	std::string *escaped = nullptr;
+	if( !escapedTitles.empty() ) {
+		escaped = &escapedTitles[TitlePool::shardOf( titleId )][TitlePool::indexInShard( titleId )];
+		if( !escaped->empty() ) {
+			output.append( *escaped );
+			return;
+		}
+	}
+	const TitlePool::Title title = decodedTitleOf( titleId );
+	if( !escaped ) {
+		::appendEscaped( output, title.data, title.length );
+		return;
+	}
+	::appendEscaped( *escaped, title.data, title.length );
+	output.append( *escaped );
+}
+
+void EntriesPrinter::print( const std::vector<const Entry *> &entries ) {
+	if( entries.empty() ) {
+		stream << kNoEntriesOutput << std::flush;
+		return;
+	}
+	buffer.append( "[\n" );
+	size_t numFlushed = 0;
+	for( size_t i = 0; i < entries.size(); ++i ) {
+		if( i ) {
+			buffer.append( ",\n" );
+		}
+		formatter.append( *entries[i], buffer );
+		if( buffer.size() >= kFlushThreshold ) {
+			if( progressCounters ) {
+				progressCounters->onWritten( buffer.size(), i + 1 - numFlushed );
+				numFlushed = i + 1;
+			}
+			flush();
+		}
+	}
+	buffer.append( "\n]" );
+	if( progressCounters ) {
+		progressCounters->onWritten( buffer.size() + 1, entries.size() - numFlushed );
+	}
+	flush();
+	stream << std::endl;
+}
@@ -0,0 +1,188 @@
+#ifndef MERGELISTS_ENTRY_FORMATTER_H
+#define MERGELISTS_ENTRY_FORMATTER_H
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Entry.h"
+#include "RecordSchema.h"
+#include "ThreadPool.h"
+#include "TitlePool.h"
+
+/**
+ * Appends a decimal form of the value to the output.
+ */
+void appendDecimal( std::string &output, uint64_t value );
+void appendDecimal( std::string &output, int value );
+
+/**
+ * @return a length of the string escaped for a JSON string literal.
+ */
+size_t escapedLength( const char *data, size_t length );
+
+/**
+ * @return a length of a decimal form of the value.
+ */
+size_t decimalLength( uint64_t value );
+size_t decimalLength( int value );
+
+/**
+ * The output of no entries. This is what a generic JSON library prints for a default-constructed root.
+ */
+constexpr char kNoEntriesOutput[] = "null\n";
+
+/**
+ * Escaped forms of titles of a pool that formatters on several threads share.
+ * Titles that are added to the pool later are escaped by the next update.
+ */
+class EscapedTitles {
+	std::vector<std::vector<std::string>> shards;
+	uint64_t poolGeneration { 0 };
+public:
+	EscapedTitles(): shards( TitlePool::numShards() ) {}
+
+	void update( const TitlePool &titlePool, ThreadPool &threadPool );
+
+	const std::string &get( uint32_t titleId ) const {
+		return shards[TitlePool::shardOf( titleId )][TitlePool::indexInShard( titleId )];
+	}
+};
+
+/**
+ * Formats entries in the same format as a generic JSON library does when pretty-printing with an indentation of 2.
+ * Keys of objects are written in their lexicographical order.
+ */
+class EntryFormatter {
+	const TitlePool &titlePool;
+	/**
+	 * Escaped forms of titles by their ids if they are cached.
+	 */
+	std::vector<std::vector<std::string>> escapedTitles;
+	/**
+	 * Escaped forms of all titles if they are shared with other formatters.
+	 */
+	const EscapedTitles *sharedEscapedTitles { nullptr };
+	std::string decodedTitle;
+
+	TitlePool::Title decodedTitleOf( uint32_t titleId );
+	void appendTitle( uint32_t titleId, std::string &output );
+
+	template <typename Record, typename Member>
+	void appendValue( const FieldDescriptor<Record, IntegerField, Member> &field, const Record &record, std::string &output ) {
+		::appendDecimal( output, record.*field.member );
+	}
+	template <typename Record, typename Member>
+	void appendValue( const FieldDescriptor<Record, TitleField, Member> &field, const Record &record, std::string &output ) {
+		output.push_back( '"' );
+		appendTitle( record.*field.member, output );
+		output.push_back( '"' );
+	}
+
+	template <typename Record, typename Member>
+	size_t valueLength( const FieldDescriptor<Record, IntegerField, Member> &field, const Record &record ) {
+		return ::decimalLength( record.*field.member );
+	}
+	template <typename Record, typename Member>
+	size_t valueLength( const FieldDescriptor<Record, TitleField, Member> &field, const Record &record ) {
+		if( sharedEscapedTitles ) {
+			return sharedEscapedTitles->get( record.*field.member ).size() + 2;
+		}
+		const TitlePool::Title title = decodedTitleOf( record.*field.member );
+		return ::escapedLength( title.data, title.length ) + 2;
+	}
+
+	template <typename Record, typename Kind, typename Member>
+	static bool isOmitted( const FieldDescriptor<Record, Kind, Member> &field, const Record &record ) {
+		return ( field.flags & OmittedIfZero ) && !( record.*field.member );
+	}
+public:
+	/**
+	 * @param cachesTitles whether escaped titles should be cached (titles are likely to be met many times if interned).
+	 */
+	EntryFormatter( const TitlePool &titlePool_, bool cachesTitles ): titlePool( titlePool_ ) {
+		if( cachesTitles ) {
+			escapedTitles.resize( TitlePool::numShards() );
+			for( unsigned i = 0; i < TitlePool::numShards(); ++i ) {
+				escapedTitles[i].resize( titlePool.shardSize( i ) );
+			}
+		}
+	}
+
+	/**
+	 * @param sharedEscapedTitles_ escaped forms of all titles of the pool or null if titles should not be cached.
+	 */
+	EntryFormatter( const TitlePool &titlePool_, const EscapedTitles *sharedEscapedTitles_ )
+		: titlePool( titlePool_ ), sharedEscapedTitles( sharedEscapedTitles_ ) {}
+
+	/**
+	 * Appends the record formatted as a generic JSON library does (see {@code RecordSchema}).
+	 */
+	template <typename Record>
+	void append( const Record &record, std::string &output );
+
+	/**
+	 * Computes an exact length of the formatted record without formatting it.
+	 */
+	template <typename Record>
+	size_t length( const Record &record );
+};
+
+template <typename Record>
+void EntryFormatter::append( const Record &record, std::string &output ) {
+	output.append( "  {\n" );
+	bool isFirst = true;
+	::forEachField( RecordSchema<Record>::kFields, [&]( const auto &field, size_t ) {
+		if( isOmitted( field, record ) ) {
+			return;
+		}
+		if( !isFirst ) {
+			output.append( ",\n" );
+		}
+		isFirst = false;
+		output.append( field.formattedKey, field.formattedKeyLength );
+		this->appendValue( field, record, output );
+	});
+	output.append( "\n  }" );
+}
+
+template <typename Record>
+size_t EntryFormatter::length( const Record &record ) {
+	// Keep it in sync with append()
+	size_t result = std::strlen( "  {\n" ) + std::strlen( "\n  }" );
+	size_t numFields = 0;
+	::forEachField( RecordSchema<Record>::kFields, [&]( const auto &field, size_t ) {
+		if( !isOmitted( field, record ) ) {
+			result += field.formattedKeyLength + this->valueLength( field, record );
+			numFields++;
+		}
+	});
+	return result + ( numFields ? ( numFields - 1 ) * std::strlen( ",\n" ) : 0 );
+}
+
+/**
+ * Prints entries to a stream in a single pass.
+ */
+class EntriesPrinter {
+	EntryFormatter formatter;
+	std::ostream &stream;
+	std::string buffer;
+
+	static constexpr size_t kFlushThreshold = 1u << 20;
+
+	void flush() {
+		stream.write( buffer.data(), (std::streamsize)buffer.size() );
+		buffer.clear();
+	}
+public:
+	EntriesPrinter( const TitlePool &titlePool, std::ostream &stream_ )
+		: formatter( titlePool, titlePool.isInterning() ), stream( stream_ ) {
+		buffer.reserve( kFlushThreshold + 4096 );
+	}
+
+	void print( const std::vector<const Entry *> &entries );
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "InputProfile.h"
+
+#include <climits>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+#include "Entry.h"
+#include "EntryFormatter.h"
+#include "InputReading.h"
+#include "Statistics.h"
+#include "TitlePool.h"
+
+static const char *const kProfileHeader = "mergelists-profile 1";
+
+static const char *const kProfileMinKey = "min-key";
+
+static const std::pair<const char *, uint64_t InputProfile::*> kProfileScalars[] = {
+	{ "files", &InputProfile::numFiles },
+	{ "entries", &InputProfile::numEntries },
+	{ "distinct-keys", &InputProfile::numDistinctKeys },
+	{ "key-span", &InputProfile::keySpan },
+	{ "timestamp-span", &InputProfile::timestampSpan },
+	{ "deleted", &InputProfile::numDeleted },
+	{ "adjacent-pairs", &InputProfile::numAdjacentPairs },
+	{ "sorted-key-pairs", &InputProfile::numSortedKeyPairs },
+	{ "sorted-timestamp-pairs", &InputProfile::numSortedTimestampPairs },
+	{ "keys-in-several-files", &InputProfile::numKeysInSeveralFiles },
+};
+
+static const std::pair<const char *, LogLinearHistogram InputProfile::*> kProfileHistograms[] = {
+	{ "entries-per-file", &InputProfile::entriesPerFile },
+	{ "title-lengths", &InputProfile::titleLengths },
+	{ "occurrences-per-key", &InputProfile::occurrencesPerKey },
+	{ "files-per-key", &InputProfile::filesPerKey },
+};
+
+void InputProfile::write( std::ostream &stream ) const {
+	stream << kProfileHeader << '\n';
+	for( const auto &nameAndField: kProfileScalars ) {
+		stream << nameAndField.first << ' ' << this->*nameAndField.second << '\n';
+	}
+	stream << kProfileMinKey << ' ' << minKey << '\n';
+	for( const auto &nameAndField: kProfileHistograms ) {
+		stream << nameAndField.first;
+		( this->*nameAndField.second ).write( stream );
+		stream << '\n';
+	}
+}
+
+bool InputProfile::tryReading( const char *filename, std::string &error ) {
+	std::ifstream stream( filename );
+	if( !stream.is_open() ) {
+		error = std::string( "Failed to open a file stream of `" ) + filename + "`";
+		return false;
+	}
+	std::string line;
+	if( !std::getline( stream, line ) || line != kProfileHeader ) {
+		error = std::string( "`" ) + filename + "` is not a profile of inputs";
+		return false;
+	}
+	while( std::getline( stream, line ) ) {
+		std::istringstream lineStream( line );
+		std::string name;
+		lineStream >> name;
+		bool isKnown = name == kProfileMinKey && (bool)( lineStream >> minKey );
+		for( const auto &nameAndField: kProfileScalars ) {
+			if( name == nameAndField.first ) {
+				isKnown = (bool)( lineStream >> this->*nameAndField.second );
+			}
+		}
+		for( const auto &nameAndField: kProfileHistograms ) {
+			if( name == nameAndField.first ) {
+				isKnown = ( this->*nameAndField.second ).tryReading( lineStream );
+			}
+		}
+		if( !isKnown ) {
+			error = "Malformed profile line `" + line + "`";
+			return false;
+		}
+	}
+	return true;
+}
+
+int profileInputs( const Options &options, ThreadPool &threadPool ) {
+	const size_t numFiles = options.filenames.size();
+	std::vector<std::vector<Entry>> readLists( numFiles );
+	TitlePool titlePool( false, false );
+	std::vector<std::vector<std::string>> warnings( numFiles );
+	std::vector<std::string> errors( numFiles );
+	threadPool.parallelFor( numFiles, [&]( size_t i ) {
+		::tryReadingEntries( options.filenames[i], options.inputMode, threadPool, readLists[i], titlePool,
+							 options.skipInvalid, warnings[i], errors[i] );
+	});
+	for( size_t i = 0; i < numFiles; ++i ) {
+		if( !errors[i].empty() ) {
+			std::cerr << "Failed to read a file content of `" << options.filenames[i] << "`: " << errors[i] << std::endl;
+			return 1;
+		}
+	}
+
+	struct KeyStats {
+		uint64_t numOccurrences;
+		uint64_t numFiles;
+		size_t lastFile;
+	};
+	std::unordered_map<int, KeyStats> keys;
+	InputProfile profile;
+	profile.numFiles = numFiles;
+	int64_t minNum = INT64_MAX, maxNum = INT64_MIN;
+	uint64_t minTimestamp = UINT64_MAX, maxTimestamp = 0;
+	for( size_t file = 0; file < numFiles; ++file ) {
+		const std::vector<Entry> &list = readLists[file];
+		profile.entriesPerFile.add( list.size() );
+		profile.numEntries += list.size();
+		for( size_t i = 0; i < list.size(); ++i ) {
+			const Entry &entry = list[i];
+			profile.titleLengths.add( titlePool.get( entry.titleId ).length );
+			profile.numDeleted += !entry.created;
+			minNum = std::min<int64_t>( minNum, entry.num );
+			maxNum = std::max<int64_t>( maxNum, entry.num );
+			minTimestamp = std::min( minTimestamp, entry.timestamp );
+			maxTimestamp = std::max( maxTimestamp, entry.timestamp );
+			if( i ) {
+				profile.numAdjacentPairs++;
+				profile.numSortedKeyPairs += list[i - 1].num <= entry.num;
+				profile.numSortedTimestampPairs += list[i - 1].timestamp <= entry.timestamp;
+			}
+			auto insertionResult = keys.insert( { entry.num, KeyStats { 0, 0, file } } );
+			KeyStats &stats = insertionResult.first->second;
+			stats.numOccurrences++;
+			if( insertionResult.second || stats.lastFile != file ) {
+				stats.numFiles++;
+				stats.lastFile = file;
+			}
+		}
+	}
+	profile.numDistinctKeys = keys.size();
+	if( profile.numEntries ) {
+		profile.minKey = minNum;
+		profile.keySpan = (uint64_t)( maxNum - minNum + 1 );
+		profile.timestampSpan = maxTimestamp - minTimestamp;
+	}
+	for( const auto &kvPair: keys ) {
+		profile.occurrencesPerKey.add( kvPair.second.numOccurrences );
+		profile.filesPerKey.add( kvPair.second.numFiles );
+		profile.numKeysInSeveralFiles += kvPair.second.numFiles > 1;
+	}
+
+	std::ofstream stream( options.profileFilename, std::ios_base::out | std::ios_base::trunc );
+	if( !stream.is_open() ) {
+		std::cerr << "Failed to open a file stream of `" << options.profileFilename << "`" << std::endl;
+		return 1;
+	}
+	profile.write( stream );
+	if( !stream.flush() ) {
+		std::cerr << "Failed to write `" << options.profileFilename << "`" << std::endl;
+		return 1;
+	}
+
+	if( options.printStats ) {
+		printStat( "profiled files", profile.numFiles );
+		printStat( "profiled entries", profile.numEntries );
+		printStat( "profiled distinct keys", profile.numDistinctKeys );
+		printStat( "profiled key density", (double)profile.numDistinctKeys / (double)std::max<uint64_t>( 1, profile.keySpan ) );
+		printStat( "profiled duplicate ratio", 1.0 - (double)profile.numDistinctKeys / (double)std::max<uint64_t>( 1, profile.numEntries ) );
+		printStat( "profiled keys in several files", profile.numKeysInSeveralFiles );
+		printStat( "profiled deleted ratio", (double)profile.numDeleted / (double)std::max<uint64_t>( 1, profile.numEntries ) );
+		printStat( "profiled sorted timestamp pairs ratio",
+				   (double)profile.numSortedTimestampPairs / (double)std::max<uint64_t>( 1, profile.numAdjacentPairs ) );
+	}
+	return 0;
+}
+
+int generateFromProfile( const Options &options ) {
+	InputProfile profile;
+	std::string error;
+	if( !profile.tryReading( options.generatorProfileFilename, error ) ) {
+		std::cerr << "Failed to read the profile: " << error << std::endl;
+		return 1;
+	}
+
+	// The span is clamped, so a corrupted one cannot overflow the check
+	const int64_t keySpan = (int64_t)std::min<uint64_t>( profile.keySpan, (uint64_t)1 << 33 );
+	if( profile.minKey < INT_MIN || profile.minKey + keySpan - 1 > INT_MAX ) {
+		std::cerr << "The profiled keys do not fit an int" << std::endl;
+		return 1;
+	}
+
+	std::mt19937_64 rng( options.generatorSeed );
+	std::vector<uint64_t> numFileEntries( profile.numFiles );
+	uint64_t numEntries = 0;
+	for( uint64_t &count: numFileEntries ) {
+		count = profile.entriesPerFile.isEmpty() ? 0 : profile.entriesPerFile.draw( rng );
+		numEntries += count;
+	}
+
+	// Keys are laid out with a stride that reproduces the density, and every one of them is repeated as profiled
+	const double stride = std::max( 1.0, (double)profile.keySpan / (double)std::max<uint64_t>( 1, profile.numDistinctKeys ) );
+	std::vector<int> keys;
+	keys.reserve( numEntries );
+	for( uint64_t key = 0; keys.size() < numEntries; ++key ) {
+		// Every key gets a distinct slot of integers
+		const auto slotBegin = (uint64_t)( (double)key * stride );
+		const auto slotEnd = (uint64_t)( (double)( key + 1 ) * stride );
+		const uint64_t offset = std::uniform_int_distribution<uint64_t>( slotBegin, std::max( slotBegin, slotEnd - 1 ) )( rng );
+		// More entries than profiled ones may need keys beyond the profiled span
+		if( offset > (uint64_t)( (int64_t)INT_MAX - profile.minKey ) ) {
+			std::cerr << "Generated keys exceed the range of an int" << std::endl;
+			return 1;
+		}
+		const uint64_t numOccurrences = profile.occurrencesPerKey.isEmpty() ? 1 : std::max<uint64_t>( 1, profile.occurrencesPerKey.draw( rng ) );
+		keys.insert( keys.end(), (size_t)std::min<uint64_t>( numOccurrences, numEntries - keys.size() ), (int)( profile.minKey + (int64_t)offset ) );
+	}
+	std::shuffle( keys.begin(), keys.end(), rng );
+
+	const double deletedRatio = (double)profile.numDeleted / (double)std::max<uint64_t>( 1, profile.numEntries );
+	const double sortedTimestampsRatio = (double)profile.numSortedTimestampPairs / (double)std::max<uint64_t>( 1, profile.numAdjacentPairs );
+	const bool areKeysSorted = profile.numSortedKeyPairs == profile.numAdjacentPairs;
+	// Swapping a sorted pair makes it unsorted without affecting neighbouring pairs as long as swapped pairs do not overlap
+	const double swapProbability = std::min( 1.0, 2.0 * ( 1.0 - sortedTimestampsRatio ) );
+	static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz ";
+	const uint64_t firstTimestamp = 1u << 30;
+
+	size_t nextKey = 0;
+	uint64_t numEntriesWritten = 0;
+	for( size_t file = 0; file < numFileEntries.size(); ++file ) {
+		TitlePool titlePool( false, false );
+		std::vector<Entry> list( numFileEntries[file] );
+		std::string title;
+		for( Entry &entry: list ) {
+			entry.num = keys[nextKey++];
+			entry.timestamp = firstTimestamp + std::uniform_int_distribution<uint64_t>( 0, profile.timestampSpan )( rng );
+			if( std::bernoulli_distribution( deletedRatio )( rng ) ) {
+				entry.deleted = entry.timestamp;
+			} else {
+				entry.created = entry.timestamp;
+			}
+			title.resize( profile.titleLengths.isEmpty() ? 0 : profile.titleLengths.draw( rng ) );
+			for( char &c: title ) {
+				c = kAlphabet[std::uniform_int_distribution<size_t>( 0, sizeof( kAlphabet ) - 2 )( rng )];
+			}
+			if( !titlePool.tryAdding( title.data(), title.size(), entry.titleId ) ) {
+				std::cerr << "Failed to generate titles of file #" << file << ": the title pool is full" << std::endl;
+				return 1;
+			}
+		}
+		if( areKeysSorted ) {
+			std::sort( list.begin(), list.end(), []( const Entry &lhs, const Entry &rhs ) { return lhs.num < rhs.num; } );
+		} else {
+			std::sort( list.begin(), list.end() );
+			for( size_t i = 0; i + 1 < list.size(); i += 2 ) {
+				if( std::bernoulli_distribution( swapProbability )( rng ) ) {
+					std::swap( list[i], list[i + 1] );
+				}
+			}
+		}
+
+		const std::string filename( options.generatorPrefix + std::to_string( file ) + ".json" );
+		std::ofstream stream( filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+		if( !stream.is_open() ) {
+			std::cerr << "Failed to open a file stream of `" << filename << "`" << std::endl;
+			return 1;
+		}
+		std::vector<const Entry *> entries;
+		entries.reserve( list.size() );
+		for( const Entry &entry: list ) {
+			entries.push_back( &entry );
+		}
+		// The printer writes `null` for no entries which is not a valid input
+		if( entries.empty() ) {
+			stream << "[]\n";
+		} else {
+			EntriesPrinter( titlePool, stream ).print( entries );
+		}
+		if( !stream.flush() ) {
+			std::cerr << "Failed to write `" << filename << "`" << std::endl;
+			return 1;
+		}
+		numEntriesWritten += list.size();
+	}
+
+	if( options.printStats ) {
+		printStat( "generated files", numFileEntries.size() );
+		printStat( "generated entries", numEntriesWritten );
+	}
+	return 0;
+}
@@ -0,0 +1,141 @@
+#ifndef MERGELISTS_INPUT_PROFILE_H
+#define MERGELISTS_INPUT_PROFILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include "Options.h"
+#include "ThreadPool.h"
+
+/**
+ * A histogram with log-linear buckets. Values below 16 have buckets of their own,
+ * every greater power-of-two range is split into 8 buckets of equal widths, so a bucket is accurate within 12.5%.
+ */
+class LogLinearHistogram {
+	static constexpr unsigned kNumExactValues = 16;
+	static constexpr unsigned kSubBucketBits = 3;
+	static constexpr unsigned kNumBuckets = kNumExactValues + ( 64 - 4 ) * ( 1u << kSubBucketBits );
+
+	uint64_t counts[kNumBuckets] {};
+
+	static unsigned bucketOf( uint64_t value ) {
+		if( value < kNumExactValues ) {
+			return (unsigned)value;
+		}
+		const unsigned exponent = 63 - (unsigned)__builtin_clzll( value );
+		const auto subBucket = (unsigned)( value >> ( exponent - kSubBucketBits ) ) & ( ( 1u << kSubBucketBits ) - 1 );
+		return kNumExactValues + ( ( exponent - 4 ) << kSubBucketBits ) + subBucket;
+	}
+
+	static uint64_t lowerBoundOf( unsigned bucket ) {
+		if( bucket < kNumExactValues ) {
+			return bucket;
+		}
+		const unsigned exponent = 4 + ( ( bucket - kNumExactValues ) >> kSubBucketBits );
+		const uint64_t subBucket = ( bucket - kNumExactValues ) & ( ( 1u << kSubBucketBits ) - 1 );
+		return ( ( 1u << kSubBucketBits ) + subBucket ) << ( exponent - kSubBucketBits );
+	}
+
+	static uint64_t widthOf( unsigned bucket ) {
+		return bucket < kNumExactValues ? 1 : (uint64_t)1 << ( 4 + ( ( bucket - kNumExactValues ) >> kSubBucketBits ) - kSubBucketBits );
+	}
+public:
+	void add( uint64_t value ) { counts[bucketOf( value )]++; }
+
+	bool isEmpty() const {
+		return std::all_of( std::begin( counts ), std::end( counts ), []( uint64_t count ) { return !count; } );
+	}
+
+	/**
+	 * Draws a value of a bucket that is chosen proportionally to counts (the value is uniform within the bucket).
+	 * @note the histogram must not be empty.
+	 */
+	uint64_t draw( std::mt19937_64 &rng ) const {
+		std::discrete_distribution<unsigned> bucketDistribution( std::begin( counts ), std::end( counts ) );
+		const unsigned bucket = bucketDistribution( rng );
+		const uint64_t low = lowerBoundOf( bucket );
+		return std::uniform_int_distribution<uint64_t>( low, low + ( widthOf( bucket ) - 1 ) )( rng );
+	}
+
+	/**
+	 * Writes non-empty buckets as {@code lowerBound:count} pairs.
+	 */
+	void write( std::ostream &stream ) const {
+		for( unsigned i = 0; i < kNumBuckets; ++i ) {
+			if( counts[i] ) {
+				stream << ' ' << lowerBoundOf( i ) << ':' << counts[i];
+			}
+		}
+	}
+
+	bool tryReading( std::istream &stream ) {
+		uint64_t lowerBound;
+		char separator;
+		uint64_t count;
+		while( stream >> lowerBound >> separator >> count ) {
+			if( separator != ':' ) {
+				return false;
+			}
+			counts[bucketOf( lowerBound )] = count;
+		}
+		return stream.eof();
+	}
+};
+
+/**
+ * An anonymized shape of inputs. It keeps no titles or timestamps and no keys but the minimal one, only their statistics,
+ * so it may be taken from production inputs and replayed by the generator to get look-alike data.
+ */
+struct InputProfile {
+	uint64_t numFiles { 0 };
+	uint64_t numEntries { 0 };
+	uint64_t numDistinctKeys { 0 };
+	/**
+	 * The minimal key, so generated keys keep the profiled range (including negative keys).
+	 */
+	int64_t minKey { 0 };
+	/**
+	 * A difference of the maximal and minimal keys plus one. Density of keys is a ratio of distinct keys to the span.
+	 */
+	uint64_t keySpan { 0 };
+	uint64_t timestampSpan { 0 };
+	uint64_t numDeleted { 0 };
+	/**
+	 * Adjacent pairs of entries within files and how many of them are in non-decreasing order.
+	 */
+	uint64_t numAdjacentPairs { 0 };
+	uint64_t numSortedKeyPairs { 0 };
+	uint64_t numSortedTimestampPairs { 0 };
+	/**
+	 * Distinct keys that appear in more than a single file.
+	 */
+	uint64_t numKeysInSeveralFiles { 0 };
+	LogLinearHistogram entriesPerFile;
+	LogLinearHistogram titleLengths;
+	LogLinearHistogram occurrencesPerKey;
+	LogLinearHistogram filesPerKey;
+
+	void write( std::ostream &stream ) const;
+	bool tryReading( const char *filename, std::string &error );
+};
+
+/**
+ * Scans inputs and writes their anonymized profile instead of merging them.
+ * @return an exit code of the program.
+ */
+int profileInputs( const Options &options, ThreadPool &threadPool );
+
+/**
+ * Generates inputs that look like ones of the profile.
+ * Keys are spread over the profiled span from the profiled minimal key with the profiled density and repeat as profiled.
+ * Occurrences of keys are shuffled across files, so the spread of keys over files is only approximated.
+ * Files are sorted by keys if profiled ones are, otherwise the profiled share of unsorted timestamps is reproduced.
+ * @return an exit code of the program.
+ */
+int generateFromProfile( const Options &options );
+
+#endif
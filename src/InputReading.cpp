@@ -0,0 +1,247 @@
+#include "InputReading.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include "Compression.h"
+#include "EntriesParser.h"
+#include "Progress.h"
+#include "RecordSchema.h"
+
+static bool tryReadingFileDirectly( int fd, size_t size, std::string &output, std::string &error ) {
+	// Direct reads require the buffer, the offset and the length to be aligned to the logical block size
+	constexpr size_t kAlignment = 4096;
+	constexpr size_t kBufferSize = 4u << 20;
+	void *buffer = nullptr;
+	if( ::posix_memalign( &buffer, kAlignment, kBufferSize ) ) {
+		error = "Failed to allocate an aligned buffer";
+		return false;
+	}
+	std::unique_ptr<void, decltype( &std::free )> bufferHolder( buffer, &std::free );
+	output.reserve( size );
+	for(;; ) {
+		const ssize_t result = ::read( fd, buffer, kBufferSize );
+		if( result < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			error = "Failed to read a file content: " + std::string( std::strerror( errno ) );
+			return false;
+		}
+		output.append( (const char *)buffer, (size_t)result );
+		// A short read happens only at the end of the file
+		if( (size_t)result < kBufferSize ) {
+			return true;
+		}
+	}
+}
+
+static bool tryReadingFileDroppingPages( int fd, size_t size, std::string &output, std::string &error ) {
+	constexpr size_t kChunkSize = 8u << 20;
+	::posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+	output.resize( size );
+	for( size_t offset = 0; offset < size; ) {
+		const ssize_t result = ::read( fd, &output[offset], std::min( kChunkSize, size - offset ) );
+		if( result < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			error = "Failed to read a file content: " + std::string( std::strerror( errno ) );
+			return false;
+		}
+		if( !result ) {
+			error = "Failed to read a file content: the file got truncated";
+			return false;
+		}
+		::posix_fadvise( fd, (off_t)offset, (off_t)result, POSIX_FADV_DONTNEED );
+		offset += (size_t)result;
+	}
+	return true;
+}
+
+bool tryReadingFile( const char *filename, InputMode inputMode, std::string &output, std::string &error ) {
+	if( inputMode != CachedInput ) {
+		int fd = -1;
+		if( inputMode == DirectInput ) {
+			fd = ::open( filename, O_RDONLY | O_DIRECT );
+			if( fd < 0 && errno == EINVAL ) {
+				inputMode = DroppingInput;
+			}
+		}
+		if( inputMode == DroppingInput ) {
+			fd = ::open( filename, O_RDONLY );
+		}
+		if( fd < 0 ) {
+			error = "Failed to open a file: " + std::string( std::strerror( errno ) );
+			return false;
+		}
+		struct stat fileStat;
+		bool succeeded = false;
+		if( ::fstat( fd, &fileStat ) < 0 ) {
+			error = "Failed to get a file size: " + std::string( std::strerror( errno ) );
+		} else if( inputMode == DirectInput ) {
+			succeeded = ::tryReadingFileDirectly( fd, (size_t)fileStat.st_size, output, error );
+		} else {
+			succeeded = ::tryReadingFileDroppingPages( fd, (size_t)fileStat.st_size, output, error );
+		}
+		::close( fd );
+		return succeeded;
+	}
+
+	std::ifstream stream;
+	stream.open( filename, std::ios_base::in | std::ios_base::binary );
+	if( !stream.is_open() ) {
+		error = "Failed to open a file stream";
+		return false;
+	}
+	stream.seekg( 0, std::ios_base::end );
+	const std::streamoff size = stream.tellg();
+	if( size < 0 ) {
+		error = "Failed to get a file size";
+		return false;
+	}
+	stream.seekg( 0, std::ios_base::beg );
+	output.resize( (size_t)size );
+	if( !stream.read( &output[0], size ) ) {
+		error = "Failed to read a file content";
+		return false;
+	}
+	return true;
+}
+
+bool tryCountingCachedPages( const char *filename, uint64_t &numCachedPages, uint64_t &numPages ) {
+	numCachedPages = numPages = 0;
+	const int fd = ::open( filename, O_RDONLY );
+	if( fd < 0 ) {
+		return false;
+	}
+	struct stat fileStat;
+	if( ::fstat( fd, &fileStat ) < 0 ) {
+		::close( fd );
+		return false;
+	}
+	// An empty file has no pages to map
+	if( !fileStat.st_size ) {
+		::close( fd );
+		return true;
+	}
+	const auto size = (size_t)fileStat.st_size;
+	void *mapping = ::mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+	::close( fd );
+	if( mapping == MAP_FAILED ) {
+		return false;
+	}
+	const auto pageSize = (size_t)::sysconf( _SC_PAGESIZE );
+	std::vector<unsigned char> residency( ( size + pageSize - 1 ) / pageSize );
+	const bool succeeded = ::mincore( mapping, size, residency.data() ) == 0;
+	::munmap( mapping, size );
+	if( !succeeded ) {
+		return false;
+	}
+	numPages = residency.size();
+	for( unsigned char flags: residency ) {
+		numCachedPages += flags & 1;
+	}
+	return true;
+}
+
+static size_t countLineFeeds( const char *p, const char *end ) {
+	size_t result = 0;
+#ifdef __SSE2__
+	const __m128i lineFeeds = _mm_set1_epi8( '\n' );
+	for(; end - p >= 16; p += 16 ) {
+		const __m128i block = _mm_loadu_si128( (const __m128i *)p );
+		result += (size_t)__builtin_popcount( (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( block, lineFeeds ) ) );
+	}
+#endif
+	return result + (size_t)std::count( p, end, '\n' );
+}
+
+/**
+ * Parses entries of a decompressed content as chunks of it arrive.
+ * The buffered text is split right after commas that separate elements of the root array,
+ * so only a tail that may hold an incomplete element is kept between chunks.
+ * @param output a list of parsed entries. It's modified only on success.
+ */
+static bool tryParsingStream( DecompressingStream &stream, TitlePool &titlePool, std::vector<Entry> &output, bool skipInvalid,
+							  std::vector<std::string> &warnings, std::string &error ) {
+	std::vector<Entry> result;
+	std::string window, chunk;
+	ElementBoundaryScanner scanner;
+	size_t scannedUpTo = 0;
+	// A position of the window within the content
+	uint64_t offset = 0;
+	size_t line = 1, column = 0;
+	ptrdiff_t elementIndex = -1;
+	bool isFirst = true;
+	while( stream.tryPopping( chunk ) ) {
+		window.append( chunk );
+		const char *const boundaryPtr = scanner.scan( window.data() + scannedUpTo, window.data() + window.size() );
+		scannedUpTo = window.size();
+		if( !boundaryPtr ) {
+			continue;
+		}
+		const auto boundary = (size_t)( boundaryPtr - window.data() );
+
+		EntriesParser parser( window.data(), window.data() + boundary, titlePool );
+		parser.setOrigin( offset, line, column );
+		if( !parser.parseSegment( result, isFirst, false, elementIndex, skipInvalid, warnings, error ) ) {
+			return false;
+		}
+		isFirst = false;
+		const auto lastLineFeed = std::find( window.rbegin() + (ptrdiff_t)( window.size() - boundary ), window.rend(), '\n' );
+		line += ::countLineFeeds( window.data(), window.data() + boundary );
+		column = lastLineFeed == window.rend() ? column + boundary : (size_t)( lastLineFeed - window.rbegin() ) - ( window.size() - boundary );
+		offset += boundary;
+		window.erase( 0, boundary );
+		scannedUpTo -= boundary;
+	}
+	if( !stream.tryFinishing( error ) ) {
+		return false;
+	}
+
+	EntriesParser parser( window.data(), window.data() + window.size(), titlePool );
+	parser.setOrigin( offset, line, column );
+	if( !parser.parseSegment( result, isFirst, true, elementIndex, skipInvalid, warnings, error ) ) {
+		return false;
+	}
+	output.clear();
+	std::swap( result, output );
+	return true;
+}
+
+bool tryReadingEntries( const char *filename, InputMode inputMode, ThreadPool &threadPool, std::vector<Entry> &output,
+						TitlePool &titlePool, bool skipInvalid, std::vector<std::string> &warnings, std::string &error ) {
+	std::string content;
+	if( !::tryReadingFile( filename, inputMode, content, error ) ) {
+		return false;
+	}
+	if( progressCounters ) {
+		progressCounters->onRead( content.size() );
+	}
+	// Compressed content is parsed while it's being decompressed
+	if( DecompressingStream::isCompressed( content.data(), content.size() ) ) {
+		DecompressingStream stream( content, threadPool );
+		return stream.tryStarting( error ) && ::tryParsingStream( stream, titlePool, output, skipInvalid, warnings, error );
+	}
+	EntriesParser parser( content.data(), content.data() + content.size(), titlePool );
+	return parser.parse( output, skipInvalid, warnings, error );
+}
+
+uint64_t getFileSize( const char *filename ) {
+	struct stat fileStat;
+	return ::stat( filename, &fileStat ) == 0 ? (uint64_t)fileStat.st_size : 0;
+}
+
+uint64_t estimateReadingBytes( const char *filename ) {
+	char magic[4];
+	std::ifstream stream( filename, std::ios_base::in | std::ios_base::binary );
+	stream.read( magic, sizeof( magic ) );
+	const bool isCompressed = DecompressingStream::isCompressed( magic, (size_t)stream.gcount() );
+	return ::getFileSize( filename ) + ( isCompressed ? DecompressingStream::kMaxBufferedBytes : 0 );
+}
@@ -0,0 +1,197 @@
+#ifndef MERGELISTS_INPUT_READING_H
+#define MERGELISTS_INPUT_READING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Entry.h"
+#include "ThreadPool.h"
+#include "TitlePool.h"
+
+/**
+ * Ways of reading input files.
+ */
+enum InputMode {
+	/**
+	 * Reading through the page cache.
+	 */
+	CachedInput,
+	/**
+	 * Reading with {@code O_DIRECT} that bypasses the page cache.
+	 * Files of file systems that do not support it are read in the {@code DroppingInput} mode.
+	 */
+	DirectInput,
+	/**
+	 * Reading through the page cache and dropping pages as soon as they are consumed.
+	 */
+	DroppingInput
+};
+
+bool tryReadingFile( const char *filename, InputMode inputMode, std::string &output, std::string &error );
+
+/**
+ * Asks the kernel to read upcoming input files ahead, so reading them overlaps with parsing of the current ones.
+ * Files are hinted in order, and no more than the given number of files beyond the started ones are hinted.
+ * It needs no threads of its own, as the kernel reads the hinted files in the background.
+ */
+class InputPrefetcher {
+	const std::vector<const char *> &filenames;
+	const size_t depth;
+	std::mutex mutex;
+	/**
+	 * A number of leading files that are either started or hinted.
+	 */
+	size_t numCovered { 0 };
+	std::atomic<size_t> numFilesHinted { 0 };
+	std::atomic<uint64_t> numBytesHinted { 0 };
+
+	void hint( const char *filename ) {
+		const int fd = ::open( filename, O_RDONLY );
+		if( fd < 0 ) {
+			// Let the reading report the failure
+			return;
+		}
+		struct stat fileStat;
+		if( ::fstat( fd, &fileStat ) == 0 && ::posix_fadvise( fd, 0, 0, POSIX_FADV_WILLNEED ) == 0 ) {
+			numFilesHinted.fetch_add( 1, std::memory_order_relaxed );
+			numBytesHinted.fetch_add( (uint64_t)fileStat.st_size, std::memory_order_relaxed );
+		}
+		::close( fd );
+	}
+public:
+	InputPrefetcher( const std::vector<const char *> &filenames_, size_t depth_ ): filenames( filenames_ ), depth( depth_ ) {}
+
+	/**
+	 * Hints files that follow the started one. It is safe to call this concurrently.
+	 */
+	void onStarted( size_t fileIndex ) {
+		size_t first, last;
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			first = std::max( numCovered, fileIndex + 1 );
+			last = std::min( filenames.size(), fileIndex + 1 + depth );
+			numCovered = std::max( numCovered, last );
+		}
+		for( size_t i = first; i < last; ++i ) {
+			hint( filenames[i] );
+		}
+	}
+
+	size_t numFiles() const { return numFilesHinted.load( std::memory_order_relaxed ); }
+	uint64_t numBytes() const { return numBytesHinted.load( std::memory_order_relaxed ); }
+};
+
+/**
+ * Counts pages of a file that reside in the page cache.
+ * @return false if the file could not be inspected.
+ */
+bool tryCountingCachedPages( const char *filename, uint64_t &numCachedPages, uint64_t &numPages );
+
+/**
+ * Finds boundaries of elements of the root array in a text that arrives in parts.
+ * It tracks only strings and the nesting depth, so it's much cheaper than parsing.
+ */
+class ElementBoundaryScanner {
+	int depth { 0 };
+	bool isInString { false };
+	/**
+	 * Whether the last scanned character is a backslash that escapes the next one.
+	 */
+	bool isEscaped { false };
+
+	void scanCharacter( const char *p, const char *&boundary ) {
+		const char ch = *p;
+		if( isInString ) {
+			if( isEscaped ) {
+				isEscaped = false;
+			} else if( ch == '\\' ) {
+				isEscaped = true;
+			} else if( ch == '"' ) {
+				isInString = false;
+			}
+		} else if( ch == '"' ) {
+			isInString = true;
+		} else if( ch == '[' || ch == '{' ) {
+			depth++;
+		} else if( ch == ']' || ch == '}' ) {
+			depth--;
+		} else if( ch == ',' && depth == 1 ) {
+			boundary = p + 1;
+		}
+	}
+public:
+	/**
+	 * Scans the next part of the text.
+	 * @return a position right after the last comma that separates elements of the root array or null if there's none.
+	 */
+	const char *scan( const char *p, const char *end ) {
+		const char *boundary = nullptr;
+#ifdef __SSE2__
+		// Only quotes, brackets and commas of a block are examined unless they are escaped
+		const __m128i quotes = _mm_set1_epi8( '"' ), backslashes = _mm_set1_epi8( '\\' ), commas = _mm_set1_epi8( ',' );
+		const __m128i openingBrackets = _mm_set1_epi8( '[' ), closingBrackets = _mm_set1_epi8( ']' );
+		const __m128i openingBraces = _mm_set1_epi8( '{' ), closingBraces = _mm_set1_epi8( '}' );
+		for(; end - p >= 16; p += 16 ) {
+			const __m128i block = _mm_loadu_si128( (const __m128i *)p );
+			unsigned escapedMask = isEscaped ? 1u : 0u;
+			isEscaped = false;
+			for( auto mask = (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( block, backslashes ) ); mask; mask &= mask - 1 ) {
+				const unsigned bit = mask & -mask;
+				if( !( escapedMask & bit ) ) {
+					escapedMask |= bit << 1;
+				}
+			}
+			const __m128i brackets = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( block, openingBrackets ), _mm_cmpeq_epi8( block, closingBrackets ) ),
+												   _mm_or_si128( _mm_cmpeq_epi8( block, openingBraces ), _mm_cmpeq_epi8( block, closingBraces ) ) );
+			const __m128i interesting = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( block, quotes ), _mm_cmpeq_epi8( block, commas ) ), brackets );
+			for( auto mask = (unsigned)_mm_movemask_epi8( interesting ) & ~escapedMask; mask; mask &= mask - 1 ) {
+				scanCharacter( p + __builtin_ctz( mask ), boundary );
+			}
+			// An escaping backslash may end the block
+			isEscaped = ( escapedMask & ( 1u << 16 ) ) != 0;
+		}
+#endif
+		for(; p != end; ++p ) {
+			scanCharacter( p, boundary );
+		}
+		return boundary;
+	}
+};
+
+/**
+ * Reads entries of a file.
+ * @param filename a name of the file.
+ * @param inputMode a way of reading the file.
+ * @param threadPool a pool for decompression of the file if it's compressed.
+ * @param output a list of parsed entries. It's modified only on success.
+ * @param titlePool a pool that receives titles of parsed entries.
+ * @param skipInvalid whether elements that are not valid entries should be skipped instead of failing.
+ * @param warnings a list of position-aware descriptions of skipped elements.
+ * @param error a position-aware description of a failure.
+ * @return true on success.
+ */
+bool tryReadingEntries( const char *filename, InputMode inputMode, ThreadPool &threadPool, std::vector<Entry> &output,
+						TitlePool &titlePool, bool skipInvalid, std::vector<std::string> &warnings, std::string &error );
+
+uint64_t getFileSize( const char *filename );
+
+/**
+ * Estimates bytes that are held while a file is being read and parsed.
+ * Decompressed content of a compressed file is held only by bounded buffers of a stream.
+ */
+uint64_t estimateReadingBytes( const char *filename );
+
+#endif
@@ -0,0 +1,207 @@
+#include "Jobs.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Combiner.h"
+#include "CompressedEntriesWriter.h"
+#include "EngineChoice.h"
+#include "EntriesFileWriter.h"
+#include "Entry.h"
+#include "InputReading.h"
+#include "Statistics.h"
+#include "TitlePool.h"
+
+/**
+ * An independent merge of inputs into an output.
+ */
+struct Job {
+	std::string outputFilename;
+	std::vector<std::string> inputFilenames;
+};
+
+/**
+ * Resources that are reused by consecutive jobs. They get cleared rather than freed between jobs.
+ */
+struct JobResources {
+	TitlePool titlePool;
+	MergeBuilder builder;
+	EntriesFileWriter fileWriter;
+	CompressedEntriesWriter compressedWriter;
+	std::vector<std::vector<Entry>> readLists;
+	std::vector<std::vector<std::string>> warnings;
+	std::vector<std::string> errors;
+
+	JobResources( const Options &options, ThreadPool &threadPool )
+		: titlePool( options.internTitles, options.compressTitles ),
+		  fileWriter( titlePool, threadPool ), compressedWriter( titlePool, threadPool, options.outputCodec ) {}
+};
+
+struct JobTimings {
+	double loadingSeconds { 0.0 };
+	double mergingSeconds { 0.0 };
+	double writingSeconds { 0.0 };
+	uint64_t numEntriesParsed { 0 };
+	size_t numEntriesWritten { 0 };
+	/**
+	 * Why the engine of the job was chosen if it was chosen automatically.
+	 */
+	std::string engineChoiceReasoning;
+};
+
+/**
+ * Reads jobs from a file that lists an output and inputs of a job per line.
+ * Empty lines and lines that start with {@code #} are ignored.
+ */
+static bool tryReadingJobs( const char *filename, std::vector<Job> &jobs, std::string &error ) {
+	std::ifstream stream( filename );
+	if( !stream.is_open() ) {
+		error = std::string( "Failed to open a file stream of `" ) + filename + "`";
+		return false;
+	}
+	std::string line;
+	for( size_t lineNum = 1; std::getline( stream, line ); ++lineNum ) {
+		std::istringstream lineStream( line );
+		Job job;
+		if( !( lineStream >> job.outputFilename ) || job.outputFilename[0] == '#' ) {
+			continue;
+		}
+		for( std::string inputFilename; lineStream >> inputFilename; ) {
+			job.inputFilenames.emplace_back( std::move( inputFilename ) );
+		}
+		if( job.inputFilenames.empty() ) {
+			error = "A job at line " + std::to_string( lineNum ) + " has no inputs";
+			return false;
+		}
+		jobs.emplace_back( std::move( job ) );
+	}
+	return true;
+}
+
+static bool tryRunningJob( const Job &job, const Options &options, const MergeBuilder::Config &baseConfig, ThreadPool &threadPool,
+						   JobResources &resources, JobTimings &timings, std::string &error ) {
+	MergeBuilder::Config config( baseConfig );
+	std::vector<const char *> filenames;
+	for( const std::string &filename: job.inputFilenames ) {
+		filenames.push_back( filename.c_str() );
+	}
+	// Jobs sample their own inputs
+	if( options.autoEngine ) {
+		InputSample sample;
+		if( !::trySamplingInputs( filenames, sample, error ) ) {
+			return false;
+		}
+		unsigned chosenNumThreads;
+		::chooseEngine( sample, filenames.size(), config, chosenNumThreads, timings.engineChoiceReasoning );
+		if( chosenNumThreads != threadPool.numThreads() ) {
+			timings.engineChoiceReasoning += "; jobs share a pool of " + std::to_string( threadPool.numThreads() ) + " threads instead";
+		}
+	}
+
+	const auto startedAt = std::chrono::steady_clock::now();
+	resources.titlePool.clear();
+	const size_t numFiles = filenames.size();
+	// Keep lists of the largest job, so their memory is reused
+	if( resources.readLists.size() < numFiles ) {
+		resources.readLists.resize( numFiles );
+		resources.warnings.resize( numFiles );
+		resources.errors.resize( numFiles );
+	}
+	std::unique_ptr<bool[]> succeeded( new bool[numFiles] );
+	threadPool.parallelFor( numFiles, [&]( size_t i ) {
+		resources.warnings[i].clear();
+		resources.errors[i].clear();
+		succeeded[i] = ::tryReadingEntries( filenames[i], options.inputMode, threadPool, resources.readLists[i], resources.titlePool,
+											options.skipInvalid, resources.warnings[i], resources.errors[i] );
+		if( succeeded[i] && options.combine ) {
+			::combineEntries( resources.readLists[i] );
+		}
+	});
+	for( size_t i = 0; i < numFiles; ++i ) {
+		for( const std::string &warning: resources.warnings[i] ) {
+			std::cerr << "Skipping an invalid element of `" << filenames[i] << "`: " << warning << std::endl;
+		}
+		if( !succeeded[i] ) {
+			error = "Failed to read a file content of `" + job.inputFilenames[i] + "`: " + resources.errors[i];
+			return false;
+		}
+		timings.numEntriesParsed += resources.readLists[i].size();
+	}
+	const auto loadedAt = std::chrono::steady_clock::now();
+
+	resources.builder.reset( config );
+	for( size_t i = 0; i < numFiles; ++i ) {
+		resources.builder.addEntries( resources.readLists[i] );
+	}
+	const std::vector<const Entry *> entries( resources.builder.build() );
+	const auto mergedAt = std::chrono::steady_clock::now();
+
+	bool succeededWriting;
+	if( options.compressOutput ) {
+		std::ofstream stream( job.outputFilename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+		if( !stream.is_open() ) {
+			error = "Failed to open a file stream of `" + job.outputFilename + "`";
+			return false;
+		}
+		succeededWriting = resources.compressedWriter.tryWriting( stream, entries, error );
+	} else {
+		succeededWriting = resources.fileWriter.tryWriting( job.outputFilename.c_str(), entries, error );
+	}
+	if( !succeededWriting ) {
+		return false;
+	}
+	const auto writtenAt = std::chrono::steady_clock::now();
+
+	timings.numEntriesWritten = entries.size();
+	timings.loadingSeconds = std::chrono::duration<double>( loadedAt - startedAt ).count();
+	timings.mergingSeconds = std::chrono::duration<double>( mergedAt - loadedAt ).count();
+	timings.writingSeconds = std::chrono::duration<double>( writtenAt - mergedAt ).count();
+	return true;
+}
+
+int runJobs( const Options &options, const MergeBuilder::Config &config, ThreadPool &threadPool ) {
+	std::vector<Job> jobs;
+	std::string error;
+	if( !::tryReadingJobs( options.jobsFilename, jobs, error ) ) {
+		std::cerr << "Failed to read jobs: " << error << std::endl;
+		return 1;
+	}
+
+	JobResources resources( options, threadPool );
+	size_t numFailed = 0;
+	const auto startedAt = std::chrono::steady_clock::now();
+	for( size_t i = 0; i < jobs.size(); ++i ) {
+		JobTimings timings;
+		if( !::tryRunningJob( jobs[i], options, config, threadPool, resources, timings, error ) ) {
+			std::cerr << "Job " << i + 1 << " (`" << jobs[i].outputFilename << "`) failed: " << error << std::endl;
+			numFailed++;
+			continue;
+		}
+		if( options.printStats ) {
+			std::ostringstream description;
+			description << timings.numEntriesParsed << " entries parsed, " << timings.numEntriesWritten << " entries written, ";
+			description << "loading " << timings.loadingSeconds << " s, merging " << timings.mergingSeconds << " s, ";
+			description << "writing " << timings.writingSeconds << " s";
+			if( !timings.engineChoiceReasoning.empty() ) {
+				description << ", engine choice: " << timings.engineChoiceReasoning;
+			}
+			printStat( ( "job " + std::to_string( i + 1 ) + " `" + jobs[i].outputFilename + "`" ).c_str(), description.str() );
+		}
+	}
+
+	if( options.printStats ) {
+		printStat( "threads", threadPool.numThreads() );
+		printStat( "jobs", jobs.size() );
+		printStat( "jobs failed", numFailed );
+		printStat( "jobs seconds", std::chrono::duration<double>( std::chrono::steady_clock::now() - startedAt ).count() );
+	}
+	return numFailed ? 1 : 0;
+}
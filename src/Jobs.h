@@ -0,0 +1,15 @@
+#ifndef MERGELISTS_JOBS_H
+#define MERGELISTS_JOBS_H
+
+#include "MergeBuilder.h"
+#include "Options.h"
+#include "ThreadPool.h"
+
+/**
+ * Runs all jobs of the file one by one sharing the thread pool and reusing other resources.
+ * A failed job does not stop further jobs.
+ * @return an exit code of the program.
+ */
+int runJobs( const Options &options, const MergeBuilder::Config &config, ThreadPool &threadPool );
+
+#endif
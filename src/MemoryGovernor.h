@@ -0,0 +1,71 @@
+#ifndef MERGELISTS_MEMORY_GOVERNOR_H
+#define MERGELISTS_MEMORY_GOVERNOR_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Tracks bytes held by stages of the pipeline against a memory budget.
+ * Transient holders (buffers of read files) wait while the budget is exceeded and other transient bytes are held,
+ * so readers and parsers get throttled instead of running the host out of memory.
+ * Retained bytes (parsed entries, titles, merge tables and output buffers) are only accounted.
+ */
+class MemoryGovernor {
+	/**
+	 * A budget in bytes. Zero means it's unlimited.
+	 */
+	const uint64_t budget;
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	uint64_t transientBytes { 0 };
+	uint64_t retainedBytes { 0 };
+	uint64_t peakBytes { 0 };
+	uint64_t numThrottledWaits { 0 };
+
+	void updatePeak() {
+		peakBytes = std::max( peakBytes, transientBytes + retainedBytes );
+	}
+public:
+	explicit MemoryGovernor( uint64_t budget_ ): budget( budget_ ) {}
+
+	/**
+	 * Acquires transient bytes waiting for other transient holders if the budget would be exceeded.
+	 */
+	void acquireTransient( uint64_t bytes ) {
+		std::unique_lock<std::mutex> lock( mutex );
+		if( budget && transientBytes && transientBytes + retainedBytes + bytes > budget ) {
+			numThrottledWaits++;
+			condition.wait( lock, [&]() { return !transientBytes || transientBytes + retainedBytes + bytes <= budget; } );
+		}
+		transientBytes += bytes;
+		updatePeak();
+	}
+
+	void releaseTransient( uint64_t bytes ) {
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			transientBytes -= bytes;
+		}
+		condition.notify_all();
+	}
+
+	void retain( uint64_t bytes ) {
+		std::lock_guard<std::mutex> lock( mutex );
+		retainedBytes += bytes;
+		updatePeak();
+	}
+
+	uint64_t limit() const { return budget; }
+	uint64_t peak() const {
+		std::lock_guard<std::mutex> lock( mutex );
+		return peakBytes;
+	}
+	uint64_t numWaits() const {
+		std::lock_guard<std::mutex> lock( mutex );
+		return numThrottledWaits;
+	}
+};
+
+#endif
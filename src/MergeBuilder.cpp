@@ -0,0 +1,339 @@
+#include "MergeBuilder.h"
+
+#include <algorithm>
+#include <climits>
+#include <type_traits>
+
+#if defined( MERGELISTS_HAS_AVX512_KERNEL )
+__attribute__(( target( "avx512f,avx512cd" ) ))
+const Entry *mergeIntoDenseSlotsAvx512( const Entry *begin, const Entry *end, int64_t base, size_t numSlots,
+										const Entry **slots, uint64_t *timestamps, size_t &numWinnersAdded, uint64_t &numWinnersReplaced ) {
+	static_assert( sizeof( Entry ) == 32, "Offsets of lanes assume the size of an entry" );
+	const __m512i laneOffsets = _mm512_set_epi64( 7 * 32, 6 * 32, 5 * 32, 4 * 32, 3 * 32, 2 * 32, 32, 0 );
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i bases = _mm512_set1_epi64( base );
+	const __m512i limits = _mm512_set1_epi64( (int64_t)numSlots );
+	const Entry *entry = begin;
+	for(; end - entry >= 8; entry += 8 ) {
+		// Masked forms are used as unmasked ones leave their sources undefined (and compilers warn on that)
+		const __m256i narrowNums = _mm512_mask_i64gather_epi32( _mm256_setzero_si256(), 0xFF, laneOffsets, &entry->num, 1 );
+		const __m512i nums = _mm512_maskz_cvtepi32_epi64( 0xFF, narrowNums );
+		const __m512i indices = _mm512_sub_epi64( nums, bases );
+		if( _mm512_cmplt_epu64_mask( indices, limits ) != 0xFF ) {
+			break;
+		}
+		const __m512i newTimestamps = _mm512_mask_i64gather_epi64( zero, 0xFF, laneOffsets, &entry->timestamp, 1 );
+		const __m512i newPointers = _mm512_add_epi64( _mm512_set1_epi64( (int64_t)(uintptr_t)entry ), laneOffsets );
+		// Every lane gets a mask of preceding lanes that have the same key
+		const __m512i conflicts = _mm512_conflict_epi64( indices );
+		__mmask8 remaining = 0xFF;
+		while( remaining ) {
+			const __m512i pending = _mm512_and_epi64( conflicts, _mm512_set1_epi64( remaining ) );
+			const __mmask8 active = _mm512_mask_testn_epi64_mask( remaining, pending, pending );
+			const __m512i currentPointers = _mm512_mask_i64gather_epi64( zero, active, indices, slots, 8 );
+			const __m512i currentTimestamps = _mm512_mask_i64gather_epi64( zero, active, indices, timestamps, 8 );
+			const __mmask8 empty = _mm512_mask_cmpeq_epi64_mask( active, currentPointers, zero );
+			const __mmask8 wins = empty | _mm512_mask_cmpgt_epu64_mask( active, newTimestamps, currentTimestamps );
+			_mm512_mask_i64scatter_epi64( slots, wins, indices, newPointers, 8 );
+			_mm512_mask_i64scatter_epi64( timestamps, wins, indices, newTimestamps, 8 );
+			numWinnersAdded += (size_t)__builtin_popcount( empty );
+			numWinnersReplaced += (uint64_t)__builtin_popcount( wins & (__mmask8)~empty );
+			remaining &= (__mmask8)~active;
+		}
+	}
+	return entry;
+}
+#endif
+
+void MergeBuilder::reset( const Config &config_ ) {
+	config = config_;
+	buckets.clear();
+	if( config.engine == HashEngine && config.expectedNumKeys ) {
+		buckets.reserve( config.expectedNumKeys );
+	}
+	// The capacity is kept, so growing within it does not reallocate
+	denseSlots.clear();
+	denseTimestamps.clear();
+	denseBase = 0;
+	numDenseWinners = 0;
+	lists.clear();
+	orderedWinners.clear();
+	versionedWinners.reset( config.engine == ConcurrentEngine ? new VersionedWinnerTable : nullptr );
+}
+
+uint64_t MergeBuilder::memoryUsage() const {
+	// A node of a hash table holds a pair and a link, and a node of a tree holds a pair, three links and a color
+	uint64_t result = buckets.bucket_count() * sizeof( void * );
+	result += buckets.size() * ( sizeof( std::pair<const int, const Entry *> ) + sizeof( void * ) );
+	result += denseSlots.capacity() * sizeof( const Entry * );
+	result += denseTimestamps.capacity() * sizeof( uint64_t );
+	result += lists.capacity() * sizeof( const std::vector<Entry> * );
+	result += orderedWinners.size() * ( sizeof( std::pair<uint64_t, const Entry *> ) + 4 * sizeof( void * ) );
+	return result;
+}
+
+bool MergeBuilder::tryGrowingDense( int num ) {
+	if( denseSlots.empty() ) {
+		denseBase = num;
+		denseSlots.resize( std::max<size_t>( config.expectedNumKeys, 1024 ) );
+		denseTimestamps.resize( denseSlots.size() );
+		return true;
+	}
+	const int64_t low = std::min<int64_t>( denseBase, num );
+	const int64_t high = std::max<int64_t>( denseBase + (int64_t)denseSlots.size() - 1, num );
+	const auto span = (uint64_t)( high - low + 1 );
+	// Do not let a few outliers blow the memory up
+	if( span > std::max<uint64_t>( 1u << 20, 8 * ( numDenseWinners + 1 ) ) ) {
+		return false;
+	}
+	// Leave some slack in the direction of growth to amortize reallocations
+	const uint64_t slack = span / 2;
+	int64_t newBase = low;
+	if( num < denseBase ) {
+		newBase = std::max<int64_t>( (int64_t)INT_MIN, low - (int64_t)slack );
+	}
+	const uint64_t newSize = (uint64_t)( high - newBase + 1 ) + ( num < denseBase ? 0 : slack );
+	std::vector<const Entry *> newSlots( newSize, nullptr );
+	std::copy( denseSlots.begin(), denseSlots.end(), newSlots.begin() + ( denseBase - newBase ) );
+	denseSlots.swap( newSlots );
+	std::vector<uint64_t> newTimestamps( newSize, 0 );
+	std::copy( denseTimestamps.begin(), denseTimestamps.end(), newTimestamps.begin() + ( denseBase - newBase ) );
+	denseTimestamps.swap( newTimestamps );
+	denseBase = newBase;
+	return true;
+}
+
+void MergeBuilder::switchDenseToHash() {
+	buckets.reserve( numDenseWinners * 2 );
+	for( size_t i = 0; i < denseSlots.size(); ++i ) {
+		if( denseSlots[i] ) {
+			buckets.emplace( std::make_pair( denseSlots[i]->num, denseSlots[i] ) );
+		}
+	}
+	std::vector<const Entry *>().swap( denseSlots );
+	std::vector<uint64_t>().swap( denseTimestamps );
+	numDenseWinners = 0;
+	config.engine = HashEngine;
+}
+
+void MergeBuilder::collectSortedWinners( std::vector<const Entry *> &result ) {
+	// A cursor over a list in ascending order of keys.
+	// A list that is not sorted gets an index of entries sorted stably by keys.
+	struct Cursor {
+		const Entry *entries;
+		std::vector<const Entry *> order;
+		size_t position;
+		size_t size;
+		size_t listIndex;
+
+		const Entry *current() const { return order.empty() ? entries + position : order[position]; }
+	};
+
+	std::vector<Cursor> cursors( lists.size() );
+	for( size_t i = 0; i < lists.size(); ++i ) {
+		const std::vector<Entry> &list = *lists[i];
+		Cursor &cursor = cursors[i];
+		cursor.entries = list.data();
+		cursor.position = 0;
+		cursor.size = list.size();
+		cursor.listIndex = i;
+		auto byNum = []( const Entry &lhs, const Entry &rhs ) { return lhs.num < rhs.num; };
+		if( !std::is_sorted( list.begin(), list.end(), byNum ) ) {
+			for( const Entry &entry: list ) {
+				cursor.order.push_back( &entry );
+			}
+			std::stable_sort( cursor.order.begin(), cursor.order.end(), []( const Entry *lhs, const Entry *rhs ) {
+				return lhs->num < rhs->num;
+			});
+		}
+	}
+
+	// Pop entries in the order of keys, then lists, then positions, so the first met entry of a key
+	// corresponds to the first one that would have been added to a hash table
+	auto isPoppedLater = []( const Cursor *lhs, const Cursor *rhs ) {
+		const int lhsNum = lhs->current()->num, rhsNum = rhs->current()->num;
+		return lhsNum > rhsNum || ( lhsNum == rhsNum && lhs->listIndex > rhs->listIndex );
+	};
+	std::vector<Cursor *> heap;
+	for( Cursor &cursor: cursors ) {
+		if( cursor.size ) {
+			heap.push_back( &cursor );
+		}
+	}
+	std::make_heap( heap.begin(), heap.end(), isPoppedLater );
+
+	while( !heap.empty() ) {
+		std::pop_heap( heap.begin(), heap.end(), isPoppedLater );
+		Cursor *cursor = heap.back();
+		const Entry *entry = cursor->current();
+		if( !result.empty() && result.back()->num == entry->num ) {
+			if( *result.back() < *entry ) {
+				result.back() = entry;
+			}
+		} else {
+			result.push_back( entry );
+		}
+		if( ++cursor->position == cursor->size ) {
+			heap.pop_back();
+		} else {
+			std::push_heap( heap.begin(), heap.end(), isPoppedLater );
+		}
+	}
+}
+
+void MergeBuilder::collectPartitionedWinners( std::vector<const Entry *> &result ) {
+	constexpr unsigned kPartitionBits = 8;
+	constexpr unsigned kNumPartitions = 1u << kPartitionBits;
+	// Scatter entries keeping their relative order within a partition
+	auto partitionOf = []( int num ) {
+		return (unsigned)( ( (uint32_t)num * 2654435761u ) >> ( 32 - kPartitionBits ) );
+	};
+	std::vector<std::vector<const Entry *>> partitions( kNumPartitions );
+	for( const std::vector<Entry> *list: lists ) {
+		for( const Entry &entry: *list ) {
+			partitions[partitionOf( entry.num )].push_back( &entry );
+		}
+	}
+
+	std::vector<std::vector<const Entry *>> winners( kNumPartitions );
+	auto resolvePartition = [&]( size_t partitionNum ) {
+		std::unordered_map<int, const Entry *> table;
+		table.reserve( partitions[partitionNum].size() );
+		for( const Entry *entry: partitions[partitionNum] ) {
+			auto it = table.find( entry->num );
+			if( it == table.end() ) {
+				table.emplace( std::make_pair( entry->num, entry ) );
+			} else if( *it->second < *entry ) {
+				it->second = entry;
+			}
+		}
+		std::vector<const Entry *>().swap( partitions[partitionNum] );
+		for( const auto &kvPair: table ) {
+			winners[partitionNum].push_back( kvPair.second );
+		}
+	};
+	if( config.threadPool ) {
+		config.threadPool->parallelFor( kNumPartitions, resolvePartition );
+	} else {
+		for( size_t i = 0; i < kNumPartitions; ++i ) {
+			resolvePartition( i );
+		}
+	}
+
+	for( const auto &partitionWinners: winners ) {
+		result.insert( result.end(), partitionWinners.begin(), partitionWinners.end() );
+	}
+}
+
+void MergeBuilder::sortByTimestamp( std::vector<const Entry *> &result ) {
+	ProgressCounters *const progress = config.progressCounters;
+	if( config.sortAlgorithm == ComparisonSort ) {
+		// Provide a proper comparator for sorting pointers to items
+		auto cmp = []( const Entry *lhs, const Entry *rhs ) { return *lhs < *rhs; };
+		if( !progress ) {
+			std::sort( result.begin(), result.end(), cmp );
+			return;
+		}
+		// Comparisons are counted against an estimate of N log N of them, and they are reported in batches
+		constexpr uint64_t kBatchSize = 1u << 16;
+		uint64_t estimate = 0;
+		for( size_t n = result.size(); n > 1; n >>= 1 ) {
+			estimate += result.size();
+		}
+		progress->setStageTotal( estimate );
+		uint64_t numComparisons = 0, numReported = 0;
+		std::sort( result.begin(), result.end(), [&]( const Entry *lhs, const Entry *rhs ) {
+			if( ++numComparisons % kBatchSize == 0 && numReported + kBatchSize <= estimate ) {
+				progress->onSorted( kBatchSize );
+				numReported += kBatchSize;
+			}
+			return cmp( lhs, rhs );
+		});
+		progress->onSorted( estimate - numReported );
+		return;
+	}
+
+	// Sort keys next to pointers so passes do not have to dereference entries
+	typedef std::pair<uint64_t, const Entry *> Item;
+	std::vector<Item> items( result.size() ), scratch( result.size() );
+	uint64_t differingBits = 0;
+	for( size_t i = 0; i < result.size(); ++i ) {
+		items[i] = Item( result[i]->timestamp, result[i] );
+		differingBits |= items[i].first ^ items[0].first;
+	}
+	if( progress ) {
+		// A pass counts items and then moves them
+		unsigned numPasses = 0;
+		for( unsigned shift = 0; shift < 64; shift += 8 ) {
+			numPasses += ( ( differingBits >> shift ) & 0xFF ) != 0;
+		}
+		progress->setStageTotal( 2 * numPasses * items.size() );
+	}
+	// An LSD radix sort over bytes skipping bytes that are the same for all keys
+	for( unsigned shift = 0; shift < 64; shift += 8 ) {
+		if( !( ( differingBits >> shift ) & 0xFF ) ) {
+			continue;
+		}
+		size_t offsets[256] = { 0 };
+		for( const Item &item: items ) {
+			offsets[( item.first >> shift ) & 0xFF]++;
+		}
+		if( progress ) {
+			progress->onSorted( items.size() );
+		}
+		size_t total = 0;
+		for( size_t &offset: offsets ) {
+			const size_t count = offset;
+			offset = total;
+			total += count;
+		}
+		for( const Item &item: items ) {
+			scratch[offsets[( item.first >> shift ) & 0xFF]++] = item;
+		}
+		items.swap( scratch );
+		if( progress ) {
+			progress->onSorted( items.size() );
+		}
+	}
+	for( size_t i = 0; i < items.size(); ++i ) {
+		result[i] = items[i].second;
+	}
+}
+
+std::vector<const Entry *> MergeBuilder::build() {
+	std::vector<const Entry *> result;
+	if( isOrderMaintained() ) {
+		result.reserve( orderedWinners.size() );
+		for( const auto &timestampAndEntry: orderedWinners ) {
+			result.push_back( timestampAndEntry.second );
+		}
+		return result;
+	}
+	switch( config.engine ) {
+		case HashEngine:
+			result.reserve( buckets.size() );
+			for( const auto &kvPair : buckets ) {
+				result.push_back( kvPair.second );
+			}
+			break;
+		case DenseEngine:
+			result.reserve( numDenseWinners );
+			for( const Entry *entry: denseSlots ) {
+				if( entry ) {
+					result.push_back( entry );
+				}
+			}
+			break;
+		case SortedEngine:
+			collectSortedWinners( result );
+			break;
+		case PartitionedEngine:
+			collectPartitionedWinners( result );
+			break;
+		case ConcurrentEngine:
+			versionedWinners->collect( versionedWinners->latestVersion(), result );
+			break;
+	}
+	sortByTimestamp( result );
+	return result;
+}
@@ -0,0 +1,386 @@
+#ifndef MERGELISTS_MERGE_BUILDER_H
+#define MERGELISTS_MERGE_BUILDER_H
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+// The vectorized dense kernel is compiled for any x86-64 target and is used only if the CPU supports it
+#if defined( __x86_64__ ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define MERGELISTS_HAS_AVX512_KERNEL
+#include <immintrin.h>
+#endif
+
+#include "Entry.h"
+#include "Progress.h"
+#include "ThreadPool.h"
+#include "VersionedWinnerTable.h"
+
+/**
+ * An observer of changes of winners that does nothing, so the merge loop does not pay for observing.
+ * Any other observer of changes must provide the same members.
+ * Observers that only count changes get counts of changes of vectorized merging in bulk.
+ */
+struct NullChangeObserver {
+	static constexpr bool kCountsOnly = true;
+
+	void onInserted( const Entry * ) {}
+	void onReplaced( const Entry *, const Entry * ) {}
+	void onCounted( uint64_t, uint64_t ) {}
+};
+
+#if defined( MERGELISTS_HAS_AVX512_KERNEL )
+/**
+ * Merges entries into direct-indexed slots of winners and their timestamps 8 entries at a time.
+ * Keys of a vector are checked for duplicates with a conflict detection instruction.
+ * Duplicates are resolved in rounds: a round updates slots of the first remaining occurrences of every key,
+ * so slots of a key see its entries in the original order and earlier entries win ties as in the scalar loop.
+ * @param numWinnersAdded gets incremented by a number of slots that got their first winners.
+ * @param numWinnersReplaced gets incremented by a number of winners that got replaced.
+ * @return a pointer to the first entry that has not been merged.
+ * Merging stops before a vector of less than 8 entries or before a vector with keys that are out of the slots range.
+ */
+__attribute__(( target( "avx512f,avx512cd" ) ))
+const Entry *mergeIntoDenseSlotsAvx512( const Entry *begin, const Entry *end, int64_t base, size_t numSlots,
+										const Entry **slots, uint64_t *timestamps, size_t &numWinnersAdded, uint64_t &numWinnersReplaced );
+#endif
+
+/**
+ * Passes changes of winners to both observers, so neither of them misses changes while the other one is installed.
+ */
+template <typename FirstObserver, typename SecondObserver>
+struct ChangeObserverPair {
+	static constexpr bool kCountsOnly = FirstObserver::kCountsOnly && SecondObserver::kCountsOnly;
+
+	FirstObserver &first;
+	SecondObserver &second;
+
+	void onInserted( const Entry *entry ) {
+		first.onInserted( entry );
+		second.onInserted( entry );
+	}
+	void onReplaced( const Entry *oldEntry, const Entry *newEntry ) {
+		first.onReplaced( oldEntry, newEntry );
+		second.onReplaced( oldEntry, newEntry );
+	}
+	void onCounted( uint64_t numInserted, uint64_t numReplaced ) {
+		first.onCounted( numInserted, numReplaced );
+		second.onCounted( numInserted, numReplaced );
+	}
+};
+
+class MergeBuilder {
+public:
+	enum Engine {
+		/**
+		 * A generic hash table updated as entries are added.
+		 */
+		HashEngine,
+		/**
+		 * A direct-indexed array of winners that suits a dense range of keys.
+		 * It falls back to the hash table if the range gets too sparse.
+		 */
+		DenseEngine,
+		/**
+		 * A k-way merge of lists that are sorted (or get sorted) by keys. It suits presorted inputs.
+		 */
+		SortedEngine,
+		/**
+		 * A resolution of winners within radix partitions of keys that suits huge numbers of distinct keys.
+		 */
+		PartitionedEngine,
+		/**
+		 * A versioned table that allows reading consistent snapshots concurrently with merging.
+		 */
+		ConcurrentEngine
+	};
+
+	enum SortAlgorithm {
+		ComparisonSort,
+		RadixSort
+	};
+
+	/**
+	 * Ways of updating winners of the dense engine.
+	 */
+	enum DenseKernel {
+		/**
+		 * The vectorized kernel if the CPU supports it and the scalar loop otherwise.
+		 */
+		AutoDenseKernel,
+		ScalarDenseKernel,
+		Avx512DenseKernel
+	};
+
+	struct Config {
+		Engine engine { HashEngine };
+		SortAlgorithm sortAlgorithm { ComparisonSort };
+		/**
+		 * An expected number of distinct keys (if known).
+		 */
+		size_t expectedNumKeys { 0 };
+		/**
+		 * Whether the timestamp order of winners should be maintained as they get replaced.
+		 * It makes every build() call O(W) instead of O(W log W) for engines that resolve winners incrementally.
+		 */
+		bool maintainOrder { false };
+		/**
+		 * A pool for parallel building (if any).
+		 */
+		ThreadPool *threadPool { nullptr };
+		DenseKernel denseKernel { AutoDenseKernel };
+		/**
+		 * Counters that get the progress of sorting winners by build() (if any).
+		 */
+		ProgressCounters *progressCounters { nullptr };
+	};
+private:
+	Config config;
+
+	std::unordered_map<int, const Entry *> buckets;
+
+	std::vector<const Entry *> denseSlots;
+	/**
+	 * Timestamps of winners of dense slots. They are kept for the vectorized kernel that gathers them.
+	 */
+	std::vector<uint64_t> denseTimestamps;
+	int64_t denseBase { 0 };
+	size_t numDenseWinners { 0 };
+
+	std::vector<const std::vector<Entry> *> lists;
+
+	std::unique_ptr<VersionedWinnerTable> versionedWinners;
+
+	/**
+	 * Current winners ordered by timestamps (if the order is maintained).
+	 * Pointers are unique so they disambiguate equal timestamps.
+	 */
+	std::set<std::pair<uint64_t, const Entry *>> orderedWinners;
+
+	template <typename ChangeObserver>
+	void onWinnerAdded( const Entry *entry, ChangeObserver &observer ) {
+		observer.onInserted( entry );
+		if( config.maintainOrder ) {
+			orderedWinners.emplace( entry->timestamp, entry );
+		}
+	}
+
+	template <typename ChangeObserver>
+	void onWinnerReplaced( const Entry *oldEntry, const Entry *newEntry, ChangeObserver &observer ) {
+		observer.onReplaced( oldEntry, newEntry );
+		if( config.maintainOrder ) {
+			orderedWinners.erase( std::make_pair( oldEntry->timestamp, oldEntry ) );
+			orderedWinners.emplace( newEntry->timestamp, newEntry );
+		}
+	}
+
+	bool isOrderMaintained() const {
+		return config.maintainOrder && ( config.engine == HashEngine || config.engine == DenseEngine );
+	}
+
+	template <typename ChangeObserver>
+	void addToHash( const Entry *begin, const Entry *end, ChangeObserver &observer );
+	/**
+	 * @return a pointer to the first entry that has not been added if the engine should be switched to hashing.
+	 */
+	template <typename ChangeObserver>
+	const Entry *addToDense( const Entry *begin, const Entry *end, ChangeObserver &observer );
+	bool tryGrowingDense( int num );
+	void switchDenseToHash();
+	/**
+	 * Checks whether dense slots get updated by the vectorized kernel.
+	 * It's the case only if nothing needs individual changes of winners (counting them is fine).
+	 */
+	template <typename ChangeObserver>
+	bool isDenseVectorized() const {
+		return ChangeObserver::kCountsOnly && isDenseVectorizable();
+	}
+
+	void collectSortedWinners( std::vector<const Entry *> &result );
+	void collectPartitionedWinners( std::vector<const Entry *> &result );
+	void sortByTimestamp( std::vector<const Entry *> &result );
+public:
+	MergeBuilder() = default;
+	explicit MergeBuilder( const Config &config_ ): config( config_ ) {
+		if( config.engine == HashEngine && config.expectedNumKeys ) {
+			buckets.reserve( config.expectedNumKeys );
+		}
+		if( config.engine == ConcurrentEngine ) {
+			versionedWinners.reset( new VersionedWinnerTable );
+		}
+	}
+
+	/**
+	 * Forgets all entries and applies the config keeping allocated memory for reuse.
+	 */
+	void reset( const Config &config_ );
+
+	/**
+	 * Checks whether the CPU supports the vectorized dense kernel.
+	 */
+	static bool isAvx512Supported() {
+#if defined( MERGELISTS_HAS_AVX512_KERNEL )
+		static const bool isSupported = __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512cd" );
+		return isSupported;
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * Resolves the automatic choice of the dense kernel.
+	 */
+	static DenseKernel resolveDenseKernel( DenseKernel kernel ) {
+		if( kernel == AutoDenseKernel ) {
+			return isAvx512Supported() ? Avx512DenseKernel : ScalarDenseKernel;
+		}
+		return kernel;
+	}
+
+	/**
+	 * Checks whether the dense engine uses the vectorized kernel unless an observer needs individual changes.
+	 */
+	bool isDenseVectorizable() const {
+		return !config.maintainOrder && resolveDenseKernel( config.denseKernel ) == Avx512DenseKernel;
+	}
+
+	/**
+	 * Tries to merge the supplied entries.
+	 * @param entries a bunch of entries.
+	 * @note the supplied entries are referred by their addresses.
+	 * Entries are assumed to be valid and have a permanent address during the entire {@code MergeBuilder} object lifetime.
+	 * These entries are assumed to be owned by something else.
+	 */
+	void addEntries( const std::vector<Entry> &entries ) {
+		NullChangeObserver observer;
+		addEntries( entries, observer );
+	}
+
+	/**
+	 * Merges the supplied entries reporting every insertion and replacement of a winner to the observer.
+	 * @note changes are reported only by engines that resolve winners as entries are added (hash and dense ones).
+	 */
+	template <typename ChangeObserver>
+	void addEntries( const std::vector<Entry> &entries, ChangeObserver &observer );
+
+	/**
+	 * Checks whether the engine reports changes of winners as entries are added.
+	 */
+	static bool isObservable( Engine engine ) {
+		return engine == HashEngine || engine == DenseEngine;
+	}
+
+	/**
+	 * Creates a sorted by timestamp list of merged entries.
+	 * @return a sorted list of pointers to entries that are assumed to be valid and owned by something else.
+	 */
+	std::vector<const Entry *> build();
+
+	/**
+	 * Estimates a number of bytes held by tables of the builder.
+	 */
+	uint64_t memoryUsage() const;
+
+	/**
+	 * Gets the engine that is actually used (it may differ from the configured one after a fallback).
+	 */
+	Engine engine() const { return config.engine; }
+
+	/**
+	 * Gets a table that may be read concurrently with merging (if the concurrent engine is used).
+	 */
+	VersionedWinnerTable *concurrentlyReadableWinners() { return versionedWinners.get(); }
+};
+
+template <typename ChangeObserver>
+void MergeBuilder::addEntries( const std::vector<Entry> &entries, ChangeObserver &observer ) {
+	const Entry *begin = entries.data();
+	const Entry *const end = begin + entries.size();
+	switch( config.engine ) {
+		case HashEngine:
+			addToHash( begin, end, observer );
+			break;
+		case DenseEngine:
+			begin = addToDense( begin, end, observer );
+			if( begin != end ) {
+				switchDenseToHash();
+				addToHash( begin, end, observer );
+			}
+			break;
+		case ConcurrentEngine:
+			versionedWinners->apply( begin, end );
+			break;
+		default:
+			// Resolution is deferred to the build() call
+			lists.push_back( &entries );
+	}
+}
+
+template <typename ChangeObserver>
+void MergeBuilder::addToHash( const Entry *begin, const Entry *end, ChangeObserver &observer ) {
+	for( const Entry *entry = begin; entry != end; ++entry ) {
+		// Check whether there's an existing entry for the given `num`
+		auto it = buckets.find( entry->num );
+		// There's no such entry, perform an insertion
+		if( it == buckets.end() ) {
+			buckets.emplace( std::make_pair( entry->num, entry ) );
+			onWinnerAdded( entry, observer );
+			continue;
+		}
+		// Check whether the existing entry should be preserved
+		const Entry &existing = *( it->second );
+		if( !( existing < *entry ) ) {
+			continue;
+		}
+		// Overwrite the existing entry in-place.
+		// Note that this is totally correct as the hash code is the same
+		onWinnerReplaced( it->second, entry, observer );
+		it->second = entry;
+	}
+}
+
+template <typename ChangeObserver>
+const Entry *MergeBuilder::addToDense( const Entry *begin, const Entry *end, ChangeObserver &observer ) {
+#if defined( MERGELISTS_HAS_AVX512_KERNEL )
+	const bool isVectorized = isDenseVectorized<ChangeObserver>();
+#endif
+	for( const Entry *entry = begin; entry != end; ++entry ) {
+#if defined( MERGELISTS_HAS_AVX512_KERNEL )
+		// The kernel stops at vectors it can not merge, and such a vector proceeds entry by entry
+		if( isVectorized ) {
+			const size_t oldNumWinners = numDenseWinners;
+			uint64_t numReplaced = 0;
+			entry = ::mergeIntoDenseSlotsAvx512( entry, end, denseBase, denseSlots.size(), denseSlots.data(),
+												 denseTimestamps.data(), numDenseWinners, numReplaced );
+			observer.onCounted( numDenseWinners - oldNumWinners, numReplaced );
+			if( entry == end ) {
+				break;
+			}
+		}
+#endif
+		auto index = (uint64_t)( (int64_t)entry->num - denseBase );
+		if( index >= denseSlots.size() ) {
+			if( !tryGrowingDense( entry->num ) ) {
+				return entry;
+			}
+			index = (uint64_t)( (int64_t)entry->num - denseBase );
+		}
+		const Entry *&slot = denseSlots[index];
+		if( !slot ) {
+			slot = entry;
+			denseTimestamps[index] = entry->timestamp;
+			numDenseWinners++;
+			onWinnerAdded( entry, observer );
+		} else if( *slot < *entry ) {
+			onWinnerReplaced( slot, entry, observer );
+			slot = entry;
+			denseTimestamps[index] = entry->timestamp;
+		}
+	}
+	return end;
+}
+
+#endif
@@ -0,0 +1,368 @@
+#include "Options.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+/**
+ * Parses a decimal number that must take the whole value.
+ * @return false if the value is not a number (including signed ones and ones with whitespace) or it exceeds the maximum.
+ */
+static bool tryParsingNumber( const char *value, uint64_t maxValue, uint64_t &result ) {
+	if( *value < '0' || *value > '9' ) {
+		return false;
+	}
+	char *end;
+	errno = 0;
+	const unsigned long long parsed = std::strtoull( value, &end, 10 );
+	if( *end || errno || parsed > maxValue ) {
+		return false;
+	}
+	result = parsed;
+	return true;
+}
+
+bool tryParsingOptions( int argc, char **argv, Options &options, std::string &error ) {
+	int i = 1;
+	// Parses a value of the current option advancing to it
+	auto tryParsingValue = [&]( uint64_t maxValue, uint64_t &result ) {
+		const char *option = argv[i++];
+		if( !::tryParsingNumber( argv[i], maxValue, result ) ) {
+			error = std::string( "Malformed value `" ) + argv[i] + "` of `" + option + "`";
+			return false;
+		}
+		return true;
+	};
+	for(; i < argc && !std::strncmp( argv[i], "--", 2 ); ++i ) {
+		if( !std::strcmp( argv[i], "--skip-invalid" ) ) {
+			options.skipInvalid = true;
+		} else if( !std::strcmp( argv[i], "--intern-titles" ) ) {
+			options.internTitles = true;
+		} else if( !std::strcmp( argv[i], "--compress-titles" ) ) {
+			options.compressTitles = true;
+		} else if( !std::strcmp( argv[i], "--stats" ) ) {
+			options.printStats = true;
+		} else if( !std::strcmp( argv[i], "--combine" ) ) {
+			options.combine = true;
+		} else if( !std::strcmp( argv[i], "--ordered-index" ) ) {
+			options.maintainOrder = true;
+		} else if( !std::strcmp( argv[i], "--engine" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			options.engineSpecified = true;
+			options.autoEngine = false;
+			if( !std::strcmp( value, "auto" ) ) {
+				options.autoEngine = true;
+			} else if( !std::strcmp( value, "hash" ) ) {
+				options.engine = MergeBuilder::HashEngine;
+			} else if( !std::strcmp( value, "dense" ) ) {
+				options.engine = MergeBuilder::DenseEngine;
+			} else if( !std::strcmp( value, "sorted" ) ) {
+				options.engine = MergeBuilder::SortedEngine;
+			} else if( !std::strcmp( value, "partitioned" ) ) {
+				options.engine = MergeBuilder::PartitionedEngine;
+			} else if( !std::strcmp( value, "concurrent" ) ) {
+				options.engine = MergeBuilder::ConcurrentEngine;
+			} else {
+				error = std::string( "Unknown engine `" ) + value + "`";
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--sort" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			if( !std::strcmp( value, "comparison" ) ) {
+				options.sortAlgorithm = MergeBuilder::ComparisonSort;
+			} else if( !std::strcmp( value, "radix" ) ) {
+				options.sortAlgorithm = MergeBuilder::RadixSort;
+			} else {
+				error = std::string( "Unknown sort algorithm `" ) + value + "`";
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--threads" ) && i + 1 < argc ) {
+			uint64_t value;
+			if( !tryParsingValue( INT_MAX, value ) ) {
+				return false;
+			}
+			if( !value ) {
+				error = "The number of threads must be positive";
+				return false;
+			}
+			options.numThreads = (unsigned)value;
+		} else if( !std::strcmp( argv[i], "--concurrent-readers" ) && i + 1 < argc ) {
+			uint64_t value;
+			if( !tryParsingValue( INT_MAX, value ) ) {
+				return false;
+			}
+			if( !value ) {
+				error = "The number of concurrent readers must be positive";
+				return false;
+			}
+			options.numConcurrentReaders = (unsigned)value;
+		} else if( !std::strcmp( argv[i], "--state" ) && i + 1 < argc ) {
+			options.stateDirectory = argv[++i];
+		} else if( !std::strcmp( argv[i], "--durability" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			if( !std::strcmp( value, "none" ) ) {
+				options.durability = PersistentState::NoSync;
+			} else if( !std::strcmp( value, "fsync" ) ) {
+				options.durability = PersistentState::GroupSync;
+			} else {
+				error = std::string( "Unknown durability `" ) + value + "`";
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--checkpoint-bytes" ) && i + 1 < argc ) {
+			if( !tryParsingValue( UINT64_MAX, options.checkpointBytes ) ) {
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--compact" ) ) {
+			options.compact = true;
+		} else if( !std::strcmp( argv[i], "--tombstone-retention" ) && i + 1 < argc ) {
+			if( !tryParsingValue( UINT64_MAX, options.compactionPolicy.tombstoneRetention ) ) {
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--ttl" ) && i + 1 < argc ) {
+			if( !tryParsingValue( UINT64_MAX, options.compactionPolicy.ttl ) ) {
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--as-of" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			for(;; ) {
+				char *end;
+				errno = 0;
+				const uint64_t cutoff = std::strtoull( value, &end, 10 );
+				if( *value < '0' || *value > '9' || errno || ( *end && *end != ',' ) ) {
+					error = std::string( "Malformed as-of cutoffs `" ) + argv[i] + "`";
+					return false;
+				}
+				options.asOfCutoffs.push_back( cutoff );
+				if( !*end ) {
+					break;
+				}
+				value = end + 1;
+			}
+			std::sort( options.asOfCutoffs.begin(), options.asOfCutoffs.end() );
+			options.asOfCutoffs.erase( std::unique( options.asOfCutoffs.begin(), options.asOfCutoffs.end() ), options.asOfCutoffs.end() );
+		} else if( !std::strcmp( argv[i], "--as-of-prefix" ) && i + 1 < argc ) {
+			options.asOfPrefix = argv[++i];
+		} else if( !std::strcmp( argv[i], "--input-mode" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			if( !std::strcmp( value, "cached" ) ) {
+				options.inputMode = CachedInput;
+			} else if( !std::strcmp( value, "direct" ) ) {
+				options.inputMode = DirectInput;
+			} else if( !std::strcmp( value, "drop-cache" ) ) {
+				options.inputMode = DroppingInput;
+			} else {
+				error = std::string( "Unknown input mode `" ) + value + "`";
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--prefetch" ) && i + 1 < argc ) {
+			uint64_t value;
+			if( !tryParsingValue( INT_MAX, value ) ) {
+				return false;
+			}
+			options.prefetchDepth = (unsigned)value;
+		} else if( !std::strcmp( argv[i], "--compress" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			if( !std::strcmp( value, "zstd" ) ) {
+				options.outputCodec = CompressedEntriesWriter::ZstdCodec;
+			} else if( !std::strcmp( value, "gzip" ) ) {
+				options.outputCodec = CompressedEntriesWriter::GzipCodec;
+			} else {
+				error = std::string( "Unknown codec `" ) + value + "`";
+				return false;
+			}
+			if( !CompressedEntriesWriter::isSupported( options.outputCodec ) ) {
+				error = std::string( "The codec `" ) + value + "` is not supported by this build";
+				return false;
+			}
+			options.compressOutput = true;
+		} else if( !std::strcmp( argv[i], "--dense-kernel" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			if( !std::strcmp( value, "auto" ) ) {
+				options.denseKernel = MergeBuilder::AutoDenseKernel;
+			} else if( !std::strcmp( value, "scalar" ) ) {
+				options.denseKernel = MergeBuilder::ScalarDenseKernel;
+			} else if( !std::strcmp( value, "avx512" ) ) {
+				if( !MergeBuilder::isAvx512Supported() ) {
+					error = "The AVX-512 dense kernel is not supported by this CPU or build";
+					return false;
+				}
+				options.denseKernel = MergeBuilder::Avx512DenseKernel;
+			} else {
+				error = std::string( "Unknown dense kernel `" ) + value + "`";
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--memory-budget" ) && i + 1 < argc ) {
+			if( !tryParsingValue( UINT64_MAX, options.memoryBudget ) ) {
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--progress" ) ) {
+			options.describeProgressOnSignal = true;
+		} else if( !std::strcmp( argv[i], "--stats-socket" ) && i + 1 < argc ) {
+			options.statsSocketPath = argv[++i];
+		} else if( !std::strcmp( argv[i], "--index" ) ) {
+			options.writesPointIndex = true;
+		} else if( !std::strcmp( argv[i], "--lookup" ) && i + 1 < argc ) {
+			options.lookupFilename = argv[++i];
+		} else if( !std::strcmp( argv[i], "--timestamp-index" ) && i + 1 < argc ) {
+			if( !tryParsingValue( UINT64_MAX, options.timestampIndexStride ) ) {
+				return false;
+			}
+			if( !options.timestampIndexStride ) {
+				error = "A timestamp index must sample at least every entry";
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--read-range" ) && i + 3 < argc ) {
+			options.rangeFilename = argv[++i];
+			uint64_t *const bounds[] = { &options.rangeFrom, &options.rangeTo };
+			for( uint64_t *bound: bounds ) {
+				const char *value = argv[++i];
+				if( !::tryParsingNumber( value, UINT64_MAX, *bound ) ) {
+					error = std::string( "`" ) + value + "` is not a timestamp";
+					return false;
+				}
+			}
+		} else if( !std::strcmp( argv[i], "--profile-input" ) && i + 1 < argc ) {
+			options.profileFilename = argv[++i];
+		} else if( !std::strcmp( argv[i], "--generate" ) && i + 1 < argc ) {
+			options.generatorProfileFilename = argv[++i];
+		} else if( !std::strcmp( argv[i], "--generate-prefix" ) && i + 1 < argc ) {
+			options.generatorPrefix = argv[++i];
+		} else if( !std::strcmp( argv[i], "--seed" ) && i + 1 < argc ) {
+			if( !tryParsingValue( UINT64_MAX, options.generatorSeed ) ) {
+				return false;
+			}
+		} else if( !std::strcmp( argv[i], "--jobs" ) && i + 1 < argc ) {
+			options.jobsFilename = argv[++i];
+		} else if( !std::strcmp( argv[i], "--output" ) && i + 1 < argc ) {
+			options.outputFilename = argv[++i];
+		} else if( !std::strcmp( argv[i], "--cdc" ) && i + 1 < argc ) {
+			options.changeEventsFilename = argv[++i];
+		} else if( !std::strcmp( argv[i], "--cdc-format" ) && i + 1 < argc ) {
+			const char *value = argv[++i];
+			if( !std::strcmp( value, "ndjson" ) ) {
+				options.changeEventsFormat = ChangeEventStream::NdjsonFormat;
+			} else if( !std::strcmp( value, "binary" ) ) {
+				options.changeEventsFormat = ChangeEventStream::BinaryFormat;
+			} else {
+				error = std::string( "Unknown change event format `" ) + value + "`";
+				return false;
+			}
+		} else {
+			error = std::string( "Unknown option `" ) + argv[i] + "`";
+			return false;
+		}
+	}
+	options.filenames.assign( argv + i, argv + argc );
+	// Neither lookups, range reads, profiling nor generation merge anything
+	if( options.rangeFilename ) {
+		if( !options.filenames.empty() ) {
+			error = "A range read does not accept inputs";
+			return false;
+		}
+		return true;
+	}
+	if( options.lookupFilename ) {
+		if( options.filenames.empty() ) {
+			error = "At least one key must be specified";
+			return false;
+		}
+		return true;
+	}
+	// Jobs reject indexes along with other options that do not apply to them
+	if( ( options.writesPointIndex || options.timestampIndexStride ) && !options.jobsFilename &&
+		( !options.outputFilename || options.compressOutput ) ) {
+		error = "An index requires an uncompressed output file";
+		return false;
+	}
+	if( options.generatorProfileFilename ) {
+		if( !options.filenames.empty() || options.profileFilename || options.jobsFilename ) {
+			error = "Generation of inputs can not be combined with inputs, profiling or jobs";
+			return false;
+		}
+		return true;
+	}
+	if( options.profileFilename ) {
+		if( options.filenames.empty() || options.jobsFilename ) {
+			error = "Profiling requires inputs and can not be combined with jobs";
+			return false;
+		}
+		return true;
+	}
+	// Jobs specify their own inputs and outputs
+	if( options.jobsFilename ) {
+		if( !options.filenames.empty() || options.outputFilename ) {
+			error = "Inputs and outputs must be specified by jobs";
+			return false;
+		}
+		// Jobs only read, merge and write their lists one by one
+		const std::pair<bool, const char *> inapplicableOptions[] = {
+			{ options.stateDirectory != nullptr, "--state" },
+			{ !options.asOfCutoffs.empty(), "--as-of" },
+			{ options.changeEventsFilename != nullptr, "--cdc" },
+			{ options.numConcurrentReaders != 0, "--concurrent-readers" },
+			{ options.writesPointIndex, "--index" },
+			{ options.timestampIndexStride != 0, "--timestamp-index" },
+			{ options.prefetchDepth != 0, "--prefetch" },
+			{ options.memoryBudget != 0, "--memory-budget" },
+			{ options.describeProgressOnSignal, "--progress" },
+			{ options.statsSocketPath != nullptr, "--stats-socket" },
+		};
+		for( const auto &option: inapplicableOptions ) {
+			if( option.first ) {
+				error = std::string( "`--jobs` can not be combined with `" ) + option.second + "`";
+				return false;
+			}
+		}
+		return true;
+	}
+	// A persistent state acts as the first list
+	if( options.stateDirectory ) {
+		if( options.filenames.empty() ) {
+			error = "At least one file must be specified";
+			return false;
+		}
+	} else if( options.filenames.size() < 2 ) {
+		error = "At least two files must be specified";
+		return false;
+	}
+	if( options.compact && !options.stateDirectory ) {
+		error = "Compaction requires a persistent state";
+		return false;
+	}
+	// Both keep only the latest entries of keys, which loses the history
+	if( !options.asOfCutoffs.empty() && ( options.stateDirectory || options.combine ) ) {
+		error = "As-of snapshots can not be combined with a persistent state or the combiner";
+		return false;
+	}
+	// Readers need snapshots that only the concurrent engine provides
+	if( options.numConcurrentReaders ) {
+		if( options.engineSpecified && !options.autoEngine && options.engine != MergeBuilder::ConcurrentEngine ) {
+			error = "Concurrent readers require the concurrent engine";
+			return false;
+		}
+		if( options.changeEventsFilename ) {
+			error = "Change events can not be combined with concurrent readers";
+			return false;
+		}
+		options.engine = MergeBuilder::ConcurrentEngine;
+	}
+	if( options.changeEventsFilename ) {
+		if( !options.asOfCutoffs.empty() ) {
+			error = "Change events can not be combined with as-of snapshots";
+			return false;
+		}
+		// The combiner drops entries that lose within their list, so replacements by them would never be observed
+		if( options.combine ) {
+			error = "Change events can not be combined with the combiner";
+			return false;
+		}
+		if( !options.autoEngine && !MergeBuilder::isObservable( options.engine ) ) {
+			error = "Change events require the hash or the dense engine";
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,131 @@
+#ifndef MERGELISTS_OPTIONS_H
+#define MERGELISTS_OPTIONS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ChangeEventStream.h"
+#include "Compaction.h"
+#include "CompressedEntriesWriter.h"
+#include "InputReading.h"
+#include "MergeBuilder.h"
+#include "PersistentState.h"
+
+struct Options {
+	bool skipInvalid { false };
+	bool internTitles { false };
+	bool compressTitles { false };
+	bool printStats { false };
+	bool combine { false };
+	bool maintainOrder { false };
+	bool autoEngine { false };
+	/**
+	 * Whether an engine has been given explicitly (including the auto one).
+	 */
+	bool engineSpecified { false };
+	MergeBuilder::Engine engine { MergeBuilder::HashEngine };
+	MergeBuilder::SortAlgorithm sortAlgorithm { MergeBuilder::ComparisonSort };
+	MergeBuilder::DenseKernel denseKernel { MergeBuilder::AutoDenseKernel };
+	/**
+	 * A number of threads. Zero means it's not specified.
+	 */
+	unsigned numThreads { 0 };
+	/**
+	 * A number of threads that read snapshots of winners while merging.
+	 */
+	unsigned numConcurrentReaders { 0 };
+	/**
+	 * A directory of a persistent state (if any).
+	 */
+	const char *stateDirectory { nullptr };
+	PersistentState::Durability durability { PersistentState::GroupSync };
+	/**
+	 * A size of the write-ahead log that triggers a checkpoint.
+	 */
+	uint64_t checkpointBytes { 64u << 20 };
+	/**
+	 * Whether the persistent state should be compacted regardless of the size of the write-ahead log.
+	 */
+	bool compact { false };
+	CompactionPolicy compactionPolicy;
+	/**
+	 * Sorted distinct cutoffs of as-of snapshots (if any).
+	 */
+	std::vector<uint64_t> asOfCutoffs;
+	/**
+	 * A prefix of names of as-of snapshot files that are followed by cutoffs.
+	 */
+	const char *asOfPrefix { "as-of-" };
+	/**
+	 * A file of change events (if any).
+	 */
+	const char *changeEventsFilename { nullptr };
+	ChangeEventStream::Format changeEventsFormat { ChangeEventStream::NdjsonFormat };
+	/**
+	 * A file to write the output to instead of the standard output (if any).
+	 */
+	const char *outputFilename { nullptr };
+	/**
+	 * Whether the output is compressed.
+	 */
+	bool compressOutput { false };
+	CompressedEntriesWriter::Codec outputCodec { CompressedEntriesWriter::ZstdCodec };
+	/**
+	 * A memory budget in bytes. Zero means it's unlimited.
+	 */
+	uint64_t memoryBudget { 0 };
+	/**
+	 * A file of independent merge jobs (if any).
+	 */
+	const char *jobsFilename { nullptr };
+	InputMode inputMode { CachedInput };
+	/**
+	 * A number of upcoming input files that are read ahead.
+	 */
+	unsigned prefetchDepth { 0 };
+	/**
+	 * Whether the progress is described on SIGUSR1.
+	 */
+	bool describeProgressOnSignal { false };
+	/**
+	 * A path of a Unix socket that describes the progress to every client (if any).
+	 */
+	const char *statsSocketPath { nullptr };
+	/**
+	 * Whether a point lookup index is written alongside the output file.
+	 */
+	bool writesPointIndex { false };
+	/**
+	 * An output file to look keys up in instead of merging (if any). Keys are given instead of inputs.
+	 */
+	const char *lookupFilename { nullptr };
+	/**
+	 * A number of entries per a sample of a timestamp index written alongside the output file (if any).
+	 */
+	uint64_t timestampIndexStride { 0 };
+	/**
+	 * An output file to read entries of a range of timestamps from instead of merging (if any).
+	 */
+	const char *rangeFilename { nullptr };
+	uint64_t rangeFrom { 0 };
+	uint64_t rangeTo { 0 };
+	/**
+	 * A file to write an anonymized profile of inputs to instead of merging them (if any).
+	 */
+	const char *profileFilename { nullptr };
+	/**
+	 * A profile to generate look-alike inputs from (if any).
+	 */
+	const char *generatorProfileFilename { nullptr };
+	/**
+	 * A prefix of names of generated files that are followed by their indices.
+	 */
+	const char *generatorPrefix { "generated-" };
+	uint64_t generatorSeed { 0 };
+	std::vector<const char *> filenames;
+};
+
+bool tryParsingOptions( int argc, char **argv, Options &options, std::string &error );
+
+#endif
@@ -0,0 +1,174 @@
+#include "OutputIndexes.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::tryMapping( const char *filename, std::string &error ) {
+	const int fd = ::open( filename, O_RDONLY );
+	if( fd < 0 ) {
+		error = std::string( "Failed to open `" ) + filename + "`: " + std::strerror( errno );
+		return false;
+	}
+	struct stat fileStat;
+	if( ::fstat( fd, &fileStat ) != 0 ) {
+		error = std::string( "Failed to stat `" ) + filename + "`: " + std::strerror( errno );
+		::close( fd );
+		return false;
+	}
+	// An empty file can not be mapped, but there's nothing to read in it anyway
+	mappingSize = (size_t)fileStat.st_size;
+	if( mappingSize ) {
+		mapping = ::mmap( nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0 );
+	}
+	::close( fd );
+	if( mappingSize && mapping == MAP_FAILED ) {
+		error = std::string( "Failed to map `" ) + filename + "`: " + std::strerror( errno );
+		mappingSize = 0;
+		return false;
+	}
+	if( mappingSize ) {
+		::madvise( mapping, mappingSize, MADV_RANDOM );
+	}
+	return true;
+}
+
+constexpr char PointLookupIndex::kMagic[8];
+
+bool PointLookupIndex::tryWriting( const std::string &filename, const std::vector<const Entry *> &entries,
+								   const std::vector<uint64_t> &offsets, std::string &error ) {
+	const size_t numEntries = entries.size();
+	std::vector<std::pair<int, Location>> sorted( numEntries );
+	for( size_t i = 0; i < numEntries; ++i ) {
+		// Formatted entries are separated by a comma and a line feed
+		sorted[i] = std::make_pair( entries[i]->num, Location { offsets[i], offsets[i + 1] - 2 - offsets[i] } );
+	}
+	std::sort( sorted.begin(), sorted.end(), []( const std::pair<int, Location> &lhs, const std::pair<int, Location> &rhs ) {
+		return lhs.first < rhs.first;
+	});
+
+	// An in-order traversal of the implicit tree visits nodes in ascending order of keys
+	std::vector<int32_t> treeKeys( keysSize( numEntries ) / sizeof( int32_t ), 0 );
+	std::vector<Location> treeLocations( numEntries );
+	size_t nextSorted = 0;
+	std::function<void( size_t )> fill = [&]( size_t node ) {
+		if( node > numEntries ) {
+			return;
+		}
+		fill( 2 * node );
+		treeKeys[node - 1] = sorted[nextSorted].first;
+		treeLocations[node - 1] = sorted[nextSorted].second;
+		nextSorted++;
+		fill( 2 * node + 1 );
+	};
+	fill( 1 );
+
+	std::ofstream stream( filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+	if( !stream.is_open() ) {
+		error = "Failed to open a file stream of `" + filename + "`";
+		return false;
+	}
+	Header header;
+	std::memcpy( header.magic, kMagic, sizeof( kMagic ) );
+	header.numEntries = numEntries;
+	stream.write( (const char *)&header, sizeof( header ) );
+	stream.write( (const char *)treeKeys.data(), (std::streamsize)( treeKeys.size() * sizeof( int32_t ) ) );
+	stream.write( (const char *)treeLocations.data(), (std::streamsize)( treeLocations.size() * sizeof( Location ) ) );
+	if( !stream.flush() ) {
+		error = "Failed to write `" + filename + "`";
+		return false;
+	}
+	return true;
+}
+
+bool PointLookupIndex::tryOpening( const char *filename, std::string &error ) {
+	if( !file.tryMapping( filename, error ) ) {
+		return false;
+	}
+	Header header;
+	if( file.size() < sizeof( header ) || std::memcmp( file.data(), kMagic, sizeof( kMagic ) ) ) {
+		error = std::string( "`" ) + filename + "` is not an index";
+		return false;
+	}
+	std::memcpy( &header, file.data(), sizeof( header ) );
+	if( file.size() != sizeof( header ) + keysSize( header.numEntries ) + header.numEntries * sizeof( Location ) ) {
+		error = std::string( "The index `" ) + filename + "` is truncated";
+		return false;
+	}
+	numKeys = header.numEntries;
+	keys = (const int32_t *)( file.data() + sizeof( header ) );
+	locations = (const Location *)( file.data() + sizeof( header ) + keysSize( numKeys ) );
+	return true;
+}
+
+bool PointLookupIndex::find( int num, Location &location ) const {
+	// Nodes are numbered from 1, so children of a node k are 2k and 2k + 1
+	uint64_t node = 1;
+	while( node <= numKeys ) {
+		// Descendants four levels below share a cache line
+		if( 16 * node <= numKeys ) {
+			__builtin_prefetch( keys + 16 * node - 1 );
+		}
+		node = 2 * node + ( keys[node - 1] < num );
+	}
+	// Drop the trailing right turns and the final left one to get to the lower bound
+	node >>= __builtin_ffsll( (long long)~node );
+	if( !node || keys[node - 1] != num ) {
+		return false;
+	}
+	location = locations[node - 1];
+	return true;
+}
+
+constexpr char SparseTimestampIndex::kMagic[8];
+
+bool SparseTimestampIndex::tryWriting( const std::string &filename, const std::vector<const Entry *> &entries,
+									   const std::vector<uint64_t> &offsets, uint64_t stride, std::string &error ) {
+	std::vector<Sample> samples;
+	samples.reserve( ( entries.size() + stride - 1 ) / stride );
+	for( size_t i = 0; i < entries.size(); i += stride ) {
+		samples.push_back( Sample { entries[i]->timestamp, offsets[i] } );
+	}
+
+	std::ofstream stream( filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+	if( !stream.is_open() ) {
+		error = "Failed to open a file stream of `" + filename + "`";
+		return false;
+	}
+	Header header;
+	std::memcpy( header.magic, kMagic, sizeof( kMagic ) );
+	header.numEntries = entries.size();
+	header.stride = stride;
+	header.entriesEnd = entries.empty() ? 0 : offsets[entries.size()] - 2;
+	stream.write( (const char *)&header, sizeof( header ) );
+	stream.write( (const char *)samples.data(), (std::streamsize)( samples.size() * sizeof( Sample ) ) );
+	if( !stream.flush() ) {
+		error = "Failed to write `" + filename + "`";
+		return false;
+	}
+	return true;
+}
+
+bool SparseTimestampIndex::tryOpening( const char *filename, std::string &error ) {
+	if( !file.tryMapping( filename, error ) ) {
+		return false;
+	}
+	if( file.size() < sizeof( header ) || std::memcmp( file.data(), kMagic, sizeof( kMagic ) ) ) {
+		error = std::string( "`" ) + filename + "` is not a timestamp index";
+		return false;
+	}
+	std::memcpy( &header, file.data(), sizeof( header ) );
+	numSamples = (size_t)( header.stride ? ( header.numEntries + header.stride - 1 ) / header.stride : 0 );
+	if( file.size() != sizeof( header ) + numSamples * sizeof( Sample ) ) {
+		error = std::string( "The timestamp index `" ) + filename + "` is truncated";
+		return false;
+	}
+	samples = (const Sample *)( file.data() + sizeof( header ) );
+	return true;
+}
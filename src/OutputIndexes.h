@@ -0,0 +1,150 @@
+#ifndef MERGELISTS_OUTPUT_INDEXES_H
+#define MERGELISTS_OUTPUT_INDEXES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include "Entry.h"
+
+/**
+ * A read-only memory mapping of a whole file.
+ */
+class MappedFile {
+	void *mapping { MAP_FAILED };
+	size_t mappingSize { 0 };
+public:
+	MappedFile() = default;
+	~MappedFile() {
+		if( mapping != MAP_FAILED ) {
+			::munmap( mapping, mappingSize );
+		}
+	}
+
+	MappedFile( const MappedFile & ) = delete;
+	MappedFile &operator=( const MappedFile & ) = delete;
+
+	/**
+	 * Maps the file advising the kernel of random accesses, so nothing but touched pages gets read.
+	 */
+	bool tryMapping( const char *filename, std::string &error );
+
+	const char *data() const { return (const char *)mapping; }
+	size_t size() const { return mappingSize; }
+};
+
+/**
+ * A sidecar index of an output file that maps keys to byte ranges of their formatted objects.
+ * It consists of a header, keys in the Eytzinger layout (a binary search tree in breadth-first order)
+ * padded to 8 bytes and locations of objects in the same order.
+ * A lookup descends the tree prefetching a few levels ahead and reads nothing of the output but the object.
+ */
+class PointLookupIndex {
+public:
+	struct Location {
+		uint64_t offset;
+		uint64_t length;
+	};
+private:
+	static constexpr char kMagic[8] = { 'M', 'L', 'I', 'D', 'X', '0', '0', '1' };
+
+	struct Header {
+		char magic[8];
+		uint64_t numEntries;
+	};
+
+	MappedFile file;
+	const int32_t *keys { nullptr };
+	const Location *locations { nullptr };
+	uint64_t numKeys { 0 };
+
+	static size_t keysSize( uint64_t numEntries ) {
+		return ( numEntries * sizeof( int32_t ) + 7 ) & ~(size_t)7;
+	}
+public:
+	/**
+	 * Writes an index of the output that has been written by a {@code EntriesFileWriter}.
+	 * @param offsets offsets of formatted entries followed by an offset of an entry that would follow the last one.
+	 */
+	static bool tryWriting( const std::string &filename, const std::vector<const Entry *> &entries,
+							const std::vector<uint64_t> &offsets, std::string &error );
+
+	bool tryOpening( const char *filename, std::string &error );
+
+	bool find( int num, Location &location ) const;
+
+	uint64_t size() const { return numKeys; }
+};
+
+/**
+ * A sparse index of an output file that is sorted by timestamps.
+ * It samples a timestamp and an offset of every K-th formatted entry, so a range of timestamps is found
+ * by a binary search over samples and only blocks of K entries at boundaries of the range need to be scanned.
+ */
+class SparseTimestampIndex {
+public:
+	struct Sample {
+		uint64_t timestamp;
+		uint64_t offset;
+	};
+private:
+	static constexpr char kMagic[8] = { 'M', 'L', 'T', 'S', 'I', '0', '0', '1' };
+
+	struct Header {
+		char magic[8];
+		uint64_t numEntries;
+		uint64_t stride;
+		/**
+		 * An offset of the end of the last formatted entry.
+		 */
+		uint64_t entriesEnd;
+	};
+
+	MappedFile file;
+	Header header;
+	const Sample *samples { nullptr };
+	size_t numSamples { 0 };
+public:
+	/**
+	 * Writes an index of the output that has been written by a {@code EntriesFileWriter}.
+	 * @param offsets offsets of formatted entries followed by an offset of an entry that would follow the last one.
+	 * @param stride a number of entries per a sample.
+	 */
+	static bool tryWriting( const std::string &filename, const std::vector<const Entry *> &entries,
+							const std::vector<uint64_t> &offsets, uint64_t stride, std::string &error );
+
+	bool tryOpening( const char *filename, std::string &error );
+
+	size_t size() const { return numSamples; }
+	const Sample &sample( size_t i ) const { return samples[i]; }
+	/**
+	 * Gets an offset of the end of a block of entries that starts at the given sample (without a trailing separator).
+	 */
+	uint64_t blockEnd( size_t i ) const {
+		return i + 1 < numSamples ? samples[i + 1].offset - 2 : header.entriesEnd;
+	}
+
+	/**
+	 * Finds the first sample with a timestamp that is not less than the given one.
+	 */
+	size_t lowerBound( uint64_t timestamp ) const {
+		return (size_t)( std::lower_bound( samples, samples + numSamples, timestamp, []( const Sample &sample, uint64_t value ) {
+			return sample.timestamp < value;
+		}) - samples );
+	}
+
+	/**
+	 * Finds the first sample with a timestamp that is greater than the given one.
+	 */
+	size_t upperBound( uint64_t timestamp ) const {
+		return (size_t)( std::upper_bound( samples, samples + numSamples, timestamp, []( uint64_t value, const Sample &sample ) {
+			return value < sample.timestamp;
+		}) - samples );
+	}
+};
+
+#endif
@@ -0,0 +1,359 @@
+#include "PersistentState.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "InputReading.h"
+
+constexpr char PersistentState::kSnapshotMagic[8];
+
+std::string PersistentState::makeCommitRecord( uint64_t sequence ) {
+	BatchHeader header;
+	header.magic = kCommitMagic;
+	header.numEntries = 0;
+	header.sequence = sequence;
+	header.payloadSize = 0;
+	header.checksum = checksum( nullptr, 0 );
+	return std::string( (const char *)&header, sizeof( header ) );
+}
+
+void PersistentState::encodeEntry( const Entry &entry, const TitlePool &titlePool, std::string &title, std::string &output ) {
+	const int32_t num = entry.num;
+	const uint8_t isDeleted = entry.created ? 0 : 1;
+	title.clear();
+	titlePool.decode( titlePool.get( entry.titleId ), title );
+	const auto titleLength = (uint32_t)title.size();
+	output.append( (const char *)&num, sizeof( num ) );
+	output.append( (const char *)&isDeleted, sizeof( isDeleted ) );
+	output.append( (const char *)&entry.timestamp, sizeof( entry.timestamp ) );
+	output.append( (const char *)&titleLength, sizeof( titleLength ) );
+	output.append( title );
+}
+
+const char *PersistentState::tryDecodeEntry( const char *p, const char *end, TitlePool &titlePool, Entry &entry, std::string &error ) {
+	int32_t num;
+	uint8_t isDeleted;
+	uint32_t titleLength;
+	if( (size_t)( end - p ) < sizeof( num ) + sizeof( isDeleted ) + sizeof( entry.timestamp ) + sizeof( titleLength ) ) {
+		return nullptr;
+	}
+	std::memcpy( &num, p, sizeof( num ) );
+	p += sizeof( num );
+	std::memcpy( &isDeleted, p, sizeof( isDeleted ) );
+	p += sizeof( isDeleted );
+	std::memcpy( &entry.timestamp, p, sizeof( entry.timestamp ) );
+	p += sizeof( entry.timestamp );
+	std::memcpy( &titleLength, p, sizeof( titleLength ) );
+	p += sizeof( titleLength );
+	if( (size_t)( end - p ) < titleLength ) {
+		return nullptr;
+	}
+	entry.num = num;
+	entry.created = isDeleted ? 0 : entry.timestamp;
+	entry.deleted = isDeleted ? entry.timestamp : 0;
+	if( !titlePool.tryAdding( p, titleLength, entry.titleId ) ) {
+		error = "The title pool is full";
+		return nullptr;
+	}
+	return p + titleLength;
+}
+
+bool PersistentState::tryOpening( const std::string &directory_, Durability durability_, TitlePool &titlePool,
+								  std::vector<Entry> &snapshotEntries, std::vector<std::vector<Entry>> &replayedBatches,
+								  std::string &error ) {
+	directory = directory_;
+	durability = durability_;
+	if( ::mkdir( directory.c_str(), 0755 ) != 0 && errno != EEXIST ) {
+		error = "Failed to create the state directory `" + directory + "`: " + std::strerror( errno );
+		return false;
+	}
+	if( !tryLoadingSnapshot( titlePool, snapshotEntries, error ) ) {
+		return false;
+	}
+	return tryReplayingWal( titlePool, replayedBatches, error );
+}
+
+bool PersistentState::tryLoadingSnapshot( TitlePool &titlePool, std::vector<Entry> &entries, std::string &error ) {
+	const int fd = ::open( snapshotPath().c_str(), O_RDONLY );
+	if( fd < 0 ) {
+		if( errno == ENOENT ) {
+			return true;
+		}
+		error = "Failed to open the snapshot: " + std::string( std::strerror( errno ) );
+		return false;
+	}
+	struct stat fileStat;
+	if( ::fstat( fd, &fileStat ) != 0 || (size_t)fileStat.st_size < sizeof( SnapshotHeader ) ) {
+		::close( fd );
+		error = "The snapshot is truncated";
+		return false;
+	}
+	const auto size = (size_t)fileStat.st_size;
+	void *mapped = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+	if( mapped == MAP_FAILED ) {
+		error = "Failed to map the snapshot: " + std::string( std::strerror( errno ) );
+		return false;
+	}
+	::madvise( mapped, size, MADV_SEQUENTIAL );
+
+	const char *p = (const char *)mapped;
+	const char *const end = p + size;
+	SnapshotHeader header;
+	std::memcpy( &header, p, sizeof( header ) );
+	p += sizeof( header );
+	// Check the header against the size before trusting the number of entries
+	const uint64_t maxPayloadSize = size - sizeof( header );
+	bool succeeded = !std::memcmp( header.magic, kSnapshotMagic, sizeof( kSnapshotMagic ) ) &&
+					 header.payloadSize == maxPayloadSize && header.numEntries <= maxPayloadSize / kMinEncodedEntrySize &&
+					 checksum( p, maxPayloadSize ) == header.checksum;
+	std::string entryError;
+	if( succeeded ) {
+		entries.resize( header.numEntries );
+		for( uint64_t i = 0; i < header.numEntries && succeeded; ++i ) {
+			p = tryDecodeEntry( p, end, titlePool, entries[i], entryError );
+			succeeded = p != nullptr;
+		}
+	}
+	succeeded = succeeded && p == end;
+	::munmap( mapped, size );
+	if( !succeeded ) {
+		entries.clear();
+		error = entryError.empty() ? "The snapshot is corrupt" : "Failed to load the snapshot: " + entryError;
+		return false;
+	}
+	nextSequence = header.lastSequence + 1;
+	return true;
+}
+
+bool PersistentState::tryReplayingWal( TitlePool &titlePool, std::vector<std::vector<Entry>> &batches, std::string &error ) {
+	walFd = ::open( walPath().c_str(), O_RDWR | O_CREAT, 0644 );
+	if( walFd < 0 ) {
+		error = "Failed to open the write-ahead log: " + std::string( std::strerror( errno ) );
+		return false;
+	}
+
+	std::string content;
+	if( !::tryReadingFile( walPath().c_str(), CachedInput, content, error ) ) {
+		return false;
+	}
+
+	// Batches may be logged concurrently, so they are not necessarily ordered by sequence numbers.
+	// Records of batches are kept, so the log may be rewritten with only the replayed ones.
+	std::map<uint64_t, std::pair<std::vector<Entry>, std::string>> batchesBySequence;
+	uint64_t committedSequence = 0;
+	bool hasSkippedRecords = false;
+	const char *p = content.data();
+	const char *const end = p + content.size();
+	while( (size_t)( end - p ) >= sizeof( BatchHeader ) ) {
+		BatchHeader header;
+		std::memcpy( &header, p, sizeof( header ) );
+		const char *const record = p;
+		const char *const payload = p + sizeof( header );
+		if( ( header.magic != kBatchMagic && header.magic != kCommitMagic ) || (uint64_t)( end - payload ) < header.payloadSize ) {
+			break;
+		}
+		if( checksum( payload, header.payloadSize ) != header.checksum ) {
+			break;
+		}
+		p = payload + header.payloadSize;
+		if( header.magic == kCommitMagic ) {
+			committedSequence = std::max( committedSequence, header.sequence );
+			continue;
+		}
+		// Skip batches that were logged before the last checkpoint but were not truncated
+		if( header.sequence < nextSequence ) {
+			hasSkippedRecords = true;
+			continue;
+		}
+		// A batch of a run that failed after logging it may precede a batch of a later run with the same sequence number
+		auto &batchAndRecord = batchesBySequence[header.sequence];
+		hasSkippedRecords = hasSkippedRecords || !batchAndRecord.second.empty();
+		batchAndRecord.second.assign( record, p );
+		std::vector<Entry> &batch = batchAndRecord.first;
+		batch.clear();
+		batch.resize( header.numEntries );
+		const char *entryPtr = payload;
+		std::string entryError;
+		for( Entry &entry: batch ) {
+			entryPtr = tryDecodeEntry( entryPtr, p, titlePool, entry, entryError );
+			if( !entryPtr ) {
+				error = entryError.empty() ? "A corrupt batch #" + std::to_string( header.sequence ) + " in the write-ahead log"
+										   : "Failed to replay batch #" + std::to_string( header.sequence ) + ": " + entryError;
+				return false;
+			}
+		}
+	}
+
+	// Apply only a contiguous run of committed sequence numbers, so the state is always a merge of a prefix of batches.
+	// Batches after a gap (that could be lost on a crash) and uncommitted ones are dropped.
+	std::string replayedContent;
+	for( auto &sequenceAndBatch: batchesBySequence ) {
+		if( sequenceAndBatch.first != nextSequence || sequenceAndBatch.first > committedSequence ) {
+			break;
+		}
+		batches.emplace_back( std::move( sequenceAndBatch.second.first ) );
+		replayedContent += sequenceAndBatch.second.second;
+		nextSequence++;
+	}
+
+	if( batches.size() == batchesBySequence.size() && !hasSkippedRecords ) {
+		// Just drop a torn tail of the log
+		const auto validSize = (off_t)( p - content.data() );
+		if( ::ftruncate( walFd, validSize ) != 0 || ::lseek( walFd, validSize, SEEK_SET ) < 0 ) {
+			error = "Failed to truncate the write-ahead log: " + std::string( std::strerror( errno ) );
+			return false;
+		}
+		appendedBytes = syncedBytes = (uint64_t)validSize;
+		return true;
+	}
+
+	// Dropped batches must not get replayed once later runs reuse their sequence numbers, so they are removed from the log
+	if( !batches.empty() ) {
+		replayedContent += makeCommitRecord( nextSequence - 1 );
+	}
+	::close( walFd );
+	walFd = -1;
+	if( !tryReplacingFile( walPath(), replayedContent, error ) ) {
+		error = "Failed to rewrite the write-ahead log: " + error;
+		return false;
+	}
+	walFd = ::open( walPath().c_str(), O_RDWR | O_APPEND );
+	if( walFd < 0 ) {
+		error = "Failed to open the write-ahead log: " + std::string( std::strerror( errno ) );
+		return false;
+	}
+	appendedBytes = syncedBytes = replayedContent.size();
+	return true;
+}
+
+bool PersistentState::tryReplacingFile( const std::string &path, const std::string &content, std::string &error ) {
+	// Make the new content durable before it replaces the old one
+	const std::string tmpPath( path + ".tmp" );
+	const int fd = ::open( tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( fd < 0 ) {
+		error = std::strerror( errno );
+		return false;
+	}
+	bool succeeded = true;
+	for( size_t written = 0; written < content.size() && succeeded; ) {
+		const ssize_t result = ::write( fd, content.data() + written, content.size() - written );
+		if( result < 0 ) {
+			succeeded = errno == EINTR;
+		} else {
+			written += (size_t)result;
+		}
+	}
+	succeeded = succeeded && ::fsync( fd ) == 0;
+	::close( fd );
+	if( !succeeded || ::rename( tmpPath.c_str(), path.c_str() ) != 0 ) {
+		error = std::strerror( errno );
+		return false;
+	}
+	const int directoryFd = ::open( directory.c_str(), O_RDONLY );
+	if( directoryFd >= 0 ) {
+		::fsync( directoryFd );
+		::close( directoryFd );
+	}
+	return true;
+}
+
+bool PersistentState::tryAppending( uint64_t sequence, const std::vector<Entry> &batch, const TitlePool &titlePool, std::string &error ) {
+	std::string record( sizeof( BatchHeader ), '\0' );
+	std::string title;
+	for( const Entry &entry: batch ) {
+		encodeEntry( entry, titlePool, title, record );
+	}
+	BatchHeader header;
+	header.magic = kBatchMagic;
+	header.numEntries = (uint32_t)batch.size();
+	header.sequence = sequence;
+	header.payloadSize = record.size() - sizeof( BatchHeader );
+	header.checksum = checksum( record.data() + sizeof( BatchHeader ), header.payloadSize );
+	std::memcpy( &record[0], &header, sizeof( header ) );
+	if( !tryAppendingRecord( record, error ) ) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock( mutex );
+	numBatchesAppended++;
+	return true;
+}
+
+bool PersistentState::tryAppendingRecord( const std::string &record, std::string &error ) {
+	std::unique_lock<std::mutex> lock( mutex );
+	for( size_t written = 0; written < record.size(); ) {
+		const ssize_t result = ::write( walFd, record.data() + written, record.size() - written );
+		if( result < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			error = "Failed to write to the write-ahead log: " + std::string( std::strerror( errno ) );
+			return false;
+		}
+		written += (size_t)result;
+	}
+	appendedBytes += record.size();
+	if( durability == NoSync ) {
+		return true;
+	}
+
+	// Either become a leader that syncs everything appended so far or wait for a leader to do that
+	const uint64_t requiredBytes = appendedBytes;
+	while( syncedBytes < requiredBytes ) {
+		if( isSyncing ) {
+			condition.wait( lock );
+			continue;
+		}
+		isSyncing = true;
+		const uint64_t targetBytes = appendedBytes;
+		lock.unlock();
+		const int result = ::fdatasync( walFd );
+		lock.lock();
+		isSyncing = false;
+		condition.notify_all();
+		if( result != 0 ) {
+			error = "Failed to sync the write-ahead log: " + std::string( std::strerror( errno ) );
+			return false;
+		}
+		syncedBytes = std::max( syncedBytes, targetBytes );
+		numSyncs++;
+	}
+	return true;
+}
+
+bool PersistentState::tryCheckpointing( const std::vector<const Entry *> &winners, const TitlePool &titlePool, std::string &error ) {
+	std::string content( sizeof( SnapshotHeader ), '\0' );
+	std::string title;
+	for( const Entry *entry: winners ) {
+		encodeEntry( *entry, titlePool, title, content );
+	}
+	SnapshotHeader header;
+	std::memcpy( header.magic, kSnapshotMagic, sizeof( kSnapshotMagic ) );
+	header.lastSequence = nextSequence - 1;
+	header.numEntries = winners.size();
+	header.payloadSize = content.size() - sizeof( SnapshotHeader );
+	header.checksum = checksum( content.data() + sizeof( SnapshotHeader ), header.payloadSize );
+	std::memcpy( &content[0], &header, sizeof( header ) );
+
+	// The new snapshot must be durable before the log gets truncated
+	if( !tryReplacingFile( snapshotPath(), content, error ) ) {
+		error = "Failed to write a snapshot: " + error;
+		return false;
+	}
+
+	// Logged batches are covered by the snapshot now.
+	// Even if truncation does not get to the disk, they are skipped on recovery by their sequence numbers.
+	if( ::ftruncate( walFd, 0 ) != 0 || ::lseek( walFd, 0, SEEK_SET ) < 0 ) {
+		error = "Failed to truncate the write-ahead log: " + std::string( std::strerror( errno ) );
+		return false;
+	}
+	appendedBytes = syncedBytes = 0;
+	return true;
+}
@@ -0,0 +1,167 @@
+#ifndef MERGELISTS_PERSISTENT_STATE_H
+#define MERGELISTS_PERSISTENT_STATE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Entry.h"
+#include "TitlePool.h"
+
+/**
+ * A merge state that persists between runs in a directory.
+ * The state consists of a snapshot of winners and of a write-ahead log of batches (lists) that were applied after it.
+ * Every batch gets a sequence number that defines the order of applying batches.
+ * A batch is appended to the log before it is applied.
+ * Batches of a run take effect only once a commit record of the run follows them,
+ * so batches of a run that failed are never replayed.
+ * Concurrent appends share fsync calls (group commit).
+ * A checkpoint writes a new snapshot atomically and truncates the log.
+ * @note binary records are written in the host byte order.
+ */
+class PersistentState {
+public:
+	enum Durability {
+		/**
+		 * Appended batches are left to the page cache.
+		 */
+		NoSync,
+		/**
+		 * An append returns only after the batch is synced to the disk.
+		 */
+		GroupSync
+	};
+private:
+	static constexpr char kSnapshotMagic[8] = { 'M', 'L', 'S', 'N', 'A', 'P', '0', '2' };
+	static constexpr uint32_t kBatchMagic = 0x41574C4D;
+	/**
+	 * A magic of a record that commits all batches up to its sequence number. It has no payload.
+	 */
+	static constexpr uint32_t kCommitMagic = 0x43574C4D;
+
+	struct BatchHeader {
+		uint32_t magic;
+		uint32_t numEntries;
+		uint64_t sequence;
+		uint64_t payloadSize;
+		uint64_t checksum;
+	};
+
+	struct SnapshotHeader {
+		char magic[8];
+		uint64_t lastSequence;
+		uint64_t numEntries;
+		uint64_t payloadSize;
+		uint64_t checksum;
+	};
+
+	/**
+	 * The least size of an encoded entry (the one with an empty title).
+	 */
+	static constexpr size_t kMinEncodedEntrySize = sizeof( int32_t ) + sizeof( uint8_t ) + sizeof( uint64_t ) + sizeof( uint32_t );
+
+	std::string directory;
+	Durability durability { NoSync };
+	int walFd { -1 };
+	/**
+	 * A sequence number of the next batch to be applied.
+	 */
+	uint64_t nextSequence { 1 };
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	uint64_t appendedBytes { 0 };
+	uint64_t syncedBytes { 0 };
+	bool isSyncing { false };
+	uint64_t numBatchesAppended { 0 };
+	uint64_t numSyncs { 0 };
+
+	std::string snapshotPath() const { return directory + "/snapshot"; }
+	std::string walPath() const { return directory + "/wal"; }
+
+	static uint64_t checksum( const char *data, size_t length ) {
+		// FNV-1a
+		uint64_t result = 14695981039346656037ull;
+		for( size_t i = 0; i < length; ++i ) {
+			result = ( result ^ (unsigned char)data[i] ) * 1099511628211ull;
+		}
+		return result;
+	}
+
+	static void encodeEntry( const Entry &entry, const TitlePool &titlePool, std::string &title, std::string &output );
+	/**
+	 * Decodes an entry.
+	 * @param error a description of a failure that is not caused by corrupt data (it's left empty otherwise).
+	 * @return a position after the entry or null on failure.
+	 */
+	static const char *tryDecodeEntry( const char *p, const char *end, TitlePool &titlePool, Entry &entry, std::string &error );
+
+	static std::string makeCommitRecord( uint64_t sequence );
+
+	bool tryLoadingSnapshot( TitlePool &titlePool, std::vector<Entry> &entries, std::string &error );
+	bool tryReplayingWal( TitlePool &titlePool, std::vector<std::vector<Entry>> &batches, std::string &error );
+	/**
+	 * Atomically replaces a file of the state by the given content.
+	 */
+	bool tryReplacingFile( const std::string &path, const std::string &content, std::string &error );
+	/**
+	 * Appends a complete record to the log syncing it according to the durability. It is safe to call this concurrently.
+	 */
+	bool tryAppendingRecord( const std::string &record, std::string &error );
+public:
+	~PersistentState() {
+		if( walFd >= 0 ) {
+			::close( walFd );
+		}
+	}
+
+	/**
+	 * Opens the state recovering its content.
+	 * @param directory_ a directory of the state. It is created if it does not exist.
+	 * @param snapshotEntries winners of the last snapshot.
+	 * @param replayedBatches batches that were logged after the last snapshot in the order of applying.
+	 */
+	bool tryOpening( const std::string &directory_, Durability durability_, TitlePool &titlePool,
+					 std::vector<Entry> &snapshotEntries, std::vector<std::vector<Entry>> &replayedBatches, std::string &error );
+
+	/**
+	 * Reserves sequence numbers for batches that are going to be applied.
+	 * @return the first reserved sequence number.
+	 */
+	uint64_t reserveSequences( size_t count ) {
+		const uint64_t result = nextSequence;
+		nextSequence += count;
+		return result;
+	}
+
+	/**
+	 * Appends a batch to the log. It is safe to call this concurrently.
+	 * @note the batch is not replayed on recovery unless it gets committed.
+	 */
+	bool tryAppending( uint64_t sequence, const std::vector<Entry> &batch, const TitlePool &titlePool, std::string &error );
+
+	/**
+	 * Commits all batches that have been reserved so far.
+	 * @note must be called after all reserved batches have been appended.
+	 */
+	bool tryCommitting( std::string &error ) {
+		return tryAppendingRecord( makeCommitRecord( nextSequence - 1 ), error );
+	}
+
+	/**
+	 * Writes a snapshot of the given winners and truncates the log.
+	 * @note must not be called concurrently with appends.
+	 */
+	bool tryCheckpointing( const std::vector<const Entry *> &winners, const TitlePool &titlePool, std::string &error );
+
+	uint64_t walSize() const { return appendedBytes; }
+	uint64_t batchesAppended() const { return numBatchesAppended; }
+	uint64_t syncs() const { return numSyncs; }
+};
+
+#endif
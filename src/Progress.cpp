@@ -0,0 +1,230 @@
+#include "Progress.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+ProgressCounters *progressCounters = nullptr;
+
+void ProgressCounters::beginStage( Stage stage_, uint64_t total ) {
+	stageTotal.store( total, std::memory_order_relaxed );
+	stageStartedAtNanos.store( std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - startedAt ).count(), std::memory_order_relaxed );
+	stage.store( stage_, std::memory_order_release );
+}
+
+ProgressCounters::Totals ProgressCounters::aggregate() const {
+	Totals totals;
+	for( const ThreadSlot &slot: threadSlots ) {
+		totals.bytesRead += slot.bytesRead.load( std::memory_order_relaxed );
+		totals.bytesParsed += slot.bytesParsed.load( std::memory_order_relaxed );
+		totals.entriesParsed += slot.entriesParsed.load( std::memory_order_relaxed );
+		totals.entriesWritten += slot.entriesWritten.load( std::memory_order_relaxed );
+		totals.bytesWritten += slot.bytesWritten.load( std::memory_order_relaxed );
+	}
+	totals.entriesMerged = entriesMerged.load( std::memory_order_relaxed );
+	totals.distinctKeys = distinctKeys.load( std::memory_order_relaxed );
+	totals.replacements = replacements.load( std::memory_order_relaxed );
+	totals.sortSteps = sortSteps.load( std::memory_order_relaxed );
+	return totals;
+}
+
+std::string ProgressCounters::describe( Totals &previous, std::chrono::steady_clock::time_point &previousAt ) const {
+	static const char *const stageNames[] = { "starting", "loading", "merging", "building", "writing", "finished" };
+	const int currentStage = stage.load( std::memory_order_acquire );
+	const uint64_t total = stageTotal.load( std::memory_order_relaxed );
+	const auto now = std::chrono::steady_clock::now();
+	const auto stageStartedAt = startedAt + std::chrono::nanoseconds( stageStartedAtNanos.load( std::memory_order_relaxed ) );
+	const Totals totals = aggregate();
+
+	// The measure of the progress of a stage
+	auto doneOf = [&]( const Totals &t ) -> uint64_t {
+		switch( currentStage ) {
+			case Loading: return t.bytesParsed;
+			case Merging: return t.entriesMerged;
+			case Building: return t.sortSteps;
+			case Writing: return t.entriesWritten;
+			default: return 0;
+		}
+	};
+	const uint64_t done = doneOf( totals );
+	// Measure the throughput since the previous description unless it was made in another stage
+	const bool hasPrevious = previousAt > stageStartedAt;
+	const uint64_t doneBefore = hasPrevious ? doneOf( previous ) : 0;
+	const double seconds = std::chrono::duration<double>( now - ( hasPrevious ? previousAt : stageStartedAt ) ).count();
+	const double rate = seconds > 0.0 ? (double)( done - std::min( done, doneBefore ) ) / seconds : 0.0;
+
+	std::ostringstream description;
+	description << "progress: stage: " << stageNames[currentStage];
+	description << ", elapsed seconds: " << std::chrono::duration<double>( now - startedAt ).count() << "\n";
+	description << "progress: bytes read: " << totals.bytesRead << ", bytes parsed: " << totals.bytesParsed;
+	description << ", entries parsed: " << totals.entriesParsed << "\n";
+	description << "progress: entries merged: " << totals.entriesMerged << ", distinct keys: " << totals.distinctKeys;
+	description << ", replacements: " << totals.replacements << ", sort steps: " << totals.sortSteps << "\n";
+	description << "progress: entries written: " << totals.entriesWritten << ", bytes written: " << totals.bytesWritten << "\n";
+	if( total && currentStage != Starting && currentStage != Finished ) {
+		static const char *const unitNames[] = { "", "bytes", "entries", "sort steps", "entries", "" };
+		description << "progress: stage progress: " << done << " of " << total << " " << unitNames[currentStage];
+		description << " (" << 100.0 * (double)done / (double)total << "%), " << rate << " " << unitNames[currentStage] << " per second";
+		if( rate > 0.0 && done <= total ) {
+			description << ", ETA seconds: " << (double)( total - done ) / rate;
+		}
+		description << "\n";
+	}
+	previous = totals;
+	previousAt = now;
+	return description.str();
+}
+
+bool ProgressMonitor::tryBlockingSignal( std::string &error ) {
+	sigset_t signals;
+	::sigemptyset( &signals );
+	::sigaddset( &signals, SIGUSR1 );
+	if( const int errorCode = ::pthread_sigmask( SIG_BLOCK, &signals, nullptr ) ) {
+		error = std::string( "Failed to block SIGUSR1: " ) + std::strerror( errorCode );
+		return false;
+	}
+	return true;
+}
+
+bool ProgressMonitor::tryStarting( bool acceptsSignal, const char *socketPath_, std::string &error ) {
+	if( acceptsSignal ) {
+		sigset_t signals;
+		::sigemptyset( &signals );
+		::sigaddset( &signals, SIGUSR1 );
+		signalFd = ::signalfd( -1, &signals, SFD_CLOEXEC );
+		if( signalFd < 0 ) {
+			error = std::string( "Failed to create a signal descriptor: " ) + std::strerror( errno );
+			closeDescriptors();
+			return false;
+		}
+	}
+
+	if( socketPath_ ) {
+		sockaddr_un address;
+		std::memset( &address, 0, sizeof( address ) );
+		address.sun_family = AF_UNIX;
+		if( std::strlen( socketPath_ ) >= sizeof( address.sun_path ) ) {
+			error = std::string( "The stats socket path `" ) + socketPath_ + "` is too long";
+			closeDescriptors();
+			return false;
+		}
+		std::strcpy( address.sun_path, socketPath_ );
+		listeningFd = ::socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+		if( listeningFd < 0 || ::bind( listeningFd, (const sockaddr *)&address, sizeof( address ) ) < 0 ) {
+			error = std::string( "Failed to bind the stats socket `" ) + socketPath_ + "`: " + std::strerror( errno );
+			closeDescriptors();
+			return false;
+		}
+		socketPath = socketPath_;
+		if( ::listen( listeningFd, 16 ) < 0 ) {
+			error = std::string( "Failed to listen on the stats socket `" ) + socketPath_ + "`: " + std::strerror( errno );
+			closeDescriptors();
+			return false;
+		}
+	}
+
+	if( ::pipe2( stopPipe, O_CLOEXEC ) < 0 ) {
+		error = std::string( "Failed to create a pipe: " ) + std::strerror( errno );
+		closeDescriptors();
+		return false;
+	}
+	thread = std::thread( &ProgressMonitor::run, this );
+	return true;
+}
+
+/**
+ * Writes a description to the standard error bypassing {@code std::cerr}.
+ * @note {@code std::cerr} flushes {@code std::cout} first, and that blocks while the output is not consumed.
+ */
+static void writeToStandardError( const std::string &description ) {
+	for( size_t offset = 0; offset < description.size(); ) {
+		const ssize_t numWritten = ::write( STDERR_FILENO, description.data() + offset, description.size() - offset );
+		if( numWritten < 0 && errno == EINTR ) {
+			continue;
+		}
+		if( numWritten <= 0 ) {
+			return;
+		}
+		offset += (size_t)numWritten;
+	}
+}
+
+void ProgressMonitor::run() {
+	pollfd descriptors[3];
+	descriptors[0] = pollfd { stopPipe[0], POLLIN, 0 };
+	descriptors[1] = pollfd { signalFd, POLLIN, 0 };
+	descriptors[2] = pollfd { listeningFd, POLLIN, 0 };
+	for(;; ) {
+		// Negative descriptors are ignored by poll()
+		if( ::poll( descriptors, 3, -1 ) < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			return;
+		}
+		if( descriptors[0].revents ) {
+			return;
+		}
+		if( descriptors[1].revents & POLLIN ) {
+			signalfd_siginfo info;
+			if( ::read( signalFd, &info, sizeof( info ) ) == (ssize_t)sizeof( info ) ) {
+				::writeToStandardError( counters.describe( previousTotals, previousAt ) );
+				numRequestsServed.fetch_add( 1, std::memory_order_relaxed );
+			}
+		}
+		if( descriptors[2].revents & POLLIN ) {
+			serveClient();
+		}
+	}
+}
+
+void ProgressMonitor::serveClient() {
+	const int clientFd = ::accept4( listeningFd, nullptr, nullptr, SOCK_CLOEXEC );
+	if( clientFd < 0 ) {
+		return;
+	}
+	const std::string description = counters.describe( previousTotals, previousAt );
+	// A client that does not read its description may only lose it, it never stalls the monitor for long
+	const timeval timeout { 1, 0 };
+	::setsockopt( clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+	for( size_t offset = 0; offset < description.size(); ) {
+		const ssize_t numWritten = ::send( clientFd, description.data() + offset, description.size() - offset, MSG_NOSIGNAL );
+		if( numWritten <= 0 ) {
+			break;
+		}
+		offset += (size_t)numWritten;
+	}
+	::close( clientFd );
+	numRequestsServed.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void ProgressMonitor::stop() {
+	if( thread.joinable() ) {
+		const char byte = 0;
+		while( ::write( stopPipe[1], &byte, 1 ) < 0 && errno == EINTR ) {}
+		thread.join();
+	}
+	closeDescriptors();
+}
+
+void ProgressMonitor::closeDescriptors() {
+	for( int *fd: { &signalFd, &listeningFd, &stopPipe[0], &stopPipe[1] } ) {
+		if( *fd >= 0 ) {
+			::close( *fd );
+			*fd = -1;
+		}
+	}
+	if( !socketPath.empty() ) {
+		::unlink( socketPath.c_str() );
+		socketPath.clear();
+	}
+}
@@ -0,0 +1,197 @@
+#ifndef MERGELISTS_PROGRESS_H
+#define MERGELISTS_PROGRESS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "Entry.h"
+
+/**
+ * Counters of progress that are updated by pipeline stages and aggregated on demand.
+ * Counters of parallel stages live in per-thread slots on separate cache lines, so updating them is contention-free.
+ * Stages update counters per batches of elements (or per flushes of buffers) rather than per element.
+ */
+class ProgressCounters {
+public:
+	enum Stage {
+		Starting,
+		Loading,
+		Merging,
+		Building,
+		Writing,
+		Finished
+	};
+
+	struct Totals {
+		uint64_t bytesRead { 0 };
+		uint64_t bytesParsed { 0 };
+		uint64_t entriesParsed { 0 };
+		uint64_t entriesMerged { 0 };
+		uint64_t distinctKeys { 0 };
+		uint64_t replacements { 0 };
+		uint64_t sortSteps { 0 };
+		uint64_t entriesWritten { 0 };
+		uint64_t bytesWritten { 0 };
+	};
+private:
+	struct ThreadSlot {
+		std::atomic<uint64_t> bytesRead { 0 };
+		std::atomic<uint64_t> bytesParsed { 0 };
+		std::atomic<uint64_t> entriesParsed { 0 };
+		std::atomic<uint64_t> entriesWritten { 0 };
+		std::atomic<uint64_t> bytesWritten { 0 };
+		// Keep slots of different threads on different cache lines
+		char padding[64 - ( 5 * sizeof( std::atomic<uint64_t> ) ) % 64];
+	};
+
+	static constexpr unsigned kMaxThreadSlots = 64;
+
+	ThreadSlot threadSlots[kMaxThreadSlots];
+	std::atomic<unsigned> numThreadSlotsTaken { 0 };
+
+	// Counters of the merging thread (there's a single writer of each)
+	std::atomic<uint64_t> entriesMerged { 0 };
+	std::atomic<uint64_t> distinctKeys { 0 };
+	std::atomic<uint64_t> replacements { 0 };
+	/**
+	 * Steps of sorting winners: comparisons of the comparison sort or items moved by radix sort passes.
+	 */
+	std::atomic<uint64_t> sortSteps { 0 };
+
+	std::atomic<int> stage { Starting };
+	std::atomic<uint64_t> stageTotal { 0 };
+	std::atomic<int64_t> stageStartedAtNanos { 0 };
+	const std::chrono::steady_clock::time_point startedAt { std::chrono::steady_clock::now() };
+
+	ThreadSlot &slotOfThread() {
+		// Threads beyond the number of slots share the last one (that's why updates are atomic increments)
+		static thread_local unsigned slotIndex = ~0u;
+		if( slotIndex == ~0u ) {
+			slotIndex = std::min( numThreadSlotsTaken.fetch_add( 1, std::memory_order_relaxed ), kMaxThreadSlots - 1 );
+		}
+		return threadSlots[slotIndex];
+	}
+
+	static void increment( std::atomic<uint64_t> &counter, uint64_t delta ) {
+		counter.fetch_add( delta, std::memory_order_relaxed );
+	}
+
+	/**
+	 * Increments a counter that has a single writer without a read-modify-write instruction.
+	 */
+	static void incrementSingleWriter( std::atomic<uint64_t> &counter, uint64_t delta ) {
+		counter.store( counter.load( std::memory_order_relaxed ) + delta, std::memory_order_relaxed );
+	}
+public:
+	void beginStage( Stage stage_, uint64_t total );
+	/**
+	 * Sets the total of the current stage once the stage knows it.
+	 */
+	void setStageTotal( uint64_t total ) { stageTotal.store( total, std::memory_order_relaxed ); }
+
+	void onRead( uint64_t bytes ) { increment( slotOfThread().bytesRead, bytes ); }
+	void onParsed( uint64_t bytes, uint64_t entries ) {
+		ThreadSlot &slot = slotOfThread();
+		increment( slot.bytesParsed, bytes );
+		increment( slot.entriesParsed, entries );
+	}
+	void onWritten( uint64_t bytes, uint64_t entries ) {
+		ThreadSlot &slot = slotOfThread();
+		increment( slot.bytesWritten, bytes );
+		increment( slot.entriesWritten, entries );
+	}
+
+	// These are called only by the merging thread
+	void onMerged( uint64_t entries ) { incrementSingleWriter( entriesMerged, entries ); }
+	void onKeyInserted() { incrementSingleWriter( distinctKeys, 1 ); }
+	void onWinnerReplaced() { incrementSingleWriter( replacements, 1 ); }
+	void onCounted( uint64_t numKeysInserted, uint64_t numWinnersReplaced ) {
+		incrementSingleWriter( distinctKeys, numKeysInserted );
+		incrementSingleWriter( replacements, numWinnersReplaced );
+	}
+	void onSorted( uint64_t steps ) { incrementSingleWriter( sortSteps, steps ); }
+
+	Totals aggregate() const;
+
+	/**
+	 * Describes the current progress with a throughput since the previous description (if any) and an ETA.
+	 * @param previous totals of the previous description. They get updated.
+	 * @param previousAt a time of the previous description. It gets updated.
+	 */
+	std::string describe( Totals &previous, std::chrono::steady_clock::time_point &previousAt ) const;
+};
+
+/**
+ * Counters of progress if they are enabled.
+ */
+extern ProgressCounters *progressCounters;
+
+/**
+ * An observer of changes of winners that counts them.
+ */
+struct ProgressObserver {
+	static constexpr bool kCountsOnly = true;
+
+	ProgressCounters &counters;
+
+	void onInserted( const Entry * ) { counters.onKeyInserted(); }
+	void onReplaced( const Entry *, const Entry * ) { counters.onWinnerReplaced(); }
+	void onCounted( uint64_t numInserted, uint64_t numReplaced ) { counters.onCounted( numInserted, numReplaced ); }
+};
+
+/**
+ * A thread that describes the progress on demand.
+ * A description is written to the standard error on SIGUSR1 and to every client that connects to a stats socket.
+ * The signal is accepted via a signalfd, so it must be blocked in all threads before the monitor is started.
+ */
+class ProgressMonitor {
+	const ProgressCounters &counters;
+	int signalFd { -1 };
+	int listeningFd { -1 };
+	int stopPipe[2] { -1, -1 };
+	std::string socketPath;
+	std::thread thread;
+
+	// The state that is accessed only by the monitor thread
+	ProgressCounters::Totals previousTotals;
+	std::chrono::steady_clock::time_point previousAt;
+	std::atomic<uint64_t> numRequestsServed { 0 };
+
+	void run();
+	void serveClient();
+	void closeDescriptors();
+public:
+	explicit ProgressMonitor( const ProgressCounters &counters_ ): counters( counters_ ) {}
+	~ProgressMonitor() {
+		stop();
+	}
+
+	ProgressMonitor( const ProgressMonitor & ) = delete;
+	ProgressMonitor &operator=( const ProgressMonitor & ) = delete;
+
+	/**
+	 * Blocks SIGUSR1 in the calling thread and in threads it creates afterwards.
+	 * @note must be called before any other threads are started.
+	 */
+	static bool tryBlockingSignal( std::string &error );
+
+	/**
+	 * Starts the monitor thread.
+	 * @param acceptsSignal whether SIGUSR1 triggers a description.
+	 * @param socketPath_ a path of a Unix socket to listen on (if any).
+	 */
+	bool tryStarting( bool acceptsSignal, const char *socketPath_, std::string &error );
+
+	/**
+	 * Stops the monitor thread and removes the socket.
+	 */
+	void stop();
+
+	uint64_t numRequests() const { return numRequestsServed.load( std::memory_order_relaxed ); }
+};
+
+#endif
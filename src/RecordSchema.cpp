@@ -0,0 +1,3 @@
+#include "RecordSchema.h"
+
+constexpr decltype( RecordSchema<Entry>::kFields ) RecordSchema<Entry>::kFields;
@@ -0,0 +1,105 @@
+#ifndef MERGELISTS_RECORD_SCHEMA_H
+#define MERGELISTS_RECORD_SCHEMA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Entry.h"
+
+struct IntegerField {};
+struct TitleField {};
+
+enum FieldFlags {
+	RequiredField = 1,
+	/**
+	 * The field is absent in the serialized form if its value is zero.
+	 */
+	OmittedIfZero = 2
+};
+
+/**
+ * A descriptor of a field of a record. Parsing, validation and serialization of records are generated from these.
+ */
+template <typename Record, typename Kind, typename Member>
+struct FieldDescriptor {
+	static_assert( !std::is_same<Kind, IntegerField>::value || std::is_same<Member, int>::value || std::is_same<Member, uint64_t>::value,
+				   "Integer fields must be stored in int or uint64_t members" );
+	static_assert( !std::is_same<Kind, TitleField>::value || std::is_same<Member, uint32_t>::value,
+				   "Title fields must be stored in uint32_t members" );
+
+	const char *name;
+	size_t nameLength;
+	/**
+	 * A key of the field as it precedes a value in the serialized form.
+	 */
+	const char *formattedKey;
+	size_t formattedKeyLength;
+	Member Record::*member;
+	unsigned flags;
+};
+
+/**
+ * Describes a field of a record that is named {@code name} in JSON and is stored in the {@code member}.
+ */
+#define MERGELISTS_FIELD( Record, name, member, Kind, flags ) \
+	FieldDescriptor<Record, Kind, decltype( Record::member )> { \
+		name, sizeof( name ) - 1, "    \"" name "\": ", sizeof( "    \"" name "\": " ) - 1, &Record::member, flags }
+
+template <typename Fields, typename Function, size_t... Indices>
+inline void forEachField( const Fields &fields, Function &&function, std::index_sequence<Indices...> ) {
+	// The order of evaluation of a braced list is the order of fields
+	(void)std::initializer_list<int> { ( function( std::get<Indices>( fields ), Indices ), 0 )... };
+}
+
+/**
+ * Calls the function with every descriptor of fields and its index. The loop is unrolled at compile time.
+ */
+template <typename Fields, typename Function>
+inline void forEachField( const Fields &fields, Function &&function ) {
+	::forEachField( fields, function, std::make_index_sequence<std::tuple_size<Fields>::value>() );
+}
+
+/**
+ * A schema of records of a kind. A specialization provides:
+ * <ul>
+ * <li>{@code kFields}, a tuple of field descriptors in the order of serialization;</li>
+ * <li>{@code recordName()}, a name of a record for error messages;</li>
+ * <li>{@code finish( record, presentFields )}, which checks rules that involve several fields and derives auxiliary members.
+ * It gets a bit mask of present fields in the order of descriptors and returns a description of a violation or null.</li>
+ * </ul>
+ */
+template <typename Record>
+struct RecordSchema;
+
+template <>
+struct RecordSchema<Entry> {
+	// Keys are sorted as a generic JSON library does
+	static constexpr auto kFields = std::make_tuple(
+		MERGELISTS_FIELD( Entry, "created", created, IntegerField, OmittedIfZero ),
+		MERGELISTS_FIELD( Entry, "deleted", deleted, IntegerField, OmittedIfZero ),
+		MERGELISTS_FIELD( Entry, "num", num, IntegerField, RequiredField ),
+		MERGELISTS_FIELD( Entry, "title", titleId, TitleField, RequiredField )
+	);
+	enum FieldIndex { kCreated, kDeleted, kNum, kTitle };
+
+	static const char *recordName() { return "an entry"; }
+
+	static const char *finish( Entry &entry, uint32_t presentFields ) {
+		const bool hasCreated = presentFields & ( 1u << kCreated );
+		const bool hasDeleted = presentFields & ( 1u << kDeleted );
+		if( hasCreated && hasDeleted ) {
+			return "Both `created` and `deleted` fields are present";
+		}
+		if( !( hasCreated || hasDeleted ) ) {
+			return "Both `created` and `deleted` fields are absent";
+		}
+		entry.timestamp = hasCreated ? entry.created : entry.deleted;
+		return nullptr;
+	}
+};
+
+#endif
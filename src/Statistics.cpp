@@ -0,0 +1,158 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "EngineChoice.h"
+
+static volatile size_t benchmarkSink;
+
+/**
+ * Measures an average latency of retrieval of an original form of a random title.
+ */
+static double measureTitleAccessNanos( const TitlePool &titlePool, const std::vector<const Entry *> &entries ) {
+	if( entries.empty() ) {
+		return 0.0;
+	}
+	std::vector<uint32_t> ids;
+	std::mt19937 rng( 0 );
+	std::uniform_int_distribution<size_t> distribution( 0, entries.size() - 1 );
+	for( int i = 0; i < 10000; ++i ) {
+		ids.push_back( entries[distribution( rng )]->titleId );
+	}
+	std::string title;
+	size_t checksum = 0;
+	const auto startedAt = std::chrono::steady_clock::now();
+	for( uint32_t id: ids ) {
+		title.clear();
+		titlePool.decode( titlePool.get( id ), title );
+		checksum += title.size();
+	}
+	const double nanos = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - startedAt ).count();
+	// Prevent the loop from being optimized out
+	benchmarkSink = checksum;
+	return nanos / ids.size();
+}
+
+static std::string describePercentiles( std::vector<double> &values ) {
+	if( values.empty() ) {
+		return "none";
+	}
+	std::sort( values.begin(), values.end() );
+	auto at = [&]( double fraction ) { return values[std::min( values.size() - 1, (size_t)( fraction * values.size() ) )]; };
+	std::ostringstream result;
+	result << values.size() << " reads, p50 " << at( 0.5 ) << " ns, p99 " << at( 0.99 ) << " ns, p99.9 " << at( 0.999 );
+	result << " ns, max " << values.back() << " ns";
+	return result.str();
+}
+
+void printMemoryStats( const MemoryGovernor &governor, const char *mode ) {
+	printStat( "memory mode", mode );
+	if( governor.limit() ) {
+		printStat( "memory budget", governor.limit() );
+	}
+	printStat( "memory peak", governor.peak() );
+	if( governor.limit() ) {
+		printStat( "memory budget utilization", (double)governor.peak() / (double)governor.limit() );
+		printStat( "memory throttled waits", governor.numWaits() );
+	}
+}
+
+void printInputStats( const Options &options, double loadingSeconds, const InputPrefetcher *prefetcher ) {
+	uint64_t numInputBytes = 0, numCachedPages = 0, numPages = 0;
+	for( const char *filename: options.filenames ) {
+		struct stat fileStat;
+		if( ::stat( filename, &fileStat ) == 0 ) {
+			numInputBytes += (uint64_t)fileStat.st_size;
+		}
+		uint64_t numFileCachedPages, numFilePages;
+		if( ::tryCountingCachedPages( filename, numFileCachedPages, numFilePages ) ) {
+			numCachedPages += numFileCachedPages;
+			numPages += numFilePages;
+		}
+	}
+	static const char *const inputModeNames[] = { "cached", "direct", "drop-cache" };
+	printStat( "input mode", inputModeNames[options.inputMode] );
+	printStat( "input bytes", numInputBytes );
+	printStat( "input loading seconds", loadingSeconds );
+	printStat( "input loading megabytes per second", (double)numInputBytes / ( 1u << 20 ) / std::max( loadingSeconds, 1e-9 ) );
+	printStat( "input pages left in the page cache", std::to_string( numCachedPages ) + " of " + std::to_string( numPages ) );
+	if( prefetcher ) {
+		printStat( "input files read ahead", prefetcher->numFiles() );
+		printStat( "input bytes read ahead", prefetcher->numBytes() );
+	}
+}
+
+void printTitleStats( const TitlePool &titlePool, const std::vector<const Entry *> &entries ) {
+	printStat( "titles added", titlePool.numTitlesAdded() );
+	printStat( "titles stored", titlePool.numTitlesStored() );
+	printStat( "title bytes added", titlePool.numBytesAdded() );
+	printStat( "title bytes stored", titlePool.numBytesStored() );
+	if( titlePool.isCompressing() ) {
+		printStat( "title compression ratio", (double)titlePool.numBytesAdded() / std::max<uint64_t>( 1, titlePool.numBytesStored() ) );
+		printStat( "title compression training seconds", titlePool.compressionTrainingSeconds() );
+		printStat( "title random access nanoseconds", ::measureTitleAccessNanos( titlePool, entries ) );
+	}
+}
+
+void printOutputStats( const Options &options, const EntriesFileWriter &fileWriter, const CompressedEntriesWriter &compressedWriter ) {
+	if( options.compressOutput ) {
+		printStat( "output compressed bytes", compressedWriter.numBytes() );
+		printStat( "output compressed frames", compressedWriter.numFrames() );
+	} else if( options.outputFilename ) {
+		printStat( "output bytes", fileWriter.numBytes() );
+		printStat( "output ranges written in parallel", fileWriter.numRanges() );
+		if( options.writesPointIndex ) {
+			printStat( "output point index bytes", ::getFileSize( ( std::string( options.outputFilename ) + ".idx" ).c_str() ) );
+		}
+		if( options.timestampIndexStride ) {
+			printStat( "output timestamp index bytes", ::getFileSize( ( std::string( options.outputFilename ) + ".tsidx" ).c_str() ) );
+		}
+	}
+}
+
+void printStateStats( const Options &options, const PersistentState &state, const StateRunStats &stats ) {
+	printStat( "state recovery seconds", stats.recoverySeconds );
+	printStat( "state snapshot entries", stats.numSnapshotEntries );
+	printStat( "state batches replayed", stats.numBatchesReplayed );
+	printStat( "state batches appended", state.batchesAppended() );
+	printStat( "state log syncs", state.syncs() );
+	if( stats.checkpointSeconds >= 0.0 ) {
+		printStat( "state checkpoint seconds", stats.checkpointSeconds );
+	}
+	if( options.compact ) {
+		printStat( "state tombstones dropped", stats.numTombstonesDropped );
+		printStat( "state keys evicted", stats.numKeysEvicted );
+	}
+}
+
+void printEngineStats( const Options &options, const MergeBuilder &builder, MergeBuilder::SortAlgorithm sortAlgorithm,
+					   const std::string &engineChoiceReasoning, double mergingSeconds ) {
+	if( options.autoEngine ) {
+		printStat( "engine choice", engineChoiceReasoning );
+	}
+	printStat( "engine", ::engineName( builder.engine() ) );
+	if( builder.engine() == MergeBuilder::DenseEngine ) {
+		const bool isVectorized = builder.isDenseVectorizable() && !options.changeEventsFilename;
+		printStat( "dense kernel", isVectorized ? "avx512" : "scalar" );
+	}
+	printStat( "merging seconds", mergingSeconds );
+	printStat( "sort algorithm", sortAlgorithm == MergeBuilder::RadixSort ? "radix" : "comparison" );
+}
+
+void printConcurrentReadStats( const std::vector<ConcurrentReadLatencies> &readLatencies, const VersionedWinnerTable &table ) {
+	ConcurrentReadLatencies allLatencies;
+	for( const ConcurrentReadLatencies &latencies: readLatencies ) {
+		allLatencies.lookupNanos.insert( allLatencies.lookupNanos.end(), latencies.lookupNanos.begin(), latencies.lookupNanos.end() );
+		allLatencies.scanNanos.insert( allLatencies.scanNanos.end(), latencies.scanNanos.begin(), latencies.scanNanos.end() );
+		allLatencies.numLookupsFound += latencies.numLookupsFound;
+	}
+	printStat( "concurrent lookups that found a winner", allLatencies.numLookupsFound );
+	printStat( "concurrent lookups", ::describePercentiles( allLatencies.lookupNanos ) );
+	printStat( "concurrent ordered scans", ::describePercentiles( allLatencies.scanNanos ) );
+	printStat( "replaced winner records reclaimed", table.numReclaimed() );
+}
@@ -0,0 +1,85 @@
+#ifndef MERGELISTS_STATISTICS_H
+#define MERGELISTS_STATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CompressedEntriesWriter.h"
+#include "EntriesFileWriter.h"
+#include "Entry.h"
+#include "InputReading.h"
+#include "MemoryGovernor.h"
+#include "MergeBuilder.h"
+#include "Options.h"
+#include "PersistentState.h"
+#include "TitlePool.h"
+#include "VersionedWinnerTable.h"
+
+/**
+ * Latencies of reads of snapshots that were performed concurrently with merging.
+ */
+struct ConcurrentReadLatencies {
+	std::vector<double> lookupNanos;
+	std::vector<double> scanNanos;
+	uint64_t numLookupsFound { 0 };
+};
+
+template <typename T>
+void printStat( const char *name, const T &value ) {
+	std::cerr << "stats: " << name << ": " << value << std::endl;
+}
+
+/**
+ * Prints statistics of memory use of a merge that runs in the given memory mode.
+ */
+void printMemoryStats( const MemoryGovernor &governor, const char *mode );
+
+/**
+ * Prints statistics of reading inputs including how much of them is left in the page cache (that's what the input mode is about).
+ * @param prefetcher a prefetcher of inputs if they were read ahead.
+ */
+void printInputStats( const Options &options, double loadingSeconds, const InputPrefetcher *prefetcher );
+
+/**
+ * Prints statistics of stored titles and, if they are compressed, of retrieving titles of the written entries.
+ */
+void printTitleStats( const TitlePool &titlePool, const std::vector<const Entry *> &entries );
+
+/**
+ * Prints statistics of the written output and its indexes.
+ */
+void printOutputStats( const Options &options, const EntriesFileWriter &fileWriter, const CompressedEntriesWriter &compressedWriter );
+
+/**
+ * What a run with a persistent state did to the state.
+ */
+struct StateRunStats {
+	double recoverySeconds { 0.0 };
+	size_t numSnapshotEntries { 0 };
+	size_t numBatchesReplayed { 0 };
+	/**
+	 * A duration of the checkpoint or a negative value if there was no checkpoint.
+	 */
+	double checkpointSeconds { -1.0 };
+	uint64_t numTombstonesDropped { 0 };
+	uint64_t numKeysEvicted { 0 };
+};
+
+void printStateStats( const Options &options, const PersistentState &state, const StateRunStats &stats );
+
+/**
+ * Prints which engine merged entries and how.
+ * @param engineChoiceReasoning why the engine was chosen if it was chosen automatically.
+ */
+void printEngineStats( const Options &options, const MergeBuilder &builder, MergeBuilder::SortAlgorithm sortAlgorithm,
+					   const std::string &engineChoiceReasoning, double mergingSeconds );
+
+/**
+ * Prints latencies of reads that were performed concurrently with merging.
+ */
+void printConcurrentReadStats( const std::vector<ConcurrentReadLatencies> &readLatencies, const VersionedWinnerTable &table );
+
+#endif
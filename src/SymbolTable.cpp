@@ -0,0 +1,92 @@
+#include "SymbolTable.h"
+
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+
+void SymbolTable::rebuildIndex() {
+	for( auto &codes: codesByFirstByte ) {
+		codes.clear();
+	}
+	for( size_t code = 0; code < symbols.size(); ++code ) {
+		codesByFirstByte[(unsigned char)symbols[code].bytes[0]].push_back( (uint8_t)code );
+	}
+	for( auto &codes: codesByFirstByte ) {
+		std::sort( codes.begin(), codes.end(), [&]( uint8_t lhs, uint8_t rhs ) {
+			return symbols[lhs].length > symbols[rhs].length;
+		});
+	}
+}
+
+void SymbolTable::train( const std::vector<std::string> &sample ) {
+	symbols.clear();
+	rebuildIndex();
+
+	std::unordered_map<std::string, uint64_t> counts;
+	for( int round = 0; round < 5; ++round ) {
+		counts.clear();
+		for( const std::string &s: sample ) {
+			const char *p = s.data();
+			const char *const end = p + s.size();
+			const char *prevStart = nullptr;
+			size_t prevLength = 0;
+			while( p != end ) {
+				const uint8_t code = findLongestMatch( p, end );
+				const size_t length = code == kEscapeCode ? 1 : symbols[code].length;
+				counts[std::string( p, length )]++;
+				// Count a concatenation with the previous symbol as a candidate for a longer one
+				if( prevStart && prevLength + length <= kMaxSymbolLength ) {
+					counts[std::string( prevStart, prevLength + length )]++;
+				}
+				prevStart = p;
+				prevLength = length;
+				p += length;
+			}
+		}
+
+		std::vector<std::pair<uint64_t, const std::string *>> candidates;
+		candidates.reserve( counts.size() );
+		for( const auto &kvPair: counts ) {
+			candidates.emplace_back( kvPair.second * kvPair.first.size(), &kvPair.first );
+		}
+		const size_t numPicked = std::min<size_t>( kNumCodes, candidates.size() );
+		std::partial_sort( candidates.begin(), candidates.begin() + numPicked, candidates.end(),
+						   []( const std::pair<uint64_t, const std::string *> &lhs, const std::pair<uint64_t, const std::string *> &rhs ) {
+			return lhs.first > rhs.first || ( lhs.first == rhs.first && *lhs.second < *rhs.second );
+		});
+
+		symbols.clear();
+		for( size_t i = 0; i < numPicked; ++i ) {
+			Symbol symbol;
+			symbol.length = (uint8_t)candidates[i].second->size();
+			std::memcpy( symbol.bytes, candidates[i].second->data(), symbol.length );
+			symbols.push_back( symbol );
+		}
+		rebuildIndex();
+	}
+}
+
+void SymbolTable::encode( const char *data, size_t length, std::string &output ) const {
+	const char *const end = data + length;
+	for( const char *p = data; p != end; ) {
+		const uint8_t code = findLongestMatch( p, end );
+		output.push_back( (char)code );
+		if( code == kEscapeCode ) {
+			output.push_back( *p++ );
+		} else {
+			p += symbols[code].length;
+		}
+	}
+}
+
+void SymbolTable::decode( const char *data, size_t length, std::string &output ) const {
+	const char *const end = data + length;
+	for( const char *p = data; p != end; ) {
+		const uint8_t code = (uint8_t)*p++;
+		if( code == kEscapeCode ) {
+			output.push_back( *p++ );
+		} else {
+			output.append( symbols[code].bytes, symbols[code].length );
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef MERGELISTS_SYMBOL_TABLE_H
+#define MERGELISTS_SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * A static symbol table that compresses short strings independently from each other (in FSST fashion).
+ * Up to 255 symbols of 1-8 bytes are substituted by single byte codes.
+ * Bytes that are not covered by symbols are written after an escape code.
+ * The table is trained once on a sample and is shared by all encoded strings so each of them may be decoded alone.
+ */
+class SymbolTable {
+	static constexpr unsigned kMaxSymbolLength = 8;
+	static constexpr unsigned kNumCodes = 255;
+	static constexpr uint8_t kEscapeCode = 255;
+
+	struct Symbol {
+		char bytes[kMaxSymbolLength];
+		uint8_t length;
+	};
+
+	std::vector<Symbol> symbols;
+	/**
+	 * Codes of symbols that start with the given byte ordered by descending symbol lengths.
+	 */
+	std::vector<uint8_t> codesByFirstByte[256];
+
+	void rebuildIndex();
+	/**
+	 * Finds the longest symbol that matches the string at the given position.
+	 * @return a code of the symbol or the escape code.
+	 */
+	uint8_t findLongestMatch( const char *s, const char *end ) const {
+		for( uint8_t code: codesByFirstByte[(unsigned char)*s] ) {
+			const Symbol &symbol = symbols[code];
+			if( (size_t)( end - s ) >= symbol.length && !std::memcmp( s, symbol.bytes, symbol.length ) ) {
+				return code;
+			}
+		}
+		return kEscapeCode;
+	}
+public:
+	/**
+	 * Trains the table on the given sample using several rounds of refinement.
+	 * Every round compresses the sample using the current table
+	 * and picks symbols and concatenations of adjacent symbols that gain the most.
+	 */
+	void train( const std::vector<std::string> &sample );
+
+	/**
+	 * Encodes the string appending the result to the output.
+	 */
+	void encode( const char *data, size_t length, std::string &output ) const;
+
+	/**
+	 * Decodes the string appending the result to the output.
+	 */
+	void decode( const char *data, size_t length, std::string &output ) const;
+};
+
+#endif
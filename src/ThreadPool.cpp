@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		stopping = true;
+	}
+	condition.notify_all();
+	for( std::thread &worker: workers ) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run() {
+	for(;; ) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			condition.wait( lock, [this]() { return stopping || !tasks.empty(); } );
+			if( tasks.empty() ) {
+				return;
+			}
+			task = std::move( tasks.front() );
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void ThreadPool::submit( std::function<void()> task ) {
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		tasks.emplace_back( std::move( task ) );
+	}
+	condition.notify_one();
+}
+
+void ThreadPool::parallelFor( size_t count, const std::function<void( size_t )> &body ) {
+	if( workers.empty() || count < 2 ) {
+		for( size_t i = 0; i < count; ++i ) {
+			body( i );
+		}
+		return;
+	}
+
+	// The state is shared with helpers that may start after everything is done
+	struct State {
+		std::atomic<size_t> nextIndex { 0 };
+		size_t numCompleted { 0 };
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+	auto state = std::make_shared<State>();
+	const auto drain = [state, count, &body]() {
+		size_t numCompleted = 0;
+		for( size_t i; ( i = state->nextIndex.fetch_add( 1 ) ) < count; ++numCompleted ) {
+			body( i );
+		}
+		if( numCompleted ) {
+			std::lock_guard<std::mutex> lock( state->mutex );
+			state->numCompleted += numCompleted;
+			if( state->numCompleted == count ) {
+				state->condition.notify_all();
+			}
+		}
+	};
+
+	const size_t numHelpers = std::min<size_t>( workers.size(), count - 1 );
+	for( size_t i = 0; i < numHelpers; ++i ) {
+		// The body reference is not touched by a helper that finds no pending indices
+		submit( drain );
+	}
+	drain();
+
+	std::unique_lock<std::mutex> lock( state->mutex );
+	state->condition.wait( lock, [&]() { return state->numCompleted == count; } );
+}
@@ -0,0 +1,47 @@
+#ifndef MERGELISTS_THREAD_POOL_H
+#define MERGELISTS_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads shared by all parallel stages.
+ */
+class ThreadPool {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::function<void()>> tasks;
+	bool stopping { false };
+
+	void run();
+public:
+	/**
+	 * @param numThreads a total number of threads including the one that submits work.
+	 */
+	explicit ThreadPool( unsigned numThreads ) {
+		for( unsigned i = 1; i < numThreads; ++i ) {
+			workers.emplace_back( &ThreadPool::run, this );
+		}
+	}
+
+	~ThreadPool();
+
+	unsigned numThreads() const { return (unsigned)workers.size() + 1; }
+
+	void submit( std::function<void()> task );
+
+	/**
+	 * Calls the body for every index in [0, count) using workers and the calling thread.
+	 * Returns when all calls are complete.
+	 * @note the calling thread keeps executing pending indices itself,
+	 * so it is safe to call this from a task that runs on a worker.
+	 */
+	void parallelFor( size_t count, const std::function<void( size_t )> &body );
+};
+
+#endif
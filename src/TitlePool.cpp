@@ -0,0 +1,175 @@
+#include "TitlePool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+const char *TitlePool::Shard::store( const char *data, size_t length ) {
+	if( length > blockSpaceLeft ) {
+		// Give an oversized title its own block keeping the current one
+		if( length > kArenaBlockSize / 4 ) {
+			oversizedBlocks.emplace_back( new char[length] );
+			std::memcpy( oversizedBlocks.back().get(), data, length );
+			return oversizedBlocks.back().get();
+		}
+		if( numBlocksUsed == blocks.size() ) {
+			blocks.emplace_back( new char[kArenaBlockSize] );
+		}
+		blockCursor = blocks[numBlocksUsed++].get();
+		blockSpaceLeft = kArenaBlockSize;
+	}
+	char *result = blockCursor;
+	std::memcpy( result, data, length );
+	blockCursor += length;
+	blockSpaceLeft -= length;
+	return result;
+}
+
+void TitlePool::Shard::clear() {
+	titles.clear();
+	hashes.clear();
+	std::fill( slots.begin(), slots.end(), 0 );
+	numBlocksUsed = 0;
+	oversizedBlocks.clear();
+	blockSpaceLeft = 0;
+	blockCursor = nullptr;
+}
+
+void TitlePool::Shard::grow() {
+	std::vector<uint32_t> newSlots( slots.empty() ? 1024 : slots.size() * 2, 0 );
+	const size_t mask = newSlots.size() - 1;
+	for( uint32_t slot: slots ) {
+		if( slot ) {
+			size_t i = hashes[slot - 1] & mask;
+			while( newSlots[i] ) {
+				i = ( i + 1 ) & mask;
+			}
+			newSlots[i] = slot;
+		}
+	}
+	slots.swap( newSlots );
+}
+
+bool TitlePool::Shard::tryFindingOrAdding( const char *data, uint32_t length, bool compressed, uint32_t hash, uint32_t &index ) {
+	// Keep the load factor below 1/2
+	if( 2 * ( titles.size() + 1 ) > slots.size() ) {
+		grow();
+	}
+	const size_t mask = slots.size() - 1;
+	size_t i = hash & mask;
+	for(; slots[i]; i = ( i + 1 ) & mask ) {
+		const uint32_t slotIndex = slots[i] - 1;
+		const Title &title = titles[slotIndex];
+		if( hashes[slotIndex] == hash && title.length == length && title.compressed == compressed &&
+			!std::memcmp( title.data, data, length ) ) {
+			index = slotIndex;
+			return true;
+		}
+	}
+	if( titles.size() == kMaxTitlesPerShard ) {
+		return false;
+	}
+	index = (uint32_t)titles.size();
+	titles.push_back( Title { store( data, length ), length, compressed } );
+	hashes.push_back( hash );
+	slots[i] = index + 1;
+	return true;
+}
+
+void TitlePool::addToTrainingSample( const char *data, size_t length ) {
+	std::lock_guard<std::mutex> lock( trainingMutex );
+	if( trained.load( std::memory_order_relaxed ) ) {
+		return;
+	}
+	trainingSample.emplace_back( data, length );
+	if( trainingSample.size() < kTrainingSampleSize ) {
+		return;
+	}
+	const auto startedAt = std::chrono::steady_clock::now();
+	symbolTable.train( trainingSample );
+	trainingSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startedAt ).count();
+	std::vector<std::string>().swap( trainingSample );
+	trained.store( true, std::memory_order_release );
+}
+
+bool TitlePool::tryAdding( const char *data, size_t length, uint32_t &id ) {
+	if( length > UINT32_MAX ) {
+		return false;
+	}
+	const size_t originalLength = length;
+	bool compressed = false;
+	if( compressing ) {
+		// Titles that were added before the training remain stored as-is
+		if( trained.load( std::memory_order_acquire ) ) {
+			static thread_local std::string encoded;
+			encoded.clear();
+			symbolTable.encode( data, length, encoded );
+			data = encoded.data();
+			length = encoded.size();
+			compressed = true;
+		} else {
+			addToTrainingSample( data, length );
+		}
+	}
+
+	if( interning ) {
+		const uint32_t titleHash = hash( data, length );
+		// Use the upper bits for selection of a shard as the lower ones select a slot
+		const unsigned shardNum = titleHash >> ( 32 - kShardBits );
+		Shard &shard = shards[shardNum];
+		std::lock_guard<std::mutex> lock( shard.mutex );
+		uint32_t index;
+		if( !shard.tryFindingOrAdding( data, (uint32_t)length, compressed, titleHash, index ) ) {
+			return false;
+		}
+		id = ( index << kShardBits ) | shardNum;
+		countAdded( originalLength );
+		return true;
+	}
+
+	// Let every thread stick to its own shard
+	static thread_local unsigned threadShardNum = ~0u;
+	if( threadShardNum == ~0u ) {
+		threadShardNum = nextShardForThread.fetch_add( 1, std::memory_order_relaxed ) % kNumShards;
+	}
+	Shard &shard = shards[threadShardNum];
+	std::lock_guard<std::mutex> lock( shard.mutex );
+	if( shard.titles.size() == kMaxTitlesPerShard ) {
+		return false;
+	}
+	const auto index = (uint32_t)shard.titles.size();
+	shard.titles.push_back( Title { shard.store( data, length ), (uint32_t)length, compressed } );
+	id = ( index << kShardBits ) | threadShardNum;
+	countAdded( originalLength );
+	return true;
+}
+
+void TitlePool::clear() {
+	for( Shard &shard: shards ) {
+		shard.clear();
+	}
+	trainingSample.clear();
+	trained.store( false );
+	trainingSeconds = 0.0;
+	bytesAdded.store( 0 );
+	titlesAdded.store( 0 );
+	currentGeneration++;
+}
+
+uint64_t TitlePool::numTitlesStored() const {
+	uint64_t result = 0;
+	for( const Shard &shard: shards ) {
+		result += shard.titles.size();
+	}
+	return result;
+}
+
+uint64_t TitlePool::numBytesStored() const {
+	uint64_t result = 0;
+	for( const Shard &shard: shards ) {
+		for( const Title &title: shard.titles ) {
+			result += title.length;
+		}
+	}
+	return result;
+}
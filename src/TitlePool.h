@@ -0,0 +1,152 @@
+#ifndef MERGELISTS_TITLE_POOL_H
+#define MERGELISTS_TITLE_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "SymbolTable.h"
+
+/**
+ * A storage of entry titles that refers to them by 32-bit ids.
+ * Title bytes are kept in arenas so an entry does not have to own a heap-allocated string.
+ * If interning is enabled, equal titles share the same id and their bytes are stored once.
+ * If compression is enabled, a symbol table gets trained on the first added titles,
+ * and all further titles are stored encoded so they get decoded only on retrieval.
+ * The storage is sharded so concurrent parsers rarely contend for the same lock.
+ * @note titles may be retrieved concurrently with each other but not with additions.
+ */
+class TitlePool {
+public:
+	/**
+	 * A stored form of a title.
+	 */
+	struct Title {
+		const char *data;
+		uint32_t length;
+		bool compressed;
+	};
+private:
+	static constexpr unsigned kShardBits = 4;
+	static constexpr unsigned kNumShards = 1u << kShardBits;
+	/**
+	 * An id keeps an index of a title within its shard in the bits that are left after the shard number.
+	 */
+	static constexpr size_t kMaxTitlesPerShard = (size_t)1 << ( 32 - kShardBits );
+	static constexpr size_t kArenaBlockSize = 1u << 16;
+	static constexpr size_t kTrainingSampleSize = 1u << 14;
+
+	struct alignas( 64 ) Shard {
+		std::mutex mutex;
+		std::vector<Title> titles;
+		std::vector<uint32_t> hashes;
+		/**
+		 * An open-addressing table of indices of titles plus one (zero marks an empty slot).
+		 * It gets used only if interning is enabled.
+		 */
+		std::vector<uint32_t> slots;
+		/**
+		 * Arena blocks. Blocks that follow the used ones are left after clearing for reuse.
+		 */
+		std::vector<std::unique_ptr<char[]>> blocks;
+		size_t numBlocksUsed { 0 };
+		std::vector<std::unique_ptr<char[]>> oversizedBlocks;
+		size_t blockSpaceLeft { 0 };
+		char *blockCursor { nullptr };
+
+		const char *store( const char *data, size_t length );
+		void clear();
+		bool tryFindingOrAdding( const char *data, uint32_t length, bool compressed, uint32_t hash, uint32_t &index );
+		void grow();
+	};
+
+	Shard shards[kNumShards];
+	const bool interning;
+	const bool compressing;
+	std::atomic<unsigned> nextShardForThread { 0 };
+
+	std::mutex trainingMutex;
+	std::vector<std::string> trainingSample;
+	SymbolTable symbolTable;
+	std::atomic<bool> trained { false };
+	double trainingSeconds { 0.0 };
+
+	void addToTrainingSample( const char *data, size_t length );
+
+	std::atomic<uint64_t> bytesAdded { 0 };
+	std::atomic<uint64_t> titlesAdded { 0 };
+	/**
+	 * The number of times the pool has been cleared, so ids of titles are valid only within a generation.
+	 */
+	uint64_t currentGeneration { 0 };
+
+	void countAdded( size_t length ) {
+		titlesAdded.fetch_add( 1, std::memory_order_relaxed );
+		bytesAdded.fetch_add( length, std::memory_order_relaxed );
+	}
+
+	static uint32_t hash( const char *data, size_t length ) {
+		// FNV-1a
+		uint32_t result = 2166136261u;
+		for( size_t i = 0; i < length; ++i ) {
+			result = ( result ^ (unsigned char)data[i] ) * 16777619u;
+		}
+		return result;
+	}
+public:
+	TitlePool( bool interning_, bool compressing_ ): interning( interning_ ), compressing( compressing_ ) {}
+
+	/**
+	 * Removes all titles keeping allocated memory for reuse.
+	 * A symbol table of compression gets trained anew on further titles.
+	 * @note must not be called concurrently with other methods.
+	 */
+	void clear();
+
+	/**
+	 * Adds a title to the pool.
+	 * @param id an id of the title. It is an id of an existing equal title if interning is enabled.
+	 * @return false if the title is longer than 4 GiB or ids of its shard are exhausted.
+	 */
+	bool tryAdding( const char *data, size_t length, uint32_t &id );
+
+	/**
+	 * Gets a stored form of a title.
+	 * @note the title should be decoded if it is compressed.
+	 */
+	Title get( uint32_t id ) const {
+		return shards[id & ( kNumShards - 1 )].titles[id >> kShardBits];
+	}
+
+	/**
+	 * Appends an original form of a stored title to the output.
+	 */
+	void decode( const Title &title, std::string &output ) const {
+		if( title.compressed ) {
+			symbolTable.decode( title.data, title.length, output );
+		} else {
+			output.append( title.data, title.length );
+		}
+	}
+
+	bool isInterning() const { return interning; }
+	bool isCompressing() const { return compressing; }
+	double compressionTrainingSeconds() const { return trainingSeconds; }
+
+	static unsigned shardOf( uint32_t id ) { return id & ( kNumShards - 1 ); }
+	static uint32_t indexInShard( uint32_t id ) { return id >> kShardBits; }
+	static uint32_t idOf( unsigned shard, uint32_t indexInShard ) { return ( indexInShard << kShardBits ) | shard; }
+	static unsigned numShards() { return kNumShards; }
+	size_t shardSize( unsigned shard ) const { return shards[shard].titles.size(); }
+
+	uint64_t generation() const { return currentGeneration; }
+	uint64_t numTitlesAdded() const { return titlesAdded.load( std::memory_order_relaxed ); }
+	uint64_t numBytesAdded() const { return bytesAdded.load( std::memory_order_relaxed ); }
+	uint64_t numTitlesStored() const;
+	uint64_t numBytesStored() const;
+};
+
+#endif
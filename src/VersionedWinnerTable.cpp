@@ -0,0 +1,166 @@
+#include "VersionedWinnerTable.h"
+
+#include <algorithm>
+
+VersionedWinnerTable::~VersionedWinnerTable() {
+	// Every record is either a head of a slot or a retired one
+	Table *currentTable = table.load();
+	for( size_t i = 0; i < currentTable->capacity; ++i ) {
+		delete currentTable->slots[i].head.load();
+	}
+	for( auto &versionAndRecord: retiredRecords ) {
+		delete versionAndRecord.second;
+	}
+	for( auto &versionAndTable: retiredTables ) {
+		delete versionAndTable.second;
+	}
+	delete currentTable;
+}
+
+int VersionedWinnerTable::registerReader() {
+	for( unsigned i = 0; i < kMaxReaders; ++i ) {
+		bool expected = false;
+		if( readers[i].taken.compare_exchange_strong( expected, true ) ) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+void VersionedWinnerTable::unregisterReader( int reader ) {
+	readers[reader].version.store( kIdle );
+	readers[reader].taken.store( false );
+}
+
+uint64_t VersionedWinnerTable::beginRead( int reader ) {
+	// Make sure the writer has seen the announced version before it decides what to reclaim.
+	// If a newer version got published meanwhile, the writer might have missed the announcement.
+	uint64_t version = publishedVersion.load();
+	for(;; ) {
+		readers[reader].version.store( version );
+		const uint64_t recheckedVersion = publishedVersion.load();
+		if( recheckedVersion == version ) {
+			return version;
+		}
+		version = recheckedVersion;
+	}
+}
+
+void VersionedWinnerTable::apply( const Entry *begin, const Entry *end ) {
+	const uint64_t version = publishedVersion.load( std::memory_order_relaxed ) + 1;
+	for( const Entry *entry = begin; entry != end; ++entry ) {
+		upsert( entry, version );
+	}
+	publishedVersion.store( version );
+	reclaim();
+}
+
+void VersionedWinnerTable::upsert( const Entry *entry, uint64_t version ) {
+	Table *currentTable = table.load( std::memory_order_relaxed );
+	if( 2 * ( numKeys + 1 ) > currentTable->capacity ) {
+		grow( version );
+		currentTable = table.load( std::memory_order_relaxed );
+	}
+
+	const size_t mask = currentTable->capacity - 1;
+	for( size_t i = slotOf( entry->num, currentTable->capacity );; i = ( i + 1 ) & mask ) {
+		Slot &slot = currentTable->slots[i];
+		const int64_t key = slot.key.load( std::memory_order_relaxed );
+		if( key == kEmptyKey ) {
+			// Publish the record before the key, so a reader that finds the key sees the record
+			slot.head.store( new Record { entry, version, nullptr }, std::memory_order_release );
+			slot.key.store( entry->num, std::memory_order_release );
+			numKeys++;
+			return;
+		}
+		if( key != entry->num ) {
+			continue;
+		}
+		Record *head = slot.head.load( std::memory_order_relaxed );
+		if( !( *head->entry < *entry ) ) {
+			return;
+		}
+		// A record of the current unpublished version is not visible to anybody, so it's skipped in the chain
+		Record *older = head->version == version ? head->older : head;
+		slot.head.store( new Record { entry, version, older }, std::memory_order_release );
+		retiredRecords.emplace_back( version, head );
+		return;
+	}
+}
+
+void VersionedWinnerTable::grow( uint64_t version ) {
+	Table *oldTable = table.load( std::memory_order_relaxed );
+	auto *newTable = new Table( oldTable->capacity * 2 );
+	const size_t mask = newTable->capacity - 1;
+	for( size_t i = 0; i < oldTable->capacity; ++i ) {
+		const int64_t key = oldTable->slots[i].key.load( std::memory_order_relaxed );
+		if( key == kEmptyKey ) {
+			continue;
+		}
+		size_t j = slotOf( (int)key, newTable->capacity );
+		while( newTable->slots[j].key.load( std::memory_order_relaxed ) != kEmptyKey ) {
+			j = ( j + 1 ) & mask;
+		}
+		newTable->slots[j].head.store( oldTable->slots[i].head.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+		newTable->slots[j].key.store( key, std::memory_order_relaxed );
+	}
+	table.store( newTable, std::memory_order_release );
+	// Readers that may still use the old table have announced versions below the current one
+	retiredTables.emplace_back( version, oldTable );
+}
+
+void VersionedWinnerTable::reclaim() {
+	uint64_t minVersion = kIdle;
+	for( const ReaderSlot &reader: readers ) {
+		minVersion = std::min( minVersion, reader.version.load() );
+	}
+	while( !retiredRecords.empty() && retiredRecords.front().first <= minVersion ) {
+		delete retiredRecords.front().second;
+		retiredRecords.pop_front();
+		numRecordsReclaimed++;
+	}
+	while( !retiredTables.empty() && retiredTables.front().first <= minVersion ) {
+		delete retiredTables.front().second;
+		retiredTables.pop_front();
+	}
+}
+
+const VersionedWinnerTable::Record *VersionedWinnerTable::findVisible( const Table *currentTable, int num, uint64_t version ) const {
+	const size_t mask = currentTable->capacity - 1;
+	for( size_t i = slotOf( num, currentTable->capacity );; i = ( i + 1 ) & mask ) {
+		const Slot &slot = currentTable->slots[i];
+		const int64_t key = slot.key.load( std::memory_order_acquire );
+		if( key == kEmptyKey ) {
+			return nullptr;
+		}
+		if( key == num ) {
+			const Record *record = slot.head.load( std::memory_order_acquire );
+			while( record && record->version > version ) {
+				record = record->older;
+			}
+			return record;
+		}
+	}
+}
+
+const Entry *VersionedWinnerTable::find( int num, uint64_t version ) const {
+	const Record *record = findVisible( table.load( std::memory_order_acquire ), num, version );
+	return record ? record->entry : nullptr;
+}
+
+void VersionedWinnerTable::collect( uint64_t version, std::vector<const Entry *> &result ) const {
+	const Table *currentTable = table.load( std::memory_order_acquire );
+	for( size_t i = 0; i < currentTable->capacity; ++i ) {
+		const Slot &slot = currentTable->slots[i];
+		if( slot.key.load( std::memory_order_acquire ) == kEmptyKey ) {
+			continue;
+		}
+		const Record *record = slot.head.load( std::memory_order_acquire );
+		while( record && record->version > version ) {
+			record = record->older;
+		}
+		if( record ) {
+			result.push_back( record->entry );
+		}
+	}
+}
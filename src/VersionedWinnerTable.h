@@ -0,0 +1,121 @@
+#ifndef MERGELISTS_VERSIONED_WINNER_TABLE_H
+#define MERGELISTS_VERSIONED_WINNER_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Entry.h"
+
+/**
+ * A table of winners that may be read concurrently with merging using consistent versioned snapshots.
+ * There is a single writer that applies batches of entries. Every applied batch produces a new version.
+ * Replaced winners are kept in per-key chains of records ordered by descending versions,
+ * so a reader of an older version still sees the winners of that version.
+ * Readers never block the writer and the writer never blocks readers.
+ * Memory of replaced records is reclaimed in epoch-based fashion once no reader may refer to them.
+ * Versions serve as epochs: a reader announces the version it reads and a record superseded at version W
+ * (or a table replaced at version W) is freed as soon as all announced versions are at least W.
+ */
+class VersionedWinnerTable {
+	struct Record {
+		const Entry *entry;
+		uint64_t version;
+		/**
+		 * A record of the previous winner. It may dangle, but it is never followed by a reader
+		 * that is allowed to see this record, as such a reader stops at this record.
+		 */
+		Record *older;
+	};
+
+	struct Slot {
+		std::atomic<int64_t> key { kEmptyKey };
+		std::atomic<Record *> head { nullptr };
+	};
+
+	struct Table {
+		const size_t capacity;
+		std::unique_ptr<Slot[]> slots;
+
+		explicit Table( size_t capacity_ ): capacity( capacity_ ), slots( new Slot[capacity_] ) {}
+	};
+
+	static constexpr int64_t kEmptyKey = INT64_MIN;
+	static constexpr uint64_t kIdle = UINT64_MAX;
+	static constexpr unsigned kMaxReaders = 64;
+
+	struct ReaderSlot {
+		std::atomic<uint64_t> version { kIdle };
+		std::atomic<bool> taken { false };
+		// Keep slots of different readers on different cache lines
+		char padding[64 - sizeof( std::atomic<uint64_t> ) - sizeof( std::atomic<bool> )];
+	};
+
+	ReaderSlot readers[kMaxReaders];
+	std::atomic<Table *> table;
+	std::atomic<uint64_t> publishedVersion { 0 };
+
+	// The state that is accessed only by the writer
+	size_t numKeys { 0 };
+	std::deque<std::pair<uint64_t, Record *>> retiredRecords;
+	std::deque<std::pair<uint64_t, Table *>> retiredTables;
+	uint64_t numRecordsReclaimed { 0 };
+
+	static size_t slotOf( int num, size_t capacity ) {
+		return ( (uint32_t)num * 2654435761u ) & ( capacity - 1 );
+	}
+
+	void upsert( const Entry *entry, uint64_t version );
+	void grow( uint64_t version );
+	void reclaim();
+	const Record *findVisible( const Table *currentTable, int num, uint64_t version ) const;
+public:
+	VersionedWinnerTable(): table( new Table( 1024 ) ) {}
+	~VersionedWinnerTable();
+
+	VersionedWinnerTable( const VersionedWinnerTable & ) = delete;
+	VersionedWinnerTable &operator=( const VersionedWinnerTable & ) = delete;
+
+	/**
+	 * Applies a batch of entries and publishes a new version.
+	 * @note must be called by the single writer.
+	 */
+	void apply( const Entry *begin, const Entry *end );
+
+	/**
+	 * Registers a reader thread.
+	 * @return an id of the reader or -1 if there are too many readers.
+	 */
+	int registerReader();
+	void unregisterReader( int reader );
+
+	/**
+	 * Starts a read operation.
+	 * @return a version that stays consistent until {@code endRead()} is called.
+	 */
+	uint64_t beginRead( int reader );
+	void endRead( int reader ) {
+		readers[reader].version.store( kIdle, std::memory_order_release );
+	}
+
+	/**
+	 * Finds a winner of the given key as of the given version.
+	 * @note must be called between {@code beginRead()} and {@code endRead()} (unless called by the writer).
+	 */
+	const Entry *find( int num, uint64_t version ) const;
+
+	/**
+	 * Collects winners as of the given version (in no particular order).
+	 * @note must be called between {@code beginRead()} and {@code endRead()} (unless called by the writer).
+	 */
+	void collect( uint64_t version, std::vector<const Entry *> &result ) const;
+
+	uint64_t latestVersion() const { return publishedVersion.load( std::memory_order_acquire ); }
+	size_t numWinners() const { return numKeys; }
+	uint64_t numReclaimed() const { return numRecordsReclaimed; }
+};
+
+#endif
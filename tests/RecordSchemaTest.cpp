@@ -0,0 +1,146 @@
+// Checks that parsing and formatting that are generated from a schema work for a record other than an entry.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/EntriesParser.h"
+#include "src/EntryFormatter.h"
+#include "src/RecordSchema.h"
+#include "src/TitlePool.h"
+
+/**
+ * A record that differs from an entry in names, types, flags and the number of fields.
+ */
+struct Payment {
+	int account;
+	uint64_t amount { 0 };
+	/**
+	 * An id of the memo in a {@code TitlePool}.
+	 */
+	uint32_t memoId { 0 };
+	uint64_t settled { 0 };
+};
+
+template <>
+struct RecordSchema<Payment> {
+	static constexpr auto kFields = std::make_tuple(
+		MERGELISTS_FIELD( Payment, "account", account, IntegerField, RequiredField ),
+		MERGELISTS_FIELD( Payment, "amount", amount, IntegerField, RequiredField ),
+		MERGELISTS_FIELD( Payment, "memo", memoId, TitleField, RequiredField ),
+		MERGELISTS_FIELD( Payment, "settled", settled, IntegerField, OmittedIfZero )
+	);
+	enum FieldIndex { kAccount, kAmount, kMemo, kSettled };
+
+	static const char *recordName() { return "a payment"; }
+
+	static const char *finish( Payment &payment, uint32_t ) {
+		return payment.amount ? nullptr : "A payment of nothing";
+	}
+};
+
+constexpr decltype( RecordSchema<Payment>::kFields ) RecordSchema<Payment>::kFields;
+
+static int numFailed = 0;
+
+static void check( bool condition, const std::string &description ) {
+	if( !condition ) {
+		std::cout << "FAIL: " << description << std::endl;
+		numFailed++;
+	}
+}
+
+static bool tryParsing( const std::string &input, TitlePool &titlePool, std::vector<Payment> &payments, bool skipInvalid,
+						std::vector<std::string> &warnings, std::string &error ) {
+	EntriesParser parser( input.data(), input.data() + input.size(), titlePool );
+	return parser.parse( payments, skipInvalid, warnings, error );
+}
+
+static void testParsingAndFormatting() {
+	const std::string input =
+		"[{\"memo\": \"rent\", \"amount\": 1200, \"account\": -7},\n"
+		" {\"account\": 2147483647, \"note\": {\"nested\": [1, {\"a\": null}]}, \"settled\": 30, \"amount\": 18446744073709551615,"
+		" \"memo\": \"a \\\"quoted\\\" memo\\n\\u00e9\"}]";
+	for( bool interning: { false, true } ) {
+		TitlePool titlePool( interning, false );
+		std::vector<Payment> payments;
+		std::vector<std::string> warnings;
+		std::string error;
+		if( !::tryParsing( input, titlePool, payments, false, warnings, error ) ) {
+			check( false, "parsing of valid payments failed: " + error );
+			continue;
+		}
+		check( payments.size() == 2, "a number of parsed payments" );
+		if( payments.size() != 2 ) {
+			continue;
+		}
+		check( payments[0].account == -7 && payments[0].amount == 1200 && payments[0].settled == 0, "fields of the first payment" );
+		check( payments[1].account == 2147483647 && payments[1].amount == UINT64_MAX && payments[1].settled == 30,
+			   "fields of the second payment" );
+		std::string memo;
+		titlePool.decode( titlePool.get( payments[1].memoId ), memo );
+		check( memo == "a \"quoted\" memo\n\xC3\xA9", "an unescaped memo" );
+
+		EntryFormatter formatter( titlePool, interning );
+		std::string output;
+		for( const Payment &payment: payments ) {
+			const size_t oldSize = output.size();
+			formatter.append( payment, output );
+			check( output.size() - oldSize == formatter.length( payment ), "a precomputed length of a formatted payment" );
+			output.push_back( '\n' );
+		}
+		// A field that is zero and may be omitted is omitted
+		check( output ==
+			   "  {\n"
+			   "    \"account\": -7,\n"
+			   "    \"amount\": 1200,\n"
+			   "    \"memo\": \"rent\"\n"
+			   "  }\n"
+			   "  {\n"
+			   "    \"account\": 2147483647,\n"
+			   "    \"amount\": 18446744073709551615,\n"
+			   "    \"memo\": \"a \\\"quoted\\\" memo\\n\xC3\xA9\",\n"
+			   "    \"settled\": 30\n"
+			   "  }\n", "formatted payments:\n" + output );
+	}
+}
+
+static void testInvalidPayments() {
+	const struct {
+		const char *input;
+		const char *expectedError;
+	} cases[] = {
+		{ "[{\"account\": 1, \"amount\": 5}]", "element #0: Failed to get field `memo` of a payment" },
+		{ "[{\"account\": 1, \"amount\": -5, \"memo\": \"\"}]", "The field `amount` is negative while an unsigned integer is expected" },
+		{ "[{\"account\": 2147483648, \"amount\": 5, \"memo\": \"\"}]", "The field `account` is out of range" },
+		{ "[{\"account\": 1, \"amount\": 5, \"memo\": 5}]", "The field `memo` is not a string" },
+		{ "[{\"account\": 1, \"amount\": 0, \"memo\": \"\"}]", "A payment of nothing" },
+	};
+	for( const auto &testCase: cases ) {
+		TitlePool titlePool( false, false );
+		std::vector<Payment> payments;
+		std::vector<std::string> warnings;
+		std::string error;
+		check( !::tryParsing( testCase.input, titlePool, payments, false, warnings, error ), std::string( "parsing of " ) + testCase.input + " succeeded" );
+		check( error.find( testCase.expectedError ) != std::string::npos, "unexpected error `" + error + "` instead of `" + testCase.expectedError + "`" );
+
+		// An invalid payment is skipped if requested
+		const std::string input = std::string( testCase.input ).insert( 1, "{\"account\": 3, \"amount\": 1, \"memo\": \"x\"}, " );
+		payments.clear();
+		warnings.clear();
+		check( ::tryParsing( input, titlePool, payments, true, warnings, error ) && payments.size() == 1 && warnings.size() == 1,
+			   "skipping of an invalid payment in " + input );
+	}
+}
+
+int main() {
+	::testParsingAndFormatting();
+	::testInvalidPayments();
+	if( numFailed ) {
+		std::cout << numFailed << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,125 @@
+// Checks that strings compressed by a symbol table and by a compressing title pool decode to their original forms.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/SymbolTable.h"
+#include "src/TitlePool.h"
+
+static int numFailed = 0;
+
+static void check( bool condition, const std::string &description ) {
+	if( !condition ) {
+		std::cout << "FAIL: " << description << std::endl;
+		numFailed++;
+	}
+}
+
+static std::vector<std::string> makeTitles( size_t count ) {
+	static const char *const words[] = { "merge", "list", "entry", "of", "the", "deleted", "created", "title", "#", " " };
+	std::vector<std::string> titles;
+	uint32_t state = 1;
+	for( size_t i = 0; i < count; ++i ) {
+		std::string title;
+		for( int j = 0; j < 6; ++j ) {
+			state = state * 1103515245u + 12345u;
+			title += words[( state >> 16 ) % ( sizeof( words ) / sizeof( *words ) )];
+		}
+		titles.push_back( title + std::to_string( i ) );
+	}
+	return titles;
+}
+
+/**
+ * Strings that are unlike a sample of titles, so they are mostly escaped.
+ */
+static std::vector<std::string> makeUnusualStrings() {
+	std::vector<std::string> strings { "", "m", "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz", "\xF0\x9F\x98\x80 \"quoted\" \\ \t" };
+	std::string allBytes;
+	for( int i = 0; i < 256; ++i ) {
+		allBytes.push_back( (char)i );
+	}
+	strings.push_back( allBytes );
+	strings.push_back( std::string( 3, '\0' ) + "\xFF\xFF" );
+	strings.push_back( std::string( 100000, 'e' ) );
+	return strings;
+}
+
+static void checkRoundTrip( const SymbolTable &table, const std::string &s, const char *tableName ) {
+	std::string encoded;
+	table.encode( s.data(), s.size(), encoded );
+	// Decoding appends to the output
+	std::string decoded( "prefix" );
+	table.decode( encoded.data(), encoded.size(), decoded );
+	check( decoded == "prefix" + s, std::string( "a round trip of a string of " ) + std::to_string( s.size() ) + " bytes with " + tableName );
+}
+
+static void testTrainedTable() {
+	const std::vector<std::string> sample = ::makeTitles( 1000 );
+	SymbolTable table;
+	table.train( sample );
+	size_t numOriginalBytes = 0;
+	size_t numEncodedBytes = 0;
+	for( const std::string &s: ::makeTitles( 2000 ) ) {
+		std::string encoded;
+		table.encode( s.data(), s.size(), encoded );
+		numOriginalBytes += s.size();
+		numEncodedBytes += encoded.size();
+		::checkRoundTrip( table, s, "a trained table" );
+	}
+	check( numEncodedBytes * 2 < numOriginalBytes, "titles like the sample are compressed at least twice, got " +
+		   std::to_string( numOriginalBytes ) + " -> " + std::to_string( numEncodedBytes ) + " bytes" );
+	for( const std::string &s: ::makeUnusualStrings() ) {
+		::checkRoundTrip( table, s, "a trained table" );
+	}
+}
+
+static void testUntrainedTables() {
+	SymbolTable untrained;
+	SymbolTable trainedOnNothing;
+	trainedOnNothing.train( {} );
+	for( const std::string &s: ::makeUnusualStrings() ) {
+		::checkRoundTrip( untrained, s, "an untrained table" );
+		::checkRoundTrip( trainedOnNothing, s, "a table trained on an empty sample" );
+	}
+}
+
+static void testCompressingTitlePool() {
+	// Enough titles to train a table of the pool, so titles that follow are stored compressed
+	std::vector<std::string> titles = ::makeTitles( 40000 );
+	for( const std::string &s: ::makeUnusualStrings() ) {
+		titles.push_back( s );
+	}
+	for( bool interning: { false, true } ) {
+		TitlePool titlePool( interning, true );
+		std::vector<uint32_t> ids;
+		for( const std::string &title: titles ) {
+			uint32_t id;
+			check( titlePool.tryAdding( title.data(), title.size(), id ), "adding a title to a pool" );
+			ids.push_back( id );
+		}
+		size_t numCompressed = 0;
+		for( size_t i = 0; i < titles.size(); ++i ) {
+			const TitlePool::Title title = titlePool.get( ids[i] );
+			numCompressed += title.compressed;
+			std::string decoded;
+			titlePool.decode( title, decoded );
+			check( decoded == titles[i], "a round trip of title #" + std::to_string( i ) + " of a compressing pool" );
+		}
+		check( numCompressed > 0, "a compressing pool stores titles compressed" );
+	}
+}
+
+int main() {
+	::testTrainedTable();
+	::testUntrainedTables();
+	::testCompressingTitlePool();
+	if( numFailed ) {
+		std::cout << numFailed << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,549 @@
+#!/bin/sh
+# Runs end-to-end checks of the mergelists-cpp binary that is given as the first argument.
+# Every check prints its name, and the script exits with a non-zero code if any of them fails.
+
+set -u
+
+if [ $# -ne 1 ] || [ ! -x "$1" ]; then
+	echo "Usage: $0 <path to mergelists-cpp>" >&2
+	exit 2
+fi
+BINARY=$1
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+cd "$WORK_DIR" || exit 2
+
+NUM_FAILED=0
+
+fail() {
+	echo "FAIL: $CHECK: $1"
+	NUM_FAILED=$((NUM_FAILED + 1))
+}
+
+begin() {
+	CHECK=$1
+	echo "check: $CHECK"
+}
+
+# Compares a file with the expected content given on the standard input by a here-document,
+# as failures of a check in a pipeline are not counted
+expect_file() {
+	cat > expected
+	if ! diff -u expected "$1" > difference; then
+		fail "unexpected content of $1"
+		cat difference
+	fi
+}
+
+# Runs the binary expecting it to fail with an error that contains the given text
+expect_error() {
+	expected_error=$1
+	shift
+	if "$BINARY" "$@" > /dev/null 2> error; then
+		fail "succeeded unexpectedly"
+	elif ! grep -qF -- "$expected_error" error; then
+		fail "unexpected error: $(cat error)"
+	fi
+}
+
+# Prints a value of the given statistic of a profile of inputs
+profile_value() {
+	awk -v name="$1" '$1 == name { print $2 }' "$2"
+}
+
+cat > a.json <<'EOF'
+[{"num":1,"title":"one","created":10},{"num":2,"title":"two","created":20}]
+EOF
+cat > b.json <<'EOF'
+[
+  {"num": 2, "title": "two deleted", "deleted": 30},
+  {"num": 3, "title": "three", "created": 25}
+]
+EOF
+cat > c.json <<'EOF'
+[{"num":1,"title":"one of a failed run","created":100}]
+EOF
+cat > d.json <<'EOF'
+[{"num":4,"title":"four","created":40}]
+EOF
+echo '[]' > empty.json
+
+begin "merge"
+"$BINARY" a.json b.json > out || fail "exit code $?"
+expect_file out <<'EOF'
+[
+  {
+    "created": 10,
+    "num": 1,
+    "title": "one"
+  },
+  {
+    "created": 25,
+    "num": 3,
+    "title": "three"
+  },
+  {
+    "deleted": 30,
+    "num": 2,
+    "title": "two deleted"
+  }
+]
+EOF
+
+begin "parse error positions"
+printf '[\n  {"num": 1, "title": "x", "created": 1x}\n]\n' > malformed_number.json
+expect_error 'byte offset 41 (line 2, column 40), element #0: A comma or a closing brace was expected' malformed_number.json a.json
+printf '[{"num": 1, "title": "x", "created": 1},\n {"num": 2, "created": 2}]\n' > missing_field.json
+expect_error 'byte offset 42 (line 2, column 2), element #1: Failed to get field `title`' missing_field.json a.json
+printf '[{"num": 1, "title": "x", "created": 1}] x\n' > trailing.json
+expect_error 'Unexpected trailing characters after the root array' trailing.json a.json
+printf '{"num": 1}\n' > not_array.json
+expect_error 'The root JSON object is not an array' not_array.json a.json
+printf '[{"num": 1, "title": "x", "created": 1}' > truncated.json
+expect_error 'A comma or a closing bracket was expected' truncated.json a.json
+
+begin "strict integer fields"
+printf '[{"num": -2147483648, "title": "x", "created": 18446744073709551615}, {"num": 2147483647, "title": "y", "deleted": 1}]\n' > limits.json
+"$BINARY" limits.json empty.json > out || fail "exit code $?"
+expect_file out <<'EOF'
+[
+  {
+    "deleted": 1,
+    "num": 2147483647,
+    "title": "y"
+  },
+  {
+    "created": 18446744073709551615,
+    "num": -2147483648,
+    "title": "x"
+  }
+]
+EOF
+printf '[{"num": 2147483648, "title": "x", "created": 1}]\n' > num_range.json
+expect_error 'element #0: The field `num` is out of range' num_range.json a.json
+printf '[{"num": "1", "title": "x", "created": 1}]\n' > num_string.json
+expect_error 'The field `num` is not an integer' num_string.json a.json
+printf '[{"num": 1, "title": "x", "created": -1}]\n' > created_negative.json
+expect_error 'The field `created` is negative while an unsigned integer is expected' created_negative.json a.json
+printf '[{"num": 1, "title": "x", "deleted": 1.5}]\n' > deleted_fraction.json
+expect_error 'The field `deleted` is not an unsigned integer' deleted_fraction.json a.json
+printf '[{"num": 1, "title": "x", "created": 18446744073709551616}]\n' > created_range.json
+expect_error 'The field `created` is out of range' created_range.json a.json
+
+begin "entry fields"
+# Fields are read in any order, unknown fields are skipped, zero timestamps are omitted and titles are escaped like a generic JSON library does
+printf '[{"title": "t\\u00e9 \\"q\\" \\\\ \\/ \\t\\u0001", "extra": {"num": 9}, "created": 0, "num": 5}, {"deleted": 4, "num": -6, "title": ""}]\n' > fields.json
+"$BINARY" fields.json empty.json > out || fail "exit code $?"
+expect_file out <<'EOF'
+[
+  {
+    "num": 5,
+    "title": "té \"q\" \\ / \t\u0001"
+  },
+  {
+    "deleted": 4,
+    "num": -6,
+    "title": ""
+  }
+]
+EOF
+printf '[{"num": 1, "title": "x", "created": 1}, {"created": 3, "deleted": 4, "num": 6, "title": "x"}]\n' > both_timestamps.json
+expect_error 'element #1: Both `created` and `deleted` fields are present' both_timestamps.json a.json
+printf '[{"num": 6, "title": "x"}]\n' > no_timestamps.json
+expect_error 'element #0: Both `created` and `deleted` fields are absent' no_timestamps.json a.json
+
+begin "skipped invalid elements"
+printf '[{"num": 1, "title": "x", "created": 1}, 5, {"num": 6, "title": 7, "created": 6}]\n' > invalid.json
+if "$BINARY" --skip-invalid invalid.json empty.json > out 2> warnings; then
+	[ "$(grep -c '"num"' out)" -eq 1 ] || fail "unexpected entries: $(cat out)"
+	grep -qF 'element #1: An element of a root JSON array is not an object' warnings || fail "no warning of element #1"
+	grep -qF 'element #2: The field `title` is not a string' warnings || fail "no warning of element #2"
+else
+	fail "exit code $?"
+fi
+
+begin "deeply nested unknown fields"
+awk 'BEGIN { printf "[{\"num\": 1, \"title\": \"x\", \"created\": 1, \"extra\": "; for( i = 0; i < 200000; i++ ) printf "["; for( i = 0; i < 200000; i++ ) printf "]"; print "}]" }' > deep.json
+for option in --skip-invalid --stats; do
+	if "$BINARY" $option deep.json empty.json > out 2> /dev/null; then
+		[ "$(grep -c '"num"' out)" -eq 1 ] || fail "unexpected entries with $option: $(cat out)"
+	else
+		fail "exit code $? with $option"
+	fi
+done
+
+# Lists with enough titles to train a symbol table of compressed titles and with repeated keys and titles.
+# Timestamps are distinct, as an order of entries with the same timestamp is unspecified and may differ between engines.
+awk 'BEGIN { srand( 1 ); for( f = 1; f <= 3; f++ ) { file = "big" f ".json"; printf "[" > file; for( i = 0; i < 20000; i++ ) printf "%s{\"num\": %d, \"title\": \"title \\\"%d\\\" of list %d\", \"%s\": %d}", ( i ? ", " : "" ), int( rand() * 30000 ) - 100, int( rand() * 5000 ), f, ( rand() < 0.2 ? "deleted" : "created" ), ( ( f - 1 ) * 20000 + i ) * 7919 % 100003 > file; print "]" > file } }'
+"$BINARY" big1.json big2.json big3.json > big_expected || fail "exit code $?"
+
+begin "interned titles"
+for options in "--intern-titles" "--intern-titles --threads 1"; do
+	"$BINARY" $options big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	cmp -s big_expected out || fail "the output differs with $options"
+done
+
+begin "compressed titles"
+for options in "--compress-titles" "--intern-titles --compress-titles"; do
+	"$BINARY" $options big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	cmp -s big_expected out || fail "the output differs with $options"
+done
+
+begin "engines"
+for options in "--engine hash" "--engine dense" "--engine sorted" "--engine partitioned" "--engine concurrent" \
+		"--sort comparison" "--sort radix" "--engine hash --sort radix" "--engine partitioned --sort comparison" "--threads 1"; do
+	"$BINARY" $options big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	cmp -s big_expected out || fail "the output differs with $options"
+done
+
+begin "combined winners"
+for options in "--combine" "--combine --engine dense" "--combine --engine sorted" "--combine --threads 1"; do
+	"$BINARY" $options big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	cmp -s big_expected out || fail "the output differs with $options"
+done
+
+begin "incrementally ordered winners"
+for options in "--ordered-index" "--ordered-index --engine sorted" "--ordered-index --threads 1"; do
+	"$BINARY" $options big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	cmp -s big_expected out || fail "the output differs with $options"
+done
+
+begin "concurrent readers"
+for options in "--concurrent-readers 2" "--engine concurrent --concurrent-readers 3 --stats"; do
+	if "$BINARY" $options big1.json big2.json big3.json > out 2> stats; then
+		cmp -s big_expected out || fail "the output differs with $options"
+	else
+		fail "exit code $? with $options"
+	fi
+done
+# Readers may finish no lookups before a short merge ends, so only a report of them is checked
+grep -q 'stats: concurrent lookups: ' stats || fail "no report of concurrent lookups: $(cat stats)"
+
+begin "dense kernels"
+# Keys are repeated within a vector of the kernel with the same and with different timestamps
+awk 'BEGIN { printf "["; for( i = 0; i < 64; i++ ) printf "%s{\"num\": %d, \"title\": \"copy %d\", \"created\": %d}", ( i ? ", " : "" ), i % 4, i, 10 + ( i % 3 == 0 ? 0 : i % 2 ); print "]" }' > copies.json
+"$BINARY" --engine dense --dense-kernel scalar copies.json empty.json > copies_expected || fail "exit code $?"
+grep -qF '"title": "copy 7"' copies_expected || fail "the first of the latest copies does not win: $(cat copies_expected)"
+for kernel in scalar auto avx512; do
+	if ! "$BINARY" --engine dense --dense-kernel $kernel big1.json big2.json big3.json > out 2> error; then
+		grep -qF 'The AVX-512 dense kernel is not supported by this CPU or build' error || fail "unexpected error with $kernel: $(cat error)"
+		continue
+	fi
+	cmp -s big_expected out || fail "the output differs with the $kernel kernel"
+	"$BINARY" --engine dense --dense-kernel $kernel copies.json empty.json > out || fail "exit code $? with $kernel"
+	cmp -s copies_expected out || fail "the output of copies differs with the $kernel kernel"
+done
+
+begin "invalid option values"
+expect_error 'Malformed value `4x` of `--threads`' --threads 4x a.json b.json
+expect_error 'Malformed value `1e6` of `--checkpoint-bytes`' --checkpoint-bytes 1e6 a.json b.json
+
+begin "change events are not combined"
+expect_error 'Change events can not be combined with the combiner' --combine --cdc events.ndjson a.json b.json
+
+begin "write-ahead log skips batches of failed runs"
+mkdir state
+"$BINARY" --state state a.json b.json > /dev/null || fail "exit code $?"
+printf '[{"num": 5, "title": "bad", "created": 1x}]\n' > bad.json
+expect_error 'Failed to read a file content of `bad.json`' --state state c.json bad.json
+"$BINARY" --state state d.json > out || fail "exit code $?"
+"$BINARY" a.json b.json d.json > expected_state
+diff -u expected_state out > difference || { fail "a batch of the failed run was replayed"; cat difference; }
+
+begin "write-ahead log ignores a garbage tail"
+cp -r state garbage_state
+printf 'garbage' >> garbage_state/wal
+"$BINARY" --state garbage_state empty.json > out || fail "exit code $?"
+diff -u expected_state out > difference || { fail "unexpected state"; cat difference; }
+
+begin "write-ahead log drops a run with a torn commit"
+cp -r state torn_state
+truncate -s -3 torn_state/wal
+"$BINARY" --state torn_state empty.json > out || fail "exit code $?"
+"$BINARY" a.json b.json > expected_torn
+diff -u expected_torn out > difference || { fail "the uncommitted run was replayed"; cat difference; }
+# The log is usable after recovery
+"$BINARY" --state torn_state d.json > /dev/null || fail "exit code $?"
+"$BINARY" --state torn_state empty.json > out || fail "exit code $?"
+diff -u expected_state out > difference || { fail "a run after recovery was lost"; cat difference; }
+
+begin "compaction"
+mkdir compacted_state
+"$BINARY" --state compacted_state --compact --tombstone-retention 5 --ttl 20 a.json b.json d.json > out || fail "exit code $?"
+# The output of the compacting run still holds winners that are dropped from the state
+diff -u expected_state out > difference || { fail "unexpected output of the compacting run"; cat difference; }
+"$BINARY" --state compacted_state empty.json > out || fail "exit code $?"
+expect_file out <<'EOF'
+[
+  {
+    "created": 25,
+    "num": 3,
+    "title": "three"
+  },
+  {
+    "created": 40,
+    "num": 4,
+    "title": "four"
+  }
+]
+EOF
+mkdir tombstone_state
+"$BINARY" --state tombstone_state --compact --tombstone-retention 5 a.json b.json d.json > /dev/null || fail "exit code $?"
+"$BINARY" --state tombstone_state empty.json > out || fail "exit code $?"
+[ "$(grep -c '"num"' out)" -eq 3 ] && ! grep -q '"deleted"' out || fail "the tombstone is not dropped: $(cat out)"
+# A dropped tombstone no longer hides an older entry of its key
+"$BINARY" --state tombstone_state a.json > out || fail "exit code $?"
+grep -qF '"title": "two"' out || fail "the key of the dropped tombstone is not resurrected: $(cat out)"
+
+begin "as-of snapshots"
+"$BINARY" --as-of 30,20 --as-of-prefix snapshot_ a.json b.json d.json > out || fail "exit code $?"
+[ -s out ] && fail "snapshots are written to the standard output as well"
+expect_file snapshot_20.json <<'EOF'
+[
+  {
+    "created": 10,
+    "num": 1,
+    "title": "one"
+  },
+  {
+    "created": 20,
+    "num": 2,
+    "title": "two"
+  }
+]
+EOF
+expect_file snapshot_30.json <<'EOF'
+[
+  {
+    "created": 10,
+    "num": 1,
+    "title": "one"
+  },
+  {
+    "created": 25,
+    "num": 3,
+    "title": "three"
+  },
+  {
+    "deleted": 30,
+    "num": 2,
+    "title": "two deleted"
+  }
+]
+EOF
+# A snapshot as of the latest timestamp is the output itself
+"$BINARY" --as-of 100003 --as-of-prefix big_snapshot_ big1.json big2.json big3.json > /dev/null || fail "exit code $?"
+cmp -s big_expected big_snapshot_100003.json || fail "a snapshot as of the latest timestamp differs from the output"
+
+begin "change events"
+"$BINARY" --cdc events.ndjson a.json b.json d.json > out || fail "exit code $?"
+diff -u expected_state out > difference || { fail "unexpected output"; cat difference; }
+expect_file events.ndjson <<'EOF'
+{"op":"insert","list":0,"num":1,"timestamp":10,"deleted":false}
+{"op":"insert","list":0,"num":2,"timestamp":20,"deleted":false}
+{"op":"replace","list":1,"num":2,"old_timestamp":20,"timestamp":30,"deleted":true}
+{"op":"insert","list":1,"num":3,"timestamp":25,"deleted":false}
+{"op":"insert","list":2,"num":4,"timestamp":40,"deleted":false}
+EOF
+"$BINARY" --cdc events.bin --cdc-format binary a.json b.json d.json > /dev/null || fail "exit code $?"
+# Records are 32 bytes long, and the third one is the replacement
+[ "$(wc -c < events.bin)" -eq 160 ] || fail "unexpected size of binary events: $(wc -c < events.bin)"
+[ "$(od -An -v -tu8 -j 64 -N 16 events.bin | tr -s ' ')" = " 20 30" ] || fail "unexpected timestamps of the binary replacement"
+[ "$(od -An -v -tu4 -j 80 -N 8 events.bin | tr -s ' ')" = " 2 1" ] || fail "unexpected key or list of the binary replacement"
+[ "$(od -An -v -tu1 -j 88 -N 2 events.bin | tr -s ' ')" = " 1 1" ] || fail "unexpected flags of the binary replacement"
+# Every winner is inserted once
+"$BINARY" --cdc big_events.ndjson big1.json big2.json big3.json > out || fail "exit code $?"
+cmp -s big_expected out || fail "the output differs with change events"
+[ "$(grep -c '"op":"insert"' big_events.ndjson)" -eq "$(grep -c '"num"' big_expected)" ] || fail "insertions do not match winners"
+
+begin "file output"
+for options in "" "--threads 1" "--threads 7" "--intern-titles" "--compress-titles"; do
+	"$BINARY" $options --output written.json big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	[ -s out ] && fail "the output is written to the standard output as well with $options"
+	cmp -s big_expected written.json || fail "the file output differs with $options"
+done
+# No entries are written as `null` like to the standard output
+"$BINARY" --output written.json empty.json empty.json > /dev/null || fail "exit code $?"
+"$BINARY" empty.json empty.json > out || fail "exit code $?"
+cmp -s out written.json || fail "the file output of no entries differs: $(cat written.json)"
+"$BINARY" --output written.json a.json b.json d.json > /dev/null || fail "exit code $?"
+diff -u expected_state written.json > difference || { fail "unexpected file output"; cat difference; }
+
+begin "input modes"
+# A mode of reading does not change the output, also for a file that is smaller than a block
+for options in "--input-mode cached" "--input-mode direct" "--input-mode drop-cache" "--input-mode direct --threads 1"; do
+	"$BINARY" $options big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	cmp -s big_expected out || fail "the output differs with $options"
+	"$BINARY" $options a.json b.json d.json > out || fail "exit code $? with $options"
+	cmp -s expected_state out || fail "the output of small files differs with $options"
+done
+
+begin "prefetched inputs"
+for options in "--prefetch 1" "--prefetch 2" "--prefetch 8" "--prefetch 2 --threads 1" "--prefetch 2 --input-mode direct"; do
+	"$BINARY" $options big1.json big2.json big3.json > out || fail "exit code $? with $options"
+	cmp -s big_expected out || fail "the output differs with $options"
+done
+
+begin "compressed inputs"
+# A build without a codec reports compressed inputs of it instead of failing to parse them
+for codec in gzip zstd; do
+	command -v $codec > /dev/null || continue
+	$codec -c big1.json > big1.json.$codec
+	head -c 20000 big1.json.$codec > truncated.json.$codec
+	if ! "$BINARY" big1.json.$codec big2.json big3.json > out 2> error; then
+		grep -qF "The content is $codec-compressed, but this build does not support $codec" error || fail "unexpected error with $codec: $(cat error)"
+		continue
+	fi
+	cmp -s big_expected out || fail "the output differs with a $codec input"
+	for options in "--prefetch 2" "--input-mode direct" "--threads 1"; do
+		"$BINARY" $options big1.json.$codec big2.json big3.json > out || fail "exit code $? with a $codec input and $options"
+		cmp -s big_expected out || fail "the output differs with a $codec input and $options"
+	done
+	expect_error "Failed to read a file content of \`truncated.json.$codec\`" truncated.json.$codec a.json
+done
+
+begin "compressed output"
+for codec in gzip zstd; do
+	if ! "$BINARY" --compress $codec --output written.json.$codec big1.json big2.json big3.json > out 2> error; then
+		grep -qF "The codec \`$codec\` is not supported by this build" error || fail "unexpected error with $codec: $(cat error)"
+		continue
+	fi
+	[ -s out ] && fail "the output is written to the standard output as well with $codec"
+	# The compressed output is read back as an input
+	"$BINARY" written.json.$codec empty.json > out || fail "exit code $? reading the $codec output"
+	cmp -s big_expected out || fail "the $codec output read back differs"
+	command -v $codec > /dev/null || continue
+	$codec -dc written.json.$codec > out || fail "the $codec output is not decoded"
+	cmp -s big_expected out || fail "the decoded $codec output differs"
+	"$BINARY" --compress $codec --output written_empty.json.$codec empty.json empty.json > /dev/null || fail "exit code $?"
+	"$BINARY" empty.json empty.json > expected_empty || fail "exit code $?"
+	$codec -dc written_empty.json.$codec > out || fail "the $codec output of no entries is not decoded"
+	cmp -s expected_empty out || fail "the decoded $codec output of no entries differs"
+done
+
+begin "jobs"
+printf 'job_small.json a.json b.json d.json\n\njob_big.json big1.json big2.json big3.json\njob_single.json a.json\n' > jobs
+for options in "" "--threads 1" "--engine dense --intern-titles" "--compress-titles --threads 3"; do
+	rm -f job_*.json
+	"$BINARY" $options --jobs jobs > out || fail "exit code $? with $options"
+	[ -s out ] && fail "outputs of jobs are written to the standard output as well with $options"
+	cmp -s expected_state job_small.json || fail "the output of a small job differs with $options"
+	cmp -s big_expected job_big.json || fail "the output of a big job differs with $options"
+	"$BINARY" a.json empty.json > expected_single
+	cmp -s expected_single job_single.json || fail "the output of a job of a single list differs with $options"
+done
+# Other jobs are done if a job fails
+printf 'job_missing.json a.json missing.json\njob_small.json a.json b.json d.json\n' > failing_jobs
+rm -f job_*.json
+expect_error 'Job 1 (`job_missing.json`) failed: Failed to read a file content of `missing.json`' --jobs failing_jobs
+cmp -s expected_state job_small.json || fail "a job after the failed one is not done"
+expect_error '`--jobs` can not be combined with `--state`' --state state --jobs jobs
+expect_error '`--jobs` can not be combined with `--cdc`' --cdc events.ndjson --jobs jobs
+expect_error 'Inputs and outputs must be specified by jobs' --jobs jobs a.json b.json
+
+begin "two-pass merges"
+for options in "--memory-budget 100000" "--memory-budget 3000000" "--memory-budget 100000 --threads 1" \
+		"--memory-budget 100000 --intern-titles --compress-titles --engine dense"; do
+	if "$BINARY" --stats $options big1.json big2.json big3.json > out 2> stats; then
+		cmp -s big_expected out || fail "the output differs with $options"
+		grep -qF 'stats: memory mode: two-pass' stats || fail "no fallback to two passes with $options"
+	else
+		fail "exit code $? with $options"
+	fi
+done
+"$BINARY" --memory-budget 1000 --output written.json a.json b.json d.json > /dev/null || fail "exit code $?"
+diff -u expected_state written.json > difference || { fail "unexpected file output"; cat difference; }
+"$BINARY" --memory-budget 1000 empty.json empty.json > out || fail "exit code $?"
+"$BINARY" empty.json empty.json > expected_empty || fail "exit code $?"
+cmp -s expected_empty out || fail "unexpected output of no entries: $(cat out)"
+
+begin "progress"
+# The output is not consumed until the progress is described, so the merge is still running
+mkfifo output_fifo
+"$BINARY" --progress --stats-socket stats.sock big1.json big2.json big3.json > output_fifo 2> progress &
+pid=$!
+exec 3< output_fifo
+sleep 1
+kill -USR1 $pid
+if command -v python3 > /dev/null; then
+	python3 -c 'import socket, sys; s = socket.socket( socket.AF_UNIX ); s.connect( "stats.sock" ); sys.stdout.write( s.makefile().read() )' > socket_progress ||
+		fail "the stats socket is not served"
+	grep -q '^progress: stage: ' socket_progress || fail "unexpected progress from the stats socket: $(cat socket_progress)"
+fi
+sleep 1
+cat <&3 > out
+exec 3<&-
+wait $pid || fail "exit code $?"
+cmp -s big_expected out || fail "the output differs with a progress monitor"
+grep -q '^progress: stage: ' progress || fail "no progress is described on a signal: $(cat progress)"
+[ -e stats.sock ] && fail "the stats socket is not removed"
+
+begin "profiles and generated inputs"
+"$BINARY" --profile-input big.profile big1.json big2.json big3.json > out || fail "exit code $?"
+[ -s out ] && fail "a profile run writes the output"
+for prefix in generated_ same_seed_; do
+	"$BINARY" --generate big.profile --generate-prefix $prefix --seed 7 > /dev/null || fail "exit code $?"
+done
+"$BINARY" --generate big.profile --generate-prefix other_seed_ --seed 8 > /dev/null || fail "exit code $?"
+for i in 0 1 2; do
+	cmp -s generated_$i.json same_seed_$i.json || fail "generated file #$i differs with the same seed"
+done
+cmp -s generated_0.json other_seed_0.json && fail "generated files are the same with another seed"
+grep -q '"num": -' generated_0.json || fail "no negative keys are generated"
+# Generated files are valid inputs with a profile that is close to the original one
+"$BINARY" --profile-input generated.profile generated_0.json generated_1.json generated_2.json > /dev/null || fail "exit code $?"
+for name in files min-key; do
+	[ "$(profile_value $name generated.profile)" = "$(profile_value $name big.profile)" ] || fail "$name differs in the profile of generated files"
+done
+for name in entries distinct-keys deleted keys-in-several-files; do
+	original=$(profile_value $name big.profile)
+	generated=$(profile_value $name generated.profile)
+	[ $((generated * 20)) -gt $((original * 19)) ] && [ $((generated * 20)) -lt $((original * 21)) ] ||
+		fail "$name differs by more than 5% in the profile of generated files: $generated instead of $original"
+done
+
+begin "lookups"
+"$BINARY" --output indexed.json --index --timestamp-index 2 a.json b.json d.json || fail "exit code $?"
+"$BINARY" --lookup indexed.json 3 2 > out || fail "exit code $?"
+expect_file out <<'EOF'
+  {
+    "created": 25,
+    "num": 3,
+    "title": "three"
+  }
+  {
+    "deleted": 30,
+    "num": 2,
+    "title": "two deleted"
+  }
+EOF
+expect_error 'The key 7 is not found' --lookup indexed.json 7
+
+begin "range reads"
+"$BINARY" --read-range indexed.json 20 30 > out || fail "exit code $?"
+expect_file out <<'EOF'
+[
+  {
+    "created": 25,
+    "num": 3,
+    "title": "three"
+  },
+  {
+    "deleted": 30,
+    "num": 2,
+    "title": "two deleted"
+  }
+]
+EOF
+"$BINARY" --read-range indexed.json 0 100 > out || fail "exit code $?"
+diff -u indexed.json out > difference || { fail "a range of all timestamps differs from the output"; cat difference; }
+"$BINARY" --read-range indexed.json 50 60 > out || fail "exit code $?"
+expect_file out <<'EOF'
+[]
+EOF
+
+if [ "$NUM_FAILED" -ne 0 ]; then
+	echo "$NUM_FAILED checks failed"
+	exit 1
+fi
+echo "all checks passed"